@@ -0,0 +1,253 @@
+#include "adc_capture.h"
+
+#include "hardware/adc.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "pico/stdlib.h"
+
+#include "cycle_counter.h"
+#include "hot_path.h"
+
+namespace {
+
+// A block is readable once complete and not among the two the DMA
+// channels currently own.
+constexpr uint32_t kReadableBlocks = kAdcBlockCount - 2;
+constexpr uint32_t kMaxRateHz      = 500000;
+
+uint16_t g_blocks[kAdcBlockCount][kAdcBlockSamples];
+volatile uint32_t g_block_end_us[kAdcBlockCount];
+
+int      g_dma[2]         = {-1, -1};
+bool     g_irq_installed  = false;
+bool     g_active         = false;
+bool     g_paused         = false;
+bool     g_exclusive      = false;
+uint32_t g_start_cycles   = 0;
+uint8_t  g_mask           = 0;
+uint8_t  g_inputs         = 0;
+uint8_t  g_resume_input   = 0;
+uint32_t g_rate_hz        = 0;
+
+volatile uint32_t g_written = 0;  // blocks completed since start
+uint32_t g_read    = 0;
+uint32_t g_dropped = 0;
+uint32_t g_gaps    = 0;
+
+void DIAG_HOT_FUNC(dma_irq_handler)() {
+    for (int i = 0; i < 2; ++i) {
+        if (g_dma[i] < 0) continue;
+        uint32_t bit = 1u << g_dma[i];
+        if (!(dma_hw->ints1 & bit)) continue;
+        dma_hw->ints1 = bit;
+
+        // Blocks complete strictly in order, alternating channels. This
+        // channel gets the block after the one its partner is filling now.
+        uint32_t done = g_written;
+        g_block_end_us[done % kAdcBlockCount] = time_us_32();
+        g_written = done + 1;
+        uint32_t next = (done + 2) % kAdcBlockCount;
+        dma_channel_set_write_addr(static_cast<uint>(g_dma[i]), g_blocks[next], false);
+        dma_channel_set_trans_count(static_cast<uint>(g_dma[i]), kAdcBlockSamples, false);
+    }
+}
+
+void configure_channel(int index, uint block) {
+    uint ch = static_cast<uint>(g_dma[index]);
+    dma_channel_config c = dma_channel_get_default_config(ch);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_dreq(&c, DREQ_ADC);
+    channel_config_set_chain_to(&c, static_cast<uint>(g_dma[index ^ 1]));
+    dma_channel_configure(ch, &c, g_blocks[block], &adc_hw->fifo, kAdcBlockSamples, false);
+}
+
+void wait_adc_idle() {
+    while (!(adc_hw->cs & ADC_CS_READY_BITS)) {
+        tight_loop_contents();
+    }
+}
+
+}  // namespace
+
+bool adc_capture_start(uint8_t input_mask, uint32_t sample_rate_hz) {
+    adc_capture_stop();
+    if (input_mask == 0) return false;
+
+    g_dma[0] = dma_claim_unused_channel(false);
+    g_dma[1] = dma_claim_unused_channel(false);
+    if (g_dma[0] < 0 || g_dma[1] < 0) {
+        if (g_dma[0] >= 0) dma_channel_unclaim(static_cast<uint>(g_dma[0]));
+        if (g_dma[1] >= 0) dma_channel_unclaim(static_cast<uint>(g_dma[1]));
+        g_dma[0] = g_dma[1] = -1;
+        return false;
+    }
+
+    if (sample_rate_hz > kMaxRateHz) sample_rate_hz = kMaxRateHz;
+    if (sample_rate_hz == 0) sample_rate_hz = 1;
+    // Conversion period is (1 + div) ADC clocks; 96 clocks is the minimum.
+    uint32_t adc_clk = clock_get_hz(clk_adc);
+    uint32_t div = adc_clk / sample_rate_hz;
+    if (div < 96) div = 96;
+    g_rate_hz = adc_clk / div;
+
+    g_mask = input_mask;
+    g_inputs = 0;
+    uint8_t first = 0;
+    for (uint8_t i = 0; i < 8; ++i) {
+        if (input_mask & (1u << i)) {
+            if (g_inputs == 0) first = i;
+            ++g_inputs;
+        }
+    }
+
+    g_written = 0;
+    g_read = 0;
+    g_dropped = 0;
+    g_gaps = 0;
+
+    adc_run(false);
+    adc_fifo_drain();
+    adc_fifo_setup(true, true, 1, false, false);
+    adc_set_clkdiv(static_cast<float>(div - 1));
+    adc_select_input(first);
+    adc_set_round_robin(g_inputs > 1 ? input_mask : 0);
+
+    if (!g_irq_installed) {
+        irq_add_shared_handler(DMA_IRQ_1, dma_irq_handler,
+                               PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+        irq_set_enabled(DMA_IRQ_1, true);
+        g_irq_installed = true;
+    }
+    configure_channel(0, 0);
+    configure_channel(1, 1);
+    dma_channel_set_irq1_enabled(static_cast<uint>(g_dma[0]), true);
+    dma_channel_set_irq1_enabled(static_cast<uint>(g_dma[1]), true);
+
+    g_active = true;
+    g_paused = false;
+    dma_channel_start(static_cast<uint>(g_dma[0]));
+    g_start_cycles = cycle_counter_read();
+    adc_run(true);
+    return true;
+}
+
+void adc_capture_stop() {
+    if (!g_active) return;
+    g_active = false;
+    g_exclusive = false;
+
+    adc_run(false);
+    wait_adc_idle();
+    for (int i = 0; i < 2; ++i) {
+        uint ch = static_cast<uint>(g_dma[i]);
+        dma_channel_set_irq1_enabled(ch, false);
+        // Break the chain first so aborting one channel can't start the
+        // other.
+        dma_channel_config c = dma_get_channel_config(ch);
+        channel_config_set_chain_to(&c, ch);
+        dma_channel_set_config(ch, &c, false);
+    }
+    for (int i = 0; i < 2; ++i) {
+        uint ch = static_cast<uint>(g_dma[i]);
+        dma_channel_abort(ch);
+        dma_hw->ints1 = 1u << ch;
+        dma_channel_unclaim(ch);
+        g_dma[i] = -1;
+    }
+
+    // Hand the ADC back the way the SDK expects it: single conversions, no
+    // FIFO, no round-robin.
+    adc_set_round_robin(0);
+    adc_fifo_setup(false, false, 0, false, false);
+    adc_fifo_drain();
+    adc_set_clkdiv(0);
+}
+
+bool adc_capture_active() {
+    return g_active;
+}
+
+void adc_capture_set_exclusive(bool exclusive) {
+    g_exclusive = g_active && exclusive;
+}
+
+bool adc_capture_exclusive() {
+    return g_exclusive;
+}
+
+uint32_t adc_capture_start_cycles() {
+    return g_start_cycles;
+}
+
+uint32_t adc_capture_rate_hz() {
+    return g_rate_hz;
+}
+
+uint8_t adc_capture_inputs() {
+    return g_inputs;
+}
+
+uint8_t adc_capture_slot(uint8_t input) {
+    uint8_t slot = 0;
+    for (uint8_t i = 0; i < input; ++i) {
+        if (g_mask & (1u << i)) ++slot;
+    }
+    return slot;
+}
+
+const uint16_t* DIAG_HOT_FUNC(adc_capture_acquire)(uint32_t& seq) {
+    uint32_t written = g_written;
+    if (written - g_read > kReadableBlocks) {
+        g_dropped += written - g_read - kReadableBlocks;
+        g_read = written - kReadableBlocks;
+    }
+    if (g_read == written) return nullptr;
+    seq = g_read;
+    return g_blocks[g_read % kAdcBlockCount];
+}
+
+void DIAG_HOT_FUNC(adc_capture_release)() {
+    ++g_read;
+}
+
+uint32_t adc_capture_block_end_us(uint32_t seq) {
+    return g_block_end_us[seq % kAdcBlockCount];
+}
+
+uint32_t adc_capture_dropped() {
+    return g_dropped;
+}
+
+uint32_t adc_capture_gaps() {
+    return g_gaps;
+}
+
+void DIAG_HOT_FUNC(adc_capture_pause)() {
+    if (!g_active || g_paused) return;
+    g_paused = true;
+    adc_run(false);
+    wait_adc_idle();
+    // With free-running stopped, AINSEL already points at the input the
+    // round-robin would convert next.
+    g_resume_input = static_cast<uint8_t>((adc_hw->cs & ADC_CS_AINSEL_BITS) >> ADC_CS_AINSEL_LSB);
+    // Let the DMA drain what's left, then keep the SDK's one-shot reads
+    // out of the FIFO.
+    while (!adc_fifo_is_empty()) {
+        tight_loop_contents();
+    }
+    hw_clear_bits(&adc_hw->fcs, ADC_FCS_EN_BITS | ADC_FCS_DREQ_EN_BITS);
+    adc_set_round_robin(0);
+}
+
+void DIAG_HOT_FUNC(adc_capture_resume)() {
+    if (!g_active || !g_paused) return;
+    g_paused = false;
+    ++g_gaps;
+    adc_select_input(g_resume_input);
+    adc_set_round_robin(g_inputs > 1 ? g_mask : 0);
+    hw_set_bits(&adc_hw->fcs, ADC_FCS_EN_BITS | ADC_FCS_DREQ_EN_BITS);
+    adc_run(true);
+}
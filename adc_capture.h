@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Continuous DMA capture from the ADC into a ring of fixed-size blocks.
+//
+// The ADC free-runs in round-robin over the selected inputs; two chained
+// DMA channels fill the blocks alternately and an interrupt re-arms each
+// one as it finishes, so capture runs without CPU involvement. Samples are
+// 12-bit, interleaved in ascending ADC-input order (see adc_capture_slot()).
+//
+// The SDK shares the ADC (pots and CV inputs are read inside
+// Brain::update()), so the main loop wraps update() in adc_capture_pause()
+// and adc_capture_resume(). Pausing lets the in-flight conversion finish
+// and resuming restarts at the same round-robin position, so the
+// interleave never slips; each pause is counted as a gap.
+//
+// Coherent measurements (narrowband detection, frequency counting) can't
+// tolerate gaps, since sample index stops mapping to time. They mark the
+// capture exclusive, and the main loop skips Brain::update() entirely
+// until the capture stops; buttons and pots are frozen for that time.
+
+constexpr size_t kAdcBlockSamples = 512;
+constexpr size_t kAdcBlockCount   = 8;
+
+// Starts capture of the inputs in `input_mask` (bit n = ADC input n) at a
+// combined conversion rate of `sample_rate_hz` (max 500 kHz). Stops any
+// capture already running. Returns false if no DMA channel is free.
+bool adc_capture_start(uint8_t input_mask, uint32_t sample_rate_hz);
+void adc_capture_stop();
+bool adc_capture_active();
+
+void adc_capture_set_exclusive(bool exclusive);
+bool adc_capture_exclusive();
+
+// cycle_counter_read() just before the ADC started converting, for timing
+// the capture against other hardware to the cycle (see cycle_counter.h).
+uint32_t adc_capture_start_cycles();
+
+// Combined conversion rate actually achieved by the ADC divider.
+uint32_t adc_capture_rate_hz();
+
+// Number of inputs in the round-robin, and the position of `input` within
+// each interleaved frame.
+uint8_t adc_capture_inputs();
+uint8_t adc_capture_slot(uint8_t input);
+
+// Returns the oldest unread block, or nullptr if none is complete yet.
+// `seq` is the block's running sequence number. Blocks the reader fell too
+// far behind on are skipped and counted in adc_capture_dropped().
+const uint16_t* adc_capture_acquire(uint32_t& seq);
+void adc_capture_release();
+
+// time_us_32() when block `seq` completed.
+uint32_t adc_capture_block_end_us(uint32_t seq);
+
+uint32_t adc_capture_dropped();
+uint32_t adc_capture_gaps();
+
+void adc_capture_pause();
+void adc_capture_resume();
+
+// Temperature sensor reading (ADC_TEMPERATURE_CHANNEL_NUM, enabled with
+// adc_set_temp_sensor_enabled()) in degrees C, from the datasheet's
+// 0.706 V at 27 C and -1.721 mV/C. Takes a mean of raw counts.
+inline double adc_capture_temp_c(double counts) {
+    return 27.0 - (counts * (3.3 / 4096.0) - 0.706) / 0.001721;
+}
@@ -0,0 +1,87 @@
+#include "bode.h"
+
+#include <cmath>
+#include <cstdio>
+
+#include "lockin.h"
+
+namespace {
+
+constexpr int32_t  kDriveMv        = 2000;
+constexpr double   kStartHz        = 20.0;
+constexpr uint32_t kStepsPerDecade = 8;
+constexpr uint32_t kSteps          = 3 * kStepsPerDecade + 1;  // to 20 kHz
+constexpr uint32_t kSettlePeriods  = 3;
+constexpr uint32_t kMeasurePeriods = 8;
+constexpr uint32_t kMinSettleMs    = 2;
+constexpr uint32_t kMinMeasureMs   = 10;
+
+bool    g_running = false;
+uint8_t g_channel = 0;
+uint8_t g_step    = 0;
+
+constexpr const char* kNames[2] = {"a", "b"};
+
+double step_hz(uint8_t step) {
+    return kStartHz * std::pow(10.0, static_cast<double>(step) / kStepsPerDecade);
+}
+
+uint32_t periods_ms(double freq_hz, uint32_t periods, uint32_t min_ms) {
+    auto ms = static_cast<uint32_t>(std::ceil(1000.0 * periods / freq_hz));
+    return ms < min_ms ? min_ms : ms;
+}
+
+double to_db(double uv) {
+    double rel = uv / (kDriveMv * 1000.0);
+    return rel > 0.0 ? 20.0 * std::log10(rel) : -999.0;
+}
+
+bool start_step(Brain& brain) {
+    double hz = step_hz(g_step);
+    LockInConfig config;
+    config.reference = g_channel == 0 ? kLockInCvOutA : kLockInCvOutB;
+    config.amplitude_mv = kDriveMv;
+    config.freq_hz = hz;
+    config.settle_ms = periods_ms(hz, kSettlePeriods, kMinSettleMs);
+    config.integration_ms = periods_ms(hz, kMeasurePeriods, kMinMeasureMs);
+    return lockin_start(brain, config);
+}
+
+void finish(const char* error) {
+    lockin_stop();
+    if (error != nullptr) printf("bode error=%s\n", error);
+    printf("bode_done\n");
+    g_running = false;
+}
+
+}  // namespace
+
+void bode_enter(Brain& /*brain*/) {
+    g_running = true;
+    g_channel = 0;
+    g_step = 0;
+}
+
+void bode_run(Brain& brain, uint32_t /*now_ms*/) {
+    if (!g_running) return;
+    if (!lockin_active()) {
+        // First step; blocks for the one-time DAC table sweep.
+        if (!start_step(brain)) finish("start-failed");
+        return;
+    }
+    if (!lockin_service()) return;
+
+    const LockInResult& r = lockin_result(g_channel);
+    printf("bode channel=%s freq_hz=%.2f gain_db=%.2f phase_deg=%.1f floor_db=%.1f\n",
+           kNames[g_channel], lockin_freq_hz(), to_db(r.amplitude_uv), r.phase_deg,
+           to_db(r.floor_uv));
+
+    if (++g_step >= kSteps) {
+        g_step = 0;
+        if (++g_channel >= 2) {
+            finish(nullptr);
+            return;
+        }
+    }
+    if (!start_step(brain)) finish("start-failed");
+}
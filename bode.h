@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+
+#include "tests.h"
+
+// kTestBode: swept-sine frequency response of the CV out -> CV in chain.
+// Patch CV out 1 to CV in 1 and CV out 2 to CV in 2, then select the mode.
+//
+// For each channel, a 2 V-peak sine is stepped through 25 log-spaced
+// frequencies from 20 Hz to 20 kHz (eight per decade). Every step is a
+// short lock-in measurement (lockin.h): the tone is streamed by DMA,
+// allowed to settle for a few periods, then demodulated over a whole
+// number of periods on the looped-back input. The sweep takes a few
+// seconds per channel. Gain is relative to the drive with the nominal
+// input scaling, phase relative to the drive:
+//
+//   bode channel=<a|b> freq_hz=<f> gain_db=<db> phase_deg=<deg> floor_db=<db>
+//   bode_done
+//
+// Buttons and pots are not read while the sweep runs.
+void bode_enter(Brain& brain);
+void bode_run(Brain& brain, uint32_t now_ms);
@@ -0,0 +1,42 @@
+#include "boot_profile.h"
+
+#include <cstdio>
+
+#include "pico/stdlib.h"
+
+namespace {
+
+constexpr const char* kPhaseNames[kBootPhaseCount] = {
+    "main",
+    "brain_init",
+    "indicator",
+    "first_test",
+    "usb_init",
+    "usb_connected",
+    "calibration_start",
+    "calibration_done",
+};
+
+// 0 means "not reached yet"; the timer is well past zero by the time any
+// phase can be marked.
+uint32_t g_phase_us[kBootPhaseCount] = {};
+
+}  // namespace
+
+void boot_mark(BootPhase phase) {
+    if (g_phase_us[phase] == 0) {
+        g_phase_us[phase] = time_us_32();
+    }
+}
+
+bool boot_marked(BootPhase phase) {
+    return g_phase_us[phase] != 0;
+}
+
+void boot_report() {
+    for (uint8_t i = 0; i < kBootPhaseCount; ++i) {
+        if (g_phase_us[i] == 0) continue;
+        printf("boot phase=%s us=%lu\n", kPhaseNames[i],
+               static_cast<unsigned long>(g_phase_us[i]));
+    }
+}
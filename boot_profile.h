@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+
+// Boot-phase timestamps, in microseconds since the hardware timer started
+// at reset. Each phase is recorded the first time it is marked, so marks
+// can sit on hot paths. Read back over the console with "boot".
+enum BootPhase : uint8_t {
+    kBootMainEntry = 0,      // runtime init and clock setup done
+    kBootBrainInit,          // g_brain.init_all() returned
+    kBootIndicator,          // first test entered and its number on the LEDs
+    kBootFirstTest,          // first run_test() frame done, after the indicator
+    kBootUsbInit,            // USB CDC stack started (deferred)
+    kBootUsbConnected,       // host opened the serial port
+    kBootCalibrationStart,   // lazy CV calibration load, on first CV-out test
+    kBootCalibrationDone,
+    kBootPhaseCount,
+};
+
+void boot_mark(BootPhase phase);
+bool boot_marked(BootPhase phase);
+
+// Prints one "boot phase=<name> us=<t>" line per recorded phase.
+void boot_report();
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "hardware/adc.h"
+#include "pico/stdlib.h"
+
+#include "brain-common/brain-gpio-setup.h"
+
+// Pins the diagnostics firmware drives or watches directly, bypassing the
+// SDK drivers (PIO and DMA paths). Numbers come from the SDK's board map so
+// there is a single source of truth for the wiring.
+
+// MCP4822 dual DAC on SPI: CV out A/B.
+constexpr uint kDacSckPin  = GPIO_BRAIN_DAC_SCK;
+constexpr uint kDacMosiPin = GPIO_BRAIN_DAC_TX;
+constexpr uint kDacCsPin   = GPIO_BRAIN_DAC_CS;
+
+// CV inputs, read by the ADC.
+constexpr uint kCvInAPin = GPIO_BRAIN_AUDIO_CV_IN_A;
+constexpr uint kCvInBPin = GPIO_BRAIN_AUDIO_CV_IN_B;
+constexpr uint kCvInAAdcInput = kCvInAPin - ADC_BASE_PIN;
+constexpr uint kCvInBAdcInput = kCvInBPin - ADC_BASE_PIN;
+
+// Pulse output, driven by a PWM slice for lock-in references.
+constexpr uint kPulseOutPin = GPIO_BRAIN_PULSE_OUTPUT;
+
+// Pulse input, timed by a PIO period counter.
+constexpr uint kPulseInPin = GPIO_BRAIN_PULSE_INPUT;
+
+// MIDI input, on a UART RX pin.
+constexpr uint kMidiRxPin = GPIO_BRAIN_MIDI_RX;
+
+// Buttons, read by the SDK; watched directly only by the logic analyzer.
+constexpr uint kButtonAPin = GPIO_BRAIN_BUTTON_1;
+constexpr uint kButtonBPin = GPIO_BRAIN_BUTTON_2;
+
+// VSYS through the Pico's 3:1 divider, on the last ADC pin.
+constexpr uint kVsysPin      = PICO_VSYS_PIN;
+constexpr uint kVsysAdcInput = kVsysPin - ADC_BASE_PIN;
+
+// Pot multiplexer: two select lines (S0, S1) and the shared wiper on an
+// ADC pin. The select lines must be adjacent for a PIO to drive both.
+constexpr uint kPotMuxS0Pin      = GPIO_BRAIN_POTMUX_S0;
+constexpr uint kPotMuxS1Pin      = GPIO_BRAIN_POTMUX_S1;
+constexpr uint kPotMuxAdcPin     = GPIO_BRAIN_POTMUX_ADC;
+constexpr uint kPotMuxAdcInput   = kPotMuxAdcPin - ADC_BASE_PIN;
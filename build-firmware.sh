@@ -5,14 +5,27 @@ set -euo pipefail
 ROOT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
 TARGET_NAME="brain-diagnostics"
 
+# Per-platform binary type: "default" (XIP with SRAM hot paths) or
+# "copy_to_ram". copy_to_ram is Pico 2 only; the RP2040 image isn't known
+# to fit in SRAM. Example: PICO2_BINARY_TYPE=copy_to_ram ./build-firmware.sh
+PICO_BINARY_TYPE="${PICO_BINARY_TYPE:-default}"
+PICO2_BINARY_TYPE="${PICO2_BINARY_TYPE:-default}"
+
+if [[ "$PICO_BINARY_TYPE" == "copy_to_ram" ]]; then
+	echo "PICO_BINARY_TYPE=copy_to_ram is not supported on RP2040" >&2
+	exit 1
+fi
+
 build_target() {
 	local board="$1"
 	local platform="$2"
 	local build_dir="$3"
 	local output_file="$4"
+	local binary_type="$5"
 
-	echo "Configuring ${board} (${platform})..."
-	cmake -S "$ROOT_DIR" -B "$ROOT_DIR/$build_dir" -DPICO_BOARD="$board" -DPICO_PLATFORM="$platform"
+	echo "Configuring ${board} (${platform}, ${binary_type})..."
+	cmake -S "$ROOT_DIR" -B "$ROOT_DIR/$build_dir" -DPICO_BOARD="$board" -DPICO_PLATFORM="$platform" \
+		-DBRAIN_DIAG_BINARY_TYPE="$binary_type"
 
 	echo "Building ${board} (${platform})..."
 	cmake --build "$ROOT_DIR/$build_dir"
@@ -28,7 +41,7 @@ build_target() {
 }
 
 # Build order: Pico first, then Pico 2.
-build_target "pico" "rp2040" "build-pico" "brain-diagnostics-pico.uf2"
-build_target "pico2" "rp2350-arm-s" "build-pico-2" "brain-diagnostics-pico-2.uf2"
+build_target "pico" "rp2040" "build-pico" "brain-diagnostics-pico.uf2" "$PICO_BINARY_TYPE"
+build_target "pico2" "rp2350-arm-s" "build-pico-2" "brain-diagnostics-pico-2.uf2" "$PICO2_BINARY_TYPE"
 
 echo "Done."
@@ -0,0 +1,436 @@
+#include "burn_in.h"
+
+#include <cmath>
+#include <cstdio>
+
+#include "hardware/adc.h"
+#include "pico/stdlib.h"
+
+#include "adc_capture.h"
+#include "brain_pins.h"
+#include "dac_fast.h"
+#include "dac_stream.h"
+#include "hot_path.h"
+#include "midi_rx.h"
+#include "pulse_pwm.h"
+#include "settings.h"
+#include "tone_detect.h"
+
+namespace {
+
+constexpr size_t   kTableWords      = 128;     // A and B interleaved
+constexpr uint32_t kWordRateHz      = 200000;
+constexpr int32_t  kAmplitudeMv     = 4000;
+constexpr double   kPulseHz         = 50000.0;
+constexpr uint32_t kCaptureRateHz   = 200000;  // four inputs together
+constexpr uint32_t kSettleMs        = 10;
+constexpr double   kFloorRatio      = 4.0 / 3.0;
+constexpr uint32_t kLedPeriodMs     = 1000;
+constexpr int32_t  kAdcMidScale     = 2048;
+constexpr double   kUvPerCount      = 10000000.0 / 4096.0;  // ±5 V nominal
+constexpr double   kVsysMvPerCount  = 3.0 * 3300.0 / 4096.0;
+constexpr double   kMinPatchedUv    = 100000.0;  // below this, no loop-back
+constexpr int32_t  kDroopMv         = 200;
+constexpr uint32_t kLoopOutlierUs   = 1000;
+constexpr double   kPi              = 3.14159265358979323846;
+constexpr uint32_t kBins            = 20;
+
+constexpr const char* kInputNames[2] = {"a", "b"};
+
+// Fixed bins of width `bin` from `lo`, with under/over for the rest.
+struct Histogram {
+    const char* name;
+    int32_t     lo;
+    int32_t     bin;
+    uint32_t    counts[kBins];
+    uint32_t    under;
+    uint32_t    over;
+
+    void setup(const char* n, int32_t low, int32_t width) {
+        name = n;
+        lo = low;
+        bin = width;
+        for (uint32_t& c : counts) c = 0;
+        under = 0;
+        over = 0;
+    }
+
+    void add(double v) {
+        double i = std::floor((v - lo) / bin);
+        if (i < 0.0) {
+            ++under;
+        } else if (i >= kBins) {
+            ++over;
+        } else {
+            ++counts[static_cast<uint32_t>(i)];
+        }
+    }
+
+    void print() const {
+        printf("burn hist name=%s lo=%ld bin=%ld under=%lu counts=", name, static_cast<long>(lo),
+               static_cast<long>(bin), static_cast<unsigned long>(under));
+        for (uint32_t i = 0; i < kBins; ++i) {
+            printf(i == 0 ? "%lu" : ",%lu", static_cast<unsigned long>(counts[i]));
+        }
+        printf(" over=%lu\n", static_cast<unsigned long>(over));
+    }
+};
+
+// Running extremes of a per-second figure.
+struct Range {
+    double min;
+    double max;
+    bool   any;
+
+    void clear() { any = false; }
+
+    void add(double v) {
+        if (!any || v < min) min = v;
+        if (!any || v > max) max = v;
+        any = true;
+    }
+};
+
+struct Channel {
+    ToneDetector tone;
+    ToneDetector floor;
+    int64_t      sum;
+    double       ref_amp_uv;
+    double       ref_dc_uv;
+    double       amp_uv;  // latest second
+    Range        amp_ppm;
+    Range        dc_uv;
+    double       floor_max_uv;
+    Histogram    amp_hist;
+    Histogram    dc_hist;
+    Histogram    floor_hist;
+};
+
+Channel   g_ch[2];
+Histogram g_vsys_hist;
+Histogram g_temp_hist;
+uint64_t  g_loop_hist[kBins];
+
+bool     g_active      = false;
+bool     g_failed      = false;
+uint16_t g_words[kTableWords];
+uint8_t  g_slot[4]     = {0, 1, 2, 3};  // CV a, CV b, VSYS, temperature
+uint32_t g_step        = 0;
+uint32_t g_floor_step  = 0;
+uint32_t g_settle      = 0;  // frames
+uint32_t g_target      = 0;  // frames per interval
+uint32_t g_dropped_base = 0;
+
+// Current interval.
+uint64_t g_vsys_sum    = 0;
+uint64_t g_temp_sum    = 0;
+uint32_t g_frames      = 0;
+
+// Whole run.
+uint32_t g_intervals   = 0;
+bool     g_have_ref    = false;
+double   g_ref_vsys_mv = 0.0;
+uint64_t g_run_vsys_sum = 0;  // for the mean over the whole run
+uint64_t g_run_frames  = 0;
+double   g_vsys_min_mv = 0.0;
+uint32_t g_droops      = 0;
+bool     g_in_droop    = false;
+Range    g_temp;
+double   g_temp_c      = 0.0;
+uint64_t g_passes      = 0;
+uint32_t g_loop_max_us = 0;
+uint32_t g_loop_outliers = 0;
+uint32_t g_last_pass_us = 0;
+bool     g_have_pass   = false;
+uint32_t g_start_ms    = 0;
+uint32_t g_report_ms   = 0;
+uint32_t g_midi_base[4];  // bytes, dropped, overruns, errors
+
+void clear_stats() {
+    g_ch[0].amp_hist.setup("amp_ppm_a", -1000, 100);
+    g_ch[1].amp_hist.setup("amp_ppm_b", -1000, 100);
+    g_ch[0].dc_hist.setup("dc_uv_a", -5000, 500);
+    g_ch[1].dc_hist.setup("dc_uv_b", -5000, 500);
+    g_ch[0].floor_hist.setup("floor_uv_a", 0, 10);
+    g_ch[1].floor_hist.setup("floor_uv_b", 0, 10);
+    for (Channel& c : g_ch) {
+        c.sum = 0;
+        c.amp_uv = 0.0;
+        c.amp_ppm.clear();
+        c.dc_uv.clear();
+        c.floor_max_uv = 0.0;
+    }
+    g_vsys_hist.setup("vsys_min_mv", 4000, 100);
+    g_temp_hist.setup("temp_c", 0, 5);
+    for (uint64_t& c : g_loop_hist) c = 0;
+    g_vsys_sum = 0;
+    g_temp_sum = 0;
+    g_frames = 0;
+    g_intervals = 0;
+    g_have_ref = false;
+    g_vsys_min_mv = 1e9;
+    g_run_vsys_sum = 0;
+    g_run_frames = 0;
+    g_droops = 0;
+    g_in_droop = false;
+    g_temp.clear();
+    g_passes = 0;
+    g_loop_max_us = 0;
+    g_loop_outliers = 0;
+    g_have_pass = false;
+    g_midi_base[0] = midi_rx_bytes();
+    g_midi_base[1] = midi_rx_dropped();
+    g_midi_base[2] = midi_rx_overruns();
+    g_midi_base[3] = midi_rx_errors();
+}
+
+// Both outputs from one table: even words drive A, odd words B, so each
+// gets kTableWords / 2 points per period at half the word rate.
+bool start_outputs(Brain& brain) {
+    if (!dac_fast_prepare(brain, kDacFastPiecewise)) return false;
+    constexpr size_t kPoints = kTableWords / 2;
+    for (size_t i = 0; i < kPoints; ++i) {
+        double a = std::sin(2.0 * kPi * i / kPoints);
+        double b = std::sin(2.0 * kPi * i / kPoints - kPi / 2.0);
+        g_words[2 * i] = dac_fast_word(0, static_cast<int32_t>(std::lround(kAmplitudeMv * a)),
+                                       kDacFastPiecewise);
+        g_words[2 * i + 1] = dac_fast_word(
+            1, static_cast<int32_t>(std::lround(kAmplitudeMv * b)), kDacFastPiecewise);
+    }
+    if (!dac_stream_start(g_words, kTableWords, kWordRateHz)) return false;
+    return pulse_pwm_start(kPulseHz);
+}
+
+bool start_capture() {
+    adc_gpio_init(kVsysPin);
+    adc_set_temp_sensor_enabled(true);
+    uint8_t mask = static_cast<uint8_t>((1u << kCvInAAdcInput) | (1u << kCvInBAdcInput) |
+                                        (1u << kVsysAdcInput) |
+                                        (1u << ADC_TEMPERATURE_CHANNEL_NUM));
+    if (!adc_capture_start(mask, kCaptureRateHz)) return false;
+    adc_capture_set_exclusive(true);
+    g_slot[0] = adc_capture_slot(kCvInAAdcInput);
+    g_slot[1] = adc_capture_slot(kCvInBAdcInput);
+    g_slot[2] = adc_capture_slot(kVsysAdcInput);
+    g_slot[3] = adc_capture_slot(ADC_TEMPERATURE_CHANNEL_NUM);
+    g_dropped_base = adc_capture_dropped();
+
+    double rate = static_cast<double>(adc_capture_rate_hz()) / adc_capture_inputs();
+    double freq = static_cast<double>(dac_stream_rate_hz()) / kTableWords * 2.0;
+    g_step = tone_phase_step(freq, rate);
+    g_floor_step = tone_phase_step(freq * kFloorRatio, rate);
+    for (Channel& c : g_ch) {
+        c.tone.reset(g_step);
+        c.floor.reset(g_floor_step);
+    }
+    g_settle = static_cast<uint32_t>(rate * kSettleMs / 1000);
+    // A second's worth of whole periods, so DC and harmonics don't leak in.
+    double periods = std::round(freq);
+    g_target = static_cast<uint32_t>(std::lround(periods * rate / freq));
+    return true;
+}
+
+void finish_interval() {
+    ++g_intervals;
+    double vsys_mv = g_vsys_sum * kVsysMvPerCount / g_frames;
+    g_temp_c = adc_capture_temp_c(static_cast<double>(g_temp_sum) / g_frames);
+    g_temp.add(g_temp_c);
+    g_temp_hist.add(g_temp_c);
+    g_run_vsys_sum += g_vsys_sum;
+    g_run_frames += g_frames;
+    if (!g_have_ref) g_ref_vsys_mv = vsys_mv;
+
+    for (Channel& c : g_ch) {
+        c.amp_uv = c.tone.amplitude() * kUvPerCount;
+        double dc_uv = (static_cast<double>(c.sum) / g_frames) * kUvPerCount;
+        double floor_uv = c.floor.amplitude() * kUvPerCount;
+        if (!g_have_ref) {
+            c.ref_amp_uv = c.amp_uv;
+            c.ref_dc_uv = dc_uv;
+        }
+        if (c.ref_amp_uv >= kMinPatchedUv) {
+            double ppm = (c.amp_uv / c.ref_amp_uv - 1.0) * 1e6;
+            c.amp_ppm.add(ppm);
+            c.amp_hist.add(ppm);
+        }
+        c.dc_uv.add(dc_uv - c.ref_dc_uv);
+        c.dc_hist.add(dc_uv - c.ref_dc_uv);
+        if (floor_uv > c.floor_max_uv) c.floor_max_uv = floor_uv;
+        c.floor_hist.add(floor_uv);
+        c.tone.clear();
+        c.floor.clear();
+        c.sum = 0;
+    }
+    g_have_ref = true;
+    g_vsys_sum = 0;
+    g_temp_sum = 0;
+    g_frames = 0;
+}
+
+void DIAG_HOT_FUNC(service_capture)() {
+    uint32_t seq = 0;
+    const uint16_t* block;
+    uint8_t stride = adc_capture_inputs();
+    uint32_t frames = kAdcBlockSamples / stride;
+    while ((block = adc_capture_acquire(seq)) != nullptr) {
+        uint32_t first = seq * frames;
+        if (first < g_settle) {
+            adc_capture_release();
+            continue;
+        }
+        // Phase from the sample index, so a dropped block is just missing
+        // data.
+        for (Channel& c : g_ch) {
+            c.tone.seek(first);
+            c.floor.seek(first);
+        }
+        int32_t vsys_min = INT32_MAX;
+        for (uint32_t f = 0; f < frames; ++f) {
+            const uint16_t* frame = block + f * stride;
+            for (uint8_t ch = 0; ch < 2; ++ch) {
+                int32_t x = static_cast<int32_t>(frame[g_slot[ch]]) - kAdcMidScale;
+                g_ch[ch].tone.push(x);
+                g_ch[ch].floor.push(x);
+                g_ch[ch].sum += x;
+            }
+            int32_t vsys = frame[g_slot[2]];
+            if (vsys < vsys_min) vsys_min = vsys;
+            g_vsys_sum += static_cast<uint32_t>(vsys);
+            g_temp_sum += frame[g_slot[3]];
+            if (++g_frames >= g_target) finish_interval();
+        }
+
+        double min_mv = vsys_min * kVsysMvPerCount;
+        g_vsys_hist.add(min_mv);
+        if (min_mv < g_vsys_min_mv) g_vsys_min_mv = min_mv;
+        bool droop = g_have_ref && min_mv < g_ref_vsys_mv - kDroopMv;
+        if (droop && !g_in_droop) ++g_droops;
+        g_in_droop = droop;
+        adc_capture_release();
+    }
+}
+
+void DIAG_HOT_FUNC(time_pass)() {
+    uint32_t now = time_us_32();
+    if (g_have_pass) {
+        uint32_t dt = now - g_last_pass_us;
+        uint32_t bin = 0;
+        while (bin + 1 < kBins && (dt >> (bin + 1)) != 0) ++bin;
+        ++g_loop_hist[bin];
+        ++g_passes;
+        if (dt > g_loop_max_us) g_loop_max_us = dt;
+        if (dt > kLoopOutlierUs) ++g_loop_outliers;
+    }
+    g_last_pass_us = now;
+    g_have_pass = true;
+}
+
+void DIAG_HOT_FUNC(sweep_leds)(Brain& brain, uint32_t now_ms) {
+    for (uint8_t i = 0; i < 6; ++i) {
+        uint32_t phase = (now_ms + i * kLedPeriodMs / 6) % kLedPeriodMs;
+        uint32_t up = phase < kLedPeriodMs / 2 ? phase : kLedPeriodMs - phase;
+        brain.leds.set_brightness(i, static_cast<uint8_t>(up * 255 / (kLedPeriodMs / 2)));
+    }
+}
+
+void print_range(const char* name, const Range& r) {
+    if (r.any) {
+        printf(" %s_min=%.1f %s_max=%.1f", name, r.min, name, r.max);
+    } else {
+        printf(" %s_min=- %s_max=-", name, name);
+    }
+}
+
+void report(uint32_t now_ms) {
+    printf("burn report elapsed_s=%lu intervals=%lu dropped_blocks=%lu\n",
+           static_cast<unsigned long>((now_ms - g_start_ms) / 1000),
+           static_cast<unsigned long>(g_intervals),
+           static_cast<unsigned long>(adc_capture_dropped() - g_dropped_base));
+    for (uint8_t ch = 0; ch < 2; ++ch) {
+        const Channel& c = g_ch[ch];
+        printf("burn output input=%s amp_mv=%.3f", kInputNames[ch], c.amp_uv / 1000.0);
+        print_range("amp_ppm", c.amp_ppm);
+        print_range("dc_uv", c.dc_uv);
+        printf(" floor_uv_max=%.2f\n", c.floor_max_uv);
+    }
+    printf("burn loop passes=%llu max_us=%lu over_1ms=%lu\n",
+           static_cast<unsigned long long>(g_passes),
+           static_cast<unsigned long>(g_loop_max_us), static_cast<unsigned long>(g_loop_outliers));
+    printf("burn midi bytes=%lu dropped=%lu overruns=%lu errors=%lu\n",
+           static_cast<unsigned long>(midi_rx_bytes() - g_midi_base[0]),
+           static_cast<unsigned long>(midi_rx_dropped() - g_midi_base[1]),
+           static_cast<unsigned long>(midi_rx_overruns() - g_midi_base[2]),
+           static_cast<unsigned long>(midi_rx_errors() - g_midi_base[3]));
+    double vsys_mean_mv =
+        g_run_frames ? g_run_vsys_sum * kVsysMvPerCount / g_run_frames : 0.0;
+    printf("burn vsys mean_mv=%.0f min_mv=%.0f droops=%lu\n", vsys_mean_mv,
+           g_have_ref ? g_vsys_min_mv : 0.0, static_cast<unsigned long>(g_droops));
+    if (g_temp.any) {
+        printf("burn temp min_c=%.1f max_c=%.1f last_c=%.1f\n", g_temp.min, g_temp.max, g_temp_c);
+    }
+    for (const Channel& c : g_ch) {
+        c.amp_hist.print();
+        c.dc_hist.print();
+        c.floor_hist.print();
+    }
+    g_vsys_hist.print();
+    g_temp_hist.print();
+    printf("burn hist name=loop_us scale=log2 counts=");
+    for (uint32_t i = 0; i < kBins; ++i) {
+        printf(i == 0 ? "%llu" : ",%llu", static_cast<unsigned long long>(g_loop_hist[i]));
+    }
+    printf("\nburn end\n");
+}
+
+}  // namespace
+
+void burn_in_stop() {
+    if (!g_active) return;
+    g_active = false;
+    adc_capture_stop();
+    adc_set_temp_sensor_enabled(false);
+    pulse_pwm_stop();
+    dac_stream_stop();
+    if (dac_fast_ready(kDacFastPiecewise)) {
+        dac_fast_set_millivolts(0, 0, kDacFastPiecewise);
+        dac_fast_set_millivolts(1, 0, kDacFastPiecewise);
+    }
+}
+
+void burn_in_enter(Brain& /*brain*/) {
+    burn_in_stop();
+    g_failed = false;
+}
+
+void DIAG_HOT_FUNC(burn_in_run)(Brain& brain, uint32_t now_ms) {
+    if (g_failed) return;
+    if (!g_active) {
+        // Building the DAC fit uses the SDK path, so it must happen
+        // before the stream takes the DAC pins.
+        g_active = true;
+        if (!start_outputs(brain) || !start_capture()) {
+            burn_in_stop();
+            g_failed = true;
+            printf("burn error=start-failed\n");
+            return;
+        }
+        clear_stats();
+        g_start_ms = now_ms;
+        g_report_ms = now_ms;
+        printf("burn start freq_hz=%.2f pulse_hz=%.1f report_s=%ld\n",
+               static_cast<double>(dac_stream_rate_hz()) / kTableWords * 2.0,
+               pulse_pwm_freq_hz(), static_cast<long>(setting(kSettingBurnReportS)));
+    }
+
+    time_pass();
+    sweep_leds(brain, now_ms);
+    service_capture();
+    dac_stream_service();
+
+    auto every_ms = static_cast<uint32_t>(setting(kSettingBurnReportS)) * 1000;
+    if (now_ms - g_report_ms < every_ms) return;
+    g_report_ms = now_ms;
+    report(now_ms);
+    // Printing the report is this mode's own stall; leave it out.
+    g_have_pass = false;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+
+#include "tests.h"
+
+// kTestBurnIn: soak test that keeps every peripheral busy at once and
+// gathers statistics over hours. Patch CV out 1 to CV in 1 and CV out 2
+// to CV in 2 for the output figures to mean anything.
+//
+// Load, all running together:
+//   - both CV outputs play a 4 V-peak 1562.5 Hz sine from the DMA-paced
+//     DAC stream (B a quarter period behind A), 200k DAC words a second;
+//   - pulse out runs a 50 kHz square wave from a PWM slice;
+//   - the six LEDs sweep their brightness, staggered by a sixth of a
+//     second each;
+//   - the ADC captures CV in 1, CV in 2, VSYS and the temperature sensor
+//     at 50 kHz each;
+//   - MIDI keeps being received and parsed as usual.
+//
+// Every second each CV input gets a lock-in reading of the sine amplitude
+// and an off-frequency noise floor (see tone_detect.h), and its DC mean.
+// Amplitude and DC are compared against the first second. VSYS is checked
+// for its minimum over every 2.56 ms block of samples; a block more than
+// 200 mV below the first second's mean counts as a droop. Every main loop
+// pass is timed.
+//
+// All of it goes into fixed-size histograms, so memory stays constant
+// however long the run. Every burn_report_s seconds (a setting) the whole
+// run so far is printed:
+//
+//   burn report elapsed_s=<s> intervals=<n> dropped_blocks=<n>
+//   burn output input=<a|b> amp_mv=<mv> amp_ppm_min=<p> amp_ppm_max=<p> dc_uv_min=<uv> dc_uv_max=<uv> floor_uv_max=<uv>
+//   burn loop passes=<n> max_us=<us> over_1ms=<n>
+//   burn midi bytes=<n> dropped=<n> overruns=<n> errors=<n>
+//   burn vsys mean_mv=<mv> min_mv=<mv> droops=<n>
+//   burn temp min_c=<c> max_c=<c> last_c=<c>
+//   burn hist name=<name> lo=<v> bin=<w> under=<n> counts=<c0,...,c19> over=<n>
+//   burn hist name=loop_us scale=log2 counts=<c0,...,c19>
+//   burn end
+//
+// Histograms: amp_ppm_a/b, dc_uv_a/b and floor_uv_a/b per second,
+// vsys_min_mv per block, temp_c per second. loop_us bin k counts passes
+// of 2^k to 2^(k+1) us. Without a loop-back, amp_mv is near zero and the
+// amplitude figures are left out (amp_ppm_min=- etc.).
+//
+// Buttons and pots are not read while the mode runs.
+void burn_in_stop();
+void burn_in_enter(Brain& brain);
+void burn_in_run(Brain& brain, uint32_t now_ms);
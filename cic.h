@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+
+// Third-order CIC decimator with a 3-tap droop-compensation FIR, all in
+// integer arithmetic. Input is a signed ADC sample (counts around mid
+// scale); output is the decimated mean in counts with kCicFracBits extra
+// fractional bits, so the resolution gained by averaging is kept.
+//
+// Integrators run modulo 2^64, which is exact as long as the decimated
+// output fits: 12 bits + 3 * log2(R) <= 63 for every supported ratio.
+
+constexpr uint8_t kCicOrder     = 3;
+constexpr uint8_t kCicFracBits  = 8;
+constexpr uint8_t kCicMaxLog2   = 8;  // R up to 256
+
+class CicDecimator {
+public:
+    void reset(uint8_t log2_ratio) {
+        log2_ratio_ = log2_ratio > kCicMaxLog2 ? kCicMaxLog2 : log2_ratio;
+        for (uint8_t i = 0; i < kCicOrder; ++i) {
+            integ_[i] = 0;
+            comb_[i] = 0;
+        }
+        comp_[0] = comp_[1] = 0;
+        count_ = 0;
+        primed_ = 0;
+    }
+
+    uint32_t ratio() const { return 1u << log2_ratio_; }
+
+    // Feeds one sample. Returns true and sets `out` every R samples, once
+    // the filter has settled.
+    bool push(int32_t sample, int32_t& out) {
+        integ_[0] += sample;
+        integ_[1] += integ_[0];
+        integ_[2] += integ_[1];
+        if (++count_ < ratio()) return false;
+        count_ = 0;
+
+        int64_t y = integ_[2];
+        for (uint8_t i = 0; i < kCicOrder; ++i) {
+            int64_t prev = comb_[i];
+            comb_[i] = y;
+            y -= prev;
+        }
+        // CIC gain is R^N; keep kCicFracBits below the LSB.
+        int shift = kCicOrder * log2_ratio_ - kCicFracBits;
+        int32_t cic = static_cast<int32_t>(shift >= 0 ? y >> shift : y * (1 << -shift));
+
+        // Droop compensation, DC gain 1: (-3 x[n] + 22 x[n-1] - 3 x[n-2]) / 16.
+        int32_t comp = (22 * comp_[0] - 3 * (cic + comp_[1])) / 16;
+        comp_[1] = comp_[0];
+        comp_[0] = cic;
+
+        // The combs and the FIR need a few outputs of history.
+        if (primed_ < kCicOrder + 2) {
+            ++primed_;
+            return false;
+        }
+        out = comp;
+        return true;
+    }
+
+private:
+    int64_t  integ_[kCicOrder];
+    int64_t  comb_[kCicOrder];
+    int32_t  comp_[2];
+    uint32_t count_   = 0;
+    uint8_t  log2_ratio_ = 0;
+    uint8_t  primed_  = 0;
+};
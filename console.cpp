@@ -0,0 +1,110 @@
+#include "console.h"
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+#include "pico/stdlib.h"
+
+namespace {
+
+constexpr size_t kLineMax = 48;
+
+struct CommandName {
+    const char*        name;
+    ConsoleCommandType type;
+};
+
+constexpr CommandName kCommands[] = {
+    {"id",       kConsoleId},
+    {"test",     kConsoleTest},
+    {"status",   kConsoleStatus},
+    {"boot",     kConsoleBoot},
+    {"midi",     kConsoleMidi},
+    {"watchdog", kConsoleWatchdog},
+    {"bus",      kConsoleBus},
+    {"set",      kConsoleSet},
+};
+
+char   g_line[kLineMax];
+size_t g_line_len      = 0;
+bool   g_line_overflow = false;
+
+bool parse_int(const char* text, int32_t& value) {
+    char* end = nullptr;
+    long v = std::strtol(text, &end, 0);
+    if (end == text || *end != '\0') return false;
+    value = static_cast<int32_t>(v);
+    return true;
+}
+
+ConsoleCommand parse_line(char* line) {
+    ConsoleCommand cmd;
+    cmd.type = kConsoleUnknown;
+
+    char* word = std::strtok(line, " \t");
+    if (word == nullptr) {
+        cmd.type = kConsoleNone;
+        return cmd;
+    }
+    for (const CommandName& c : kCommands) {
+        if (std::strcmp(word, c.name) == 0) {
+            cmd.type = c.type;
+            break;
+        }
+    }
+
+    // Optional non-numeric key, then optional integer argument.
+    char* tok = std::strtok(nullptr, " \t");
+    if (tok != nullptr && !parse_int(tok, cmd.arg)) {
+        if (std::strlen(tok) >= sizeof(cmd.key)) {
+            cmd.type = kConsoleUnknown;
+            return cmd;
+        }
+        std::strcpy(cmd.key, tok);
+        tok = std::strtok(nullptr, " \t");
+    }
+    if (tok != nullptr) {
+        if (parse_int(tok, cmd.arg)) {
+            cmd.has_arg = true;
+        } else {
+            cmd.type = kConsoleUnknown;
+        }
+    }
+    if (std::strtok(nullptr, " \t") != nullptr) cmd.type = kConsoleUnknown;
+    return cmd;
+}
+
+}  // namespace
+
+bool console_poll(ConsoleCommand& cmd) {
+    // Never block: the main loop drives real-time test output and must keep
+    // spinning whether or not a host is attached.
+    while (true) {
+        int c = getchar_timeout_us(0);
+        if (c == PICO_ERROR_TIMEOUT) return false;
+
+        if (c == '\r' || c == '\n') {
+            if (g_line_len == 0 && !g_line_overflow) continue;  // blank / CRLF
+            bool overflow = g_line_overflow;
+            g_line[g_line_len] = '\0';
+            g_line_len = 0;
+            g_line_overflow = false;
+
+            if (overflow) {
+                cmd = ConsoleCommand{};
+                cmd.type = kConsoleUnknown;
+            } else {
+                cmd = parse_line(g_line);
+                if (cmd.type == kConsoleNone) continue;
+            }
+            return true;
+        }
+
+        if (g_line_len < kLineMax - 1) {
+            g_line[g_line_len++] = static_cast<char>(c);
+        } else {
+            g_line_overflow = true;
+        }
+    }
+}
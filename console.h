@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+
+// Line-based command console on the USB CDC port. Host tools (see host/)
+// use it to identify a board and select tests; Button A keeps working
+// alongside it. Commands are lower-case words terminated by '\n', with an
+// optional key and an optional integer argument:
+//
+//   id          -> "id <unique-id> platform=<rp2040|rp2350>"
+//   test <n>    -> "ok test=<n>"     (n is the 0-based TestId)
+//   status      -> "status test=<n> uptime_ms=<t>"
+//   boot        -> one "boot phase=<name> us=<t>" line per boot phase
+//   midi        -> "midi bytes=<n> dropped=<n> ..." (see midi_rx.h)
+//   watchdog    -> "watchdog hangs=<n> ..." and per-phase lines (see hang_guard.h)
+//   bus         -> "bus mode=<events|polled> ..." (see event_bus.h)
+//   set         -> one "setting <name>=<value>" line per setting
+//   set <k> <v> -> "ok <k>=<v>"      (see settings.h)
+//
+// Anything else is answered with "err <reason>". Replies and result lines
+// are plain "<tag> key=value ..." text so they stay readable in a terminal.
+
+// Platform tag used in the id reply and in result lines.
+#if PICO_RP2040
+constexpr const char* kPlatformName = "rp2040";
+#else
+constexpr const char* kPlatformName = "rp2350";
+#endif
+
+enum ConsoleCommandType : uint8_t {
+    kConsoleNone = 0,
+    kConsoleId,
+    kConsoleTest,
+    kConsoleStatus,
+    kConsoleBoot,
+    kConsoleMidi,
+    kConsoleWatchdog,
+    kConsoleBus,
+    kConsoleSet,
+    kConsoleUnknown,
+};
+
+struct ConsoleCommand {
+    ConsoleCommandType type    = kConsoleNone;
+    char               key[16] = {};
+    bool               has_arg = false;
+    int32_t            arg     = 0;
+};
+
+// Drains pending USB input without blocking. Returns true and fills `cmd`
+// when a complete line has been received.
+bool console_poll(ConsoleCommand& cmd);
@@ -0,0 +1,97 @@
+#include "crosstalk.h"
+
+#include <cmath>
+#include <cstdio>
+
+#include "lockin.h"
+
+namespace {
+
+constexpr int32_t  kToneMv        = 2000;
+constexpr uint32_t kIntegrationMs = 1000;
+
+enum Phase : uint8_t {
+    kPhaseStart = 0,
+    kPhaseMeasure,
+    kPhaseDone,
+};
+
+Phase   g_phase = kPhaseDone;
+uint8_t g_drive = 0;
+double  g_level_uv[2][2];  // [drive][input]
+double  g_floor_uv[2];
+
+constexpr const char* kNames[2] = {"a", "b"};
+
+double to_db(double uv) {
+    double rel = uv / (kToneMv * 1000.0);
+    return rel > 0.0 ? 20.0 * std::log10(rel) : -999.0;
+}
+
+void finish(const char* error) {
+    lockin_stop();
+    if (error != nullptr) printf("xtalk error=%s\n", error);
+    printf("xtalk_done\n");
+    g_phase = kPhaseDone;
+}
+
+bool start_drive(Brain& brain, uint8_t drive) {
+    g_drive = drive;
+    LockInConfig config;
+    config.reference = drive == 0 ? kLockInCvOutA : kLockInCvOutB;
+    config.amplitude_mv = kToneMv;
+    config.integration_ms = kIntegrationMs;
+    return lockin_start(brain, config);
+}
+
+void report() {
+    for (uint8_t drive = 0; drive < 2; ++drive) {
+        for (uint8_t input = 0; input < 2; ++input) {
+            double uv = g_level_uv[drive][input];
+            printf("xtalk drive=%s input=%s level_uv=%.1f db=%.1f\n", kNames[drive],
+                   kNames[input], uv, to_db(uv));
+        }
+    }
+    for (uint8_t input = 0; input < 2; ++input) {
+        printf("xtalk input=%s floor_uv=%.1f floor_db=%.1f\n", kNames[input],
+               g_floor_uv[input], to_db(g_floor_uv[input]));
+    }
+}
+
+}  // namespace
+
+void crosstalk_enter(Brain& /*brain*/) {
+    g_phase = kPhaseStart;
+}
+
+void crosstalk_run(Brain& brain, uint32_t /*now_ms*/) {
+    switch (g_phase) {
+        case kPhaseStart:
+            // Blocks for the one-time DAC table sweep on first use.
+            if (!start_drive(brain, 0)) {
+                finish("start-failed");
+                return;
+            }
+            g_phase = kPhaseMeasure;
+            break;
+
+        case kPhaseMeasure:
+            if (!lockin_service()) return;
+            for (uint8_t ch = 0; ch < 2; ++ch) {
+                const LockInResult& r = lockin_result(ch);
+                g_level_uv[g_drive][ch] = r.amplitude_uv;
+                // The floor is the same with either drive; keep the worse.
+                if (g_drive == 0 || r.floor_uv > g_floor_uv[ch]) g_floor_uv[ch] = r.floor_uv;
+            }
+            if (g_drive == 0) {
+                if (!start_drive(brain, 1)) finish("start-failed");
+                return;
+            }
+            report();
+            finish(nullptr);
+            break;
+
+        case kPhaseDone:
+            break;
+    }
+}
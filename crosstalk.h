@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+
+#include "tests.h"
+
+// kTestCvCrosstalk: measures the 2x2 coupling matrix between the CV
+// outputs and the CV inputs. Patch CV out 1 to CV in 1 and CV out 2 to
+// CV in 2, then select the mode.
+//
+// Each output in turn is the reference of a one-second lock-in
+// measurement (lockin.h): a 2 V-peak sine at 195.3 Hz while the other
+// output holds 0 V, so coupling is resolved well below the broadband ADC
+// noise. The lock-in's off-frequency detector gives the detection floor.
+// Levels are peak microvolts with the nominal input scaling, and dB is
+// relative to the driven amplitude:
+//
+//   xtalk drive=<a|b> input=<a|b> level_uv=<uv> db=<db>
+//   xtalk input=<a|b> floor_uv=<uv> floor_db=<db>
+//   xtalk_done
+//
+// Buttons and pots are not read while a drive is being measured.
+void crosstalk_enter(Brain& brain);
+void crosstalk_run(Brain& brain, uint32_t now_ms);
@@ -0,0 +1,231 @@
+#include "cv_drift.h"
+
+#include <cmath>
+#include <cstdio>
+
+#include "hardware/adc.h"
+
+#include "adc_capture.h"
+#include "brain_pins.h"
+#include "settings.h"
+
+namespace {
+
+constexpr uint32_t kCvRateHz         = 200000;  // both inputs together
+constexpr uint32_t kCvSettleBlocks   = 2;
+constexpr uint32_t kCvBlocks         = 64;      // about 160 ms
+constexpr uint32_t kTempRateHz       = 20000;
+constexpr uint32_t kTempSettleBlocks = 1;
+constexpr uint32_t kTempBlocks       = 8;
+constexpr uint32_t kHoldMs           = 1000;    // before the first measurement
+constexpr double   kMinSpanC         = 1.0;
+constexpr int32_t  kAdcMidScale      = 2048;
+constexpr double   kMvPerCount       = 10000.0 / 4096.0;  // ±5 V nominal
+
+constexpr const char* kInputNames[2] = {"a", "b"};
+
+enum Phase : uint8_t {
+    kPhaseStart = 0,
+    kPhaseWait,
+    kPhaseTempBefore,
+    kPhaseCv,
+    kPhaseTempAfter,
+    kPhaseFailed,
+};
+
+// Least squares of y against x, from running sums.
+struct Fit {
+    double n, sx, sy, sxx, sxy, syy;
+    double lo, hi;  // x span
+
+    void clear() { *this = Fit{}; }
+
+    void add(double x, double y) {
+        if (n == 0 || x < lo) lo = x;
+        if (n == 0 || x > hi) hi = x;
+        n += 1;
+        sx += x;
+        sy += y;
+        sxx += x * x;
+        sxy += x * y;
+        syy += y * y;
+    }
+};
+
+Phase    g_phase      = kPhaseStart;
+bool     g_active     = false;
+uint32_t g_next_ms    = 0;
+uint8_t  g_slot[2]    = {0, 1};
+uint32_t g_blocks     = 0;
+int64_t  g_sum[2]     = {0, 0};
+uint32_t g_samples    = 0;
+double   g_temp_before = 0.0;
+double   g_mv[2]      = {0.0, 0.0};
+double   g_first_mv[2] = {0.0, 0.0};
+uint32_t g_count      = 0;
+Fit      g_fit[2];
+
+bool start_temp() {
+    adc_set_temp_sensor_enabled(true);
+    if (!adc_capture_start(1u << ADC_TEMPERATURE_CHANNEL_NUM, kTempRateHz)) return false;
+    adc_capture_set_exclusive(true);
+    g_active = true;
+    g_blocks = 0;
+    g_sum[0] = 0;
+    g_samples = 0;
+    return true;
+}
+
+bool start_cv() {
+    adc_set_temp_sensor_enabled(false);
+    uint8_t mask = static_cast<uint8_t>((1u << kCvInAAdcInput) | (1u << kCvInBAdcInput));
+    if (!adc_capture_start(mask, kCvRateHz)) return false;
+    adc_capture_set_exclusive(true);
+    g_active = true;
+    g_slot[0] = adc_capture_slot(kCvInAAdcInput);
+    g_slot[1] = adc_capture_slot(kCvInBAdcInput);
+    g_blocks = 0;
+    g_sum[0] = 0;
+    g_sum[1] = 0;
+    g_samples = 0;
+    return true;
+}
+
+// Sums whole blocks past the first `settle` ones; true once `blocks` have
+// been taken.
+bool collect(uint32_t settle, uint32_t blocks, uint8_t channels) {
+    uint32_t seq = 0;
+    const uint16_t* block;
+    uint8_t stride = adc_capture_inputs();
+    uint32_t frames = kAdcBlockSamples / stride;
+    while (g_blocks < blocks && (block = adc_capture_acquire(seq)) != nullptr) {
+        if (seq >= settle) {
+            for (uint32_t f = 0; f < frames; ++f) {
+                const uint16_t* frame = block + f * stride;
+                for (uint8_t ch = 0; ch < channels; ++ch) {
+                    g_sum[ch] += frame[channels == 1 ? 0 : g_slot[ch]];
+                }
+            }
+            g_samples += frames;
+            ++g_blocks;
+        }
+        adc_capture_release();
+    }
+    return g_blocks >= blocks;
+}
+
+double temp_mean_c() {
+    return adc_capture_temp_c(static_cast<double>(g_sum[0]) / g_samples);
+}
+
+void fail() {
+    cv_drift_stop();
+    g_phase = kPhaseFailed;
+    printf("drift error=start-failed\n");
+}
+
+void report_fit(uint8_t ch) {
+    const Fit& f = g_fit[ch];
+    double span = f.hi - f.lo;
+    double den = f.n * f.sxx - f.sx * f.sx;
+    if (f.n < 3 || span < kMinSpanC || den <= 0.0) return;
+    double slope = (f.n * f.sxy - f.sx * f.sy) / den;
+    double var_y = f.n * f.syy - f.sy * f.sy;
+    double r2 = var_y > 0.0 ? slope * slope * den / var_y : 0.0;
+    printf("drift fit input=%s mv_per_c=%.4f r2=%.3f span_c=%.2f points=%lu\n", kInputNames[ch],
+           slope, r2, span, static_cast<unsigned long>(f.n));
+}
+
+void finish_measurement(double temp_after) {
+    double temp = (g_temp_before + temp_after) / 2.0;
+    ++g_count;
+    if (g_count == 1) {
+        g_first_mv[0] = g_mv[0];
+        g_first_mv[1] = g_mv[1];
+    }
+    printf("drift n=%lu temp_c=%.2f a_mv=%.3f b_mv=%.3f da_mv=%.3f db_mv=%.3f\n",
+           static_cast<unsigned long>(g_count), temp, g_mv[0], g_mv[1], g_mv[0] - g_first_mv[0],
+           g_mv[1] - g_first_mv[1]);
+    for (uint8_t ch = 0; ch < 2; ++ch) {
+        g_fit[ch].add(temp, g_mv[ch]);
+        report_fit(ch);
+    }
+}
+
+}  // namespace
+
+void cv_drift_stop() {
+    if (!g_active) return;
+    g_active = false;
+    adc_capture_stop();
+    adc_set_temp_sensor_enabled(false);
+}
+
+void cv_drift_enter(Brain& /*brain*/) {
+    g_phase = kPhaseStart;
+}
+
+void cv_drift_run(Brain& brain, uint32_t now_ms) {
+    switch (g_phase) {
+        case kPhaseStart:
+            ensure_calibration_loaded(brain);
+            brain.outputs.set_output_range(kOutputsChannelA, kOutputsRangeMinus5To5V);
+            brain.outputs.set_output_range(kOutputsChannelB, kOutputsRangeMinus5To5V);
+            brain.outputs.set_voltage_calibrated_millivolts(kOutputsChannelA,
+                                                            setting(kSettingDriftAMv));
+            brain.outputs.set_voltage_calibrated_millivolts(kOutputsChannelB,
+                                                            setting(kSettingDriftBMv));
+            g_count = 0;
+            g_fit[0].clear();
+            g_fit[1].clear();
+            g_next_ms = now_ms + kHoldMs;
+            g_phase = kPhaseWait;
+            break;
+
+        case kPhaseWait:
+            if (static_cast<int32_t>(now_ms - g_next_ms) < 0) break;
+            if (!start_temp()) {
+                fail();
+                break;
+            }
+            g_phase = kPhaseTempBefore;
+            break;
+
+        case kPhaseTempBefore:
+            if (!collect(kTempSettleBlocks, kTempBlocks, 1)) break;
+            g_temp_before = temp_mean_c();
+            if (!start_cv()) {
+                fail();
+                break;
+            }
+            g_phase = kPhaseCv;
+            break;
+
+        case kPhaseCv:
+            if (!collect(kCvSettleBlocks, kCvBlocks, 2)) break;
+            for (uint8_t ch = 0; ch < 2; ++ch) {
+                double mean = static_cast<double>(g_sum[ch]) / g_samples;
+                g_mv[ch] = (mean - kAdcMidScale) * kMvPerCount;
+            }
+            if (!start_temp()) {
+                fail();
+                break;
+            }
+            g_phase = kPhaseTempAfter;
+            break;
+
+        case kPhaseTempAfter: {
+            if (!collect(kTempSettleBlocks, kTempBlocks, 1)) break;
+            double temp_after = temp_mean_c();
+            // Buttons and pots come back between measurements.
+            cv_drift_stop();
+            finish_measurement(temp_after);
+            g_next_ms = now_ms + static_cast<uint32_t>(setting(kSettingDriftPeriodS)) * 1000;
+            g_phase = kPhaseWait;
+            break;
+        }
+
+        case kPhaseFailed:
+            break;
+    }
+}
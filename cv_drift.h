@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+
+#include "tests.h"
+
+// kTestCvDrift: logs how the CV outputs drift with the board's
+// temperature. Patch CV out 1 to CV in 1 and CV out 2 to CV in 2, then
+// leave the board to warm up (or put it in the rack).
+//
+// The outputs hold drift_a_mv and drift_b_mv (settings) through the SDK's
+// calibrated path. Every drift_period_s seconds the looped-back levels are
+// measured and paired with the chip's temperature sensor, which sits on
+// the same ADC. The sensor is never part of the CV round-robin: it is read
+// on its own just before and just after the CV capture, and switched off
+// in between, so its slow settling can't leak into the CV samples. The
+// pair is averaged to the temperature at the middle of the CV capture.
+//
+// After each measurement:
+//
+//   drift n=<n> temp_c=<c> a_mv=<mv> b_mv=<mv> da_mv=<mv> db_mv=<mv>
+//   drift fit input=<a|b> mv_per_c=<s> r2=<r2> span_c=<c> points=<n>
+//
+// da_mv/db_mv are the change since the first measurement. The fit is a
+// least-squares line of level against temperature over every measurement
+// so far; it is only printed once the temperature has moved by 1 C. Levels
+// use the nominal input scaling, so they are good for drift, not for
+// absolute accuracy.
+void cv_drift_stop();
+void cv_drift_enter(Brain& brain);
+void cv_drift_run(Brain& brain, uint32_t now_ms);
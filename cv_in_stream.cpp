@@ -0,0 +1,156 @@
+#include "cv_in_stream.h"
+
+#include <cmath>
+#include <cstdio>
+
+#include "adc_capture.h"
+#include "brain_pins.h"
+#include "cic.h"
+#include "hot_path.h"
+#include "settings.h"
+
+namespace {
+
+constexpr uint32_t kCaptureRateHz   = 200000;  // both channels together
+constexpr int32_t  kAdcMidScale     = 2048;
+constexpr int64_t  kFullScaleUv     = 10000000;  // ±5 V across 4096 counts
+constexpr uint32_t kResolutionOutputs = 256;
+constexpr uint8_t  kResolutionLog2[] = {0, 2, 3, 4, 5, 6, 7, 8};
+
+CicDecimator g_cic[2];
+int32_t      g_value[2]  = {0, 0};
+uint8_t      g_slot[2]   = {0, 1};
+uint8_t      g_log2_ratio = 6;
+
+// Resolution sweep state.
+struct NoiseStats {
+    uint32_t n;
+    int64_t  sum;
+    int64_t  sum_sq;
+};
+
+NoiseStats g_stats[2];
+uint8_t    g_res_step     = 0;
+bool       g_res_done     = false;
+double     g_raw_bits[2]  = {0.0, 0.0};
+
+uint8_t log2_floor(uint32_t v) {
+    uint8_t r = 0;
+    while (v > 1) {
+        v >>= 1;
+        ++r;
+    }
+    return r;
+}
+
+bool start_capture(uint8_t log2_ratio) {
+    g_log2_ratio = log2_ratio;
+    g_cic[0].reset(log2_ratio);
+    g_cic[1].reset(log2_ratio);
+    uint8_t mask = static_cast<uint8_t>((1u << kCvInAAdcInput) | (1u << kCvInBAdcInput));
+    if (!adc_capture_start(mask, kCaptureRateHz)) return false;
+    g_slot[0] = adc_capture_slot(kCvInAAdcInput);
+    g_slot[1] = adc_capture_slot(kCvInBAdcInput);
+    return true;
+}
+
+// Runs every pending block through the decimators; `on_output` sees each
+// decimated value (or each raw sample, at ratio 1).
+template <typename Fn>
+void consume(Fn&& on_output) {
+    uint32_t seq = 0;
+    const uint16_t* block;
+    uint8_t stride = adc_capture_inputs();
+    while ((block = adc_capture_acquire(seq)) != nullptr) {
+        for (size_t i = 0; i + stride <= kAdcBlockSamples; i += stride) {
+            for (uint8_t ch = 0; ch < 2; ++ch) {
+                int32_t x = static_cast<int32_t>(block[i + g_slot[ch]]) - kAdcMidScale;
+                int32_t y;
+                if (g_log2_ratio == 0) {
+                    y = x * (1 << kCicFracBits);
+                } else if (!g_cic[ch].push(x, y)) {
+                    continue;
+                }
+                g_value[ch] = y;
+                on_output(ch, y);
+            }
+        }
+        adc_capture_release();
+    }
+}
+
+void report_step(uint8_t log2_ratio) {
+    static constexpr const char* kNames[2] = {"a", "b"};
+    uint32_t rate = adc_capture_rate_hz() / adc_capture_inputs() >> log2_ratio;
+    for (uint8_t ch = 0; ch < 2; ++ch) {
+        const NoiseStats& s = g_stats[ch];
+        double scale = 1.0 / (1 << kCicFracBits);
+        double mean = static_cast<double>(s.sum) / s.n;
+        double var = static_cast<double>(s.sum_sq) / s.n - mean * mean;
+        double sigma_counts = (var > 0.0 ? std::sqrt(var) : 0.0) * scale;
+        // Effective resolution: log2(full scale / rms noise). A perfectly
+        // quiet reading is capped at the filter's output resolution.
+        double floor_counts = scale / std::sqrt(12.0);
+        if (sigma_counts < floor_counts) sigma_counts = floor_counts;
+        double bits = std::log2(4096.0 / sigma_counts);
+        if (log2_ratio == 0) g_raw_bits[ch] = bits;
+        double noise_uv = sigma_counts * static_cast<double>(kFullScaleUv) / 4096.0;
+        printf("cvres channel=%s ratio=%lu rate_hz=%lu noise_uv=%.1f bits=%.2f gain_bits=%.2f\n",
+               kNames[ch], static_cast<unsigned long>(1u << log2_ratio),
+               static_cast<unsigned long>(rate), noise_uv, bits, bits - g_raw_bits[ch]);
+    }
+}
+
+}  // namespace
+
+bool cv_in_stream_start() {
+    return start_capture(log2_floor(static_cast<uint32_t>(setting(kSettingCicDecimation))));
+}
+
+void DIAG_HOT_FUNC(cv_in_stream_service)() {
+    consume([](uint8_t, int32_t) {});
+}
+
+int32_t cv_in_stream_value(uint8_t channel) {
+    return g_value[channel];
+}
+
+int32_t cv_in_stream_microvolts(uint8_t channel) {
+    return static_cast<int32_t>(static_cast<int64_t>(g_value[channel]) * kFullScaleUv /
+                                (4096 << kCicFracBits));
+}
+
+uint32_t cv_in_stream_output_rate_hz() {
+    if (!adc_capture_active()) return 0;
+    return adc_capture_rate_hz() / adc_capture_inputs() >> g_log2_ratio;
+}
+
+void cv_in_resolution_enter(Brain& /*brain*/) {
+    g_res_step = 0;
+    g_res_done = false;
+    g_stats[0] = g_stats[1] = NoiseStats{};
+    start_capture(kResolutionLog2[0]);
+}
+
+void cv_in_resolution_run(Brain& /*brain*/, uint32_t /*now_ms*/) {
+    if (g_res_done || !adc_capture_active()) return;
+
+    consume([](uint8_t ch, int32_t y) {
+        NoiseStats& s = g_stats[ch];
+        if (s.n >= kResolutionOutputs) return;
+        ++s.n;
+        s.sum += y;
+        s.sum_sq += static_cast<int64_t>(y) * y;
+    });
+    if (g_stats[0].n < kResolutionOutputs || g_stats[1].n < kResolutionOutputs) return;
+
+    report_step(kResolutionLog2[g_res_step]);
+    g_stats[0] = g_stats[1] = NoiseStats{};
+    if (++g_res_step >= count_of(kResolutionLog2)) {
+        g_res_done = true;
+        adc_capture_stop();
+        printf("cvres_done\n");
+        return;
+    }
+    start_capture(kResolutionLog2[g_res_step]);
+}
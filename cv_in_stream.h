@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+
+#include "tests.h"
+
+// Oversampled CV-input front end. Both CV inputs are captured by DMA at a
+// combined 200 kHz (see adc_capture.h) and each channel is run through a
+// CIC decimator (cic.h). The decimation ratio is the "cic_decimation"
+// setting, so the output rate is 100 kHz / ratio per channel.
+//
+// Channel 0 is CV in 1 (kInputsChannelA), channel 1 is CV in 2.
+
+bool cv_in_stream_start();
+void cv_in_stream_service();
+
+// Latest decimated value in ADC counts relative to mid scale, with
+// kCicFracBits fractional bits.
+int32_t cv_in_stream_value(uint8_t channel);
+
+// The same value converted with the nominal input-stage scaling (±5 V over
+// the ADC range).
+int32_t cv_in_stream_microvolts(uint8_t channel);
+
+uint32_t cv_in_stream_output_rate_hz();
+
+// kTestCvInResolution: holds still while each decimation ratio from 1
+// (raw samples) to 256 is measured in turn, then reports the noise and
+// effective resolution per ratio and channel:
+//
+//   cvres channel=<a|b> ratio=<R> rate_hz=<hz> noise_uv=<rms> bits=<b> gain_bits=<b>
+//   cvres_done
+//
+// Leave the inputs unpatched or on a steady DC source while it runs.
+void cv_in_resolution_enter(Brain& brain);
+void cv_in_resolution_run(Brain& brain, uint32_t now_ms);
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+
+#include "hardware/structs/systick.h"
+
+// CPU cycle counter built on SysTick, which both the Cortex-M0+ (RP2040)
+// and the Cortex-M33 (RP2350) have. It is a 24-bit down-counter clocked
+// from the processor clock, so intervals wrap after 2^24 cycles (~134 ms
+// at 125 MHz); use it for short measurements only.
+//
+// main() starts it once at boot and it then runs free: the main loop
+// times every pass with it (event_bus_account()), so nothing else may
+// restart it.
+
+constexpr uint32_t kCycleCounterMask = 0x00FFFFFFu;
+
+inline void cycle_counter_start() {
+    systick_hw->csr = 0;
+    systick_hw->rvr = kCycleCounterMask;
+    systick_hw->cvr = 0;
+    systick_hw->csr = 0x5;  // CLKSOURCE = processor clock, ENABLE
+}
+
+inline uint32_t cycle_counter_read() {
+    return systick_hw->cvr;
+}
+
+// Cycles from `start` to `end`, both values of cycle_counter_read().
+inline uint32_t cycle_counter_elapsed(uint32_t start, uint32_t end) {
+    return (start - end) & kCycleCounterMask;
+}
@@ -0,0 +1,485 @@
+#include "dac_fast.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#include "hardware/gpio.h"
+#include "hardware/pio.h"
+#include "hardware/spi.h"
+
+#include "brain_pins.h"
+#include "cycle_counter.h"
+#include "hot_path.h"
+
+namespace {
+
+constexpr size_t   kTableSize   = kDacFastMaxMv - kDacFastMinMv + 1;
+constexpr int32_t  kBucketMv    = 32;
+constexpr size_t   kBuckets     = (kTableSize + kBucketMv - 1) / kBucketMv;
+constexpr size_t   kMaxSegments = 128;      // per channel; fits the uint8_t buckets
+constexpr int32_t  kMaxSlopeQ16 = 2 << 16;  // keeps slope * 10000 mV in int32
+constexpr uint16_t kCodeMask    = 0x0FFF;  // MCP4822: 12 data bits ...
+constexpr uint16_t kConfigMask  = 0xF000;  // ... under channel/gain/shutdown
+constexpr uint32_t kSniffBaudHz = 1000000;  // slow enough for PIO to sample
+constexpr uint32_t kWriteCheckStride = 97;  // mV step for write-path checks
+constexpr uint32_t kTimingSamples    = 255;
+
+struct Segment {
+    int32_t  start;      // mV above kDacFastMinMv
+    int32_t  code_q16;   // code at the segment start, Q16
+    int32_t  slope_q16;  // codes per mV, Q16
+    uint16_t config;
+};
+
+Segment g_segments[2][kMaxSegments];
+size_t  g_segment_count[2] = {0, 0};
+uint8_t g_bucket[2][kBuckets];  // segment holding each bucket's first mV
+bool    g_piecewise_ready = false;
+
+#if BRAIN_DIAG_DAC_FAST_TABLE
+uint16_t g_table[2][kTableSize];
+bool     g_table_ready = false;
+constexpr DacFastMode kBuiltModes[] = {kDacFastTable, kDacFastPiecewise};
+#else
+constexpr DacFastMode kBuiltModes[] = {kDacFastPiecewise};
+#endif
+
+spi_inst_t* g_spi           = nullptr;
+bool        g_cs_is_gpio    = false;
+bool        g_16bit_frames  = false;
+
+PIO           g_sniff_pio    = nullptr;
+uint          g_sniff_sm     = 0;
+uint          g_sniff_offset = 0;
+uint16_t      g_sniff_insns[8];
+pio_program_t g_sniff_program;
+
+uint32_t g_samples[kTimingSamples];
+bool     g_check_done = false;
+
+constexpr const char* kChannelNames[2] = {"a", "b"};
+
+void set_reference(Brain& brain, uint8_t channel, int32_t mv) {
+    brain.outputs.set_voltage_calibrated_millivolts(
+        channel == 0 ? kOutputsChannelA : kOutputsChannelB, mv);
+}
+
+void detect_spi() {
+    // GPIOs 0-7 and 16-23 carry SPI0, 8-15 and 24-29 SPI1.
+    g_spi = ((kDacSckPin >> 3) & 1u) ? spi1 : spi0;
+    g_cs_is_gpio = gpio_get_function(kDacCsPin) == GPIO_FUNC_SIO;
+    // Match whatever frame size the SDK configured, so our writes are
+    // bit-identical to its own.
+    uint32_t dss = spi_get_hw(g_spi)->cr0 & SPI_SSPCR0_DSS_BITS;
+    g_16bit_frames = dss == 15;
+}
+
+// PIO program that records each 16-bit word clocked into the DAC: wait for
+// CS low, sample MOSI on 16 SCK rising edges, push, wait for CS high. The
+// pins are only read, so the SPI peripheral keeps driving them. It is
+// assembled at runtime because `wait gpio` encodes absolute pin numbers.
+bool sniff_start() {
+    g_sniff_insns[0] = pio_encode_wait_gpio(false, kDacCsPin);
+    g_sniff_insns[1] = pio_encode_set(pio_x, 15);
+    g_sniff_insns[2] = pio_encode_wait_gpio(false, kDacSckPin);
+    g_sniff_insns[3] = pio_encode_wait_gpio(true, kDacSckPin);
+    g_sniff_insns[4] = pio_encode_in(pio_pins, 1);
+    g_sniff_insns[5] = pio_encode_jmp_x_dec(2);
+    g_sniff_insns[6] = pio_encode_push(false, false);
+    g_sniff_insns[7] = pio_encode_wait_gpio(true, kDacCsPin);
+
+    g_sniff_program = {};
+    g_sniff_program.instructions = g_sniff_insns;
+    g_sniff_program.length = count_of(g_sniff_insns);
+    g_sniff_program.origin = -1;
+    if (!pio_claim_free_sm_and_add_program(&g_sniff_program, &g_sniff_pio, &g_sniff_sm,
+                                           &g_sniff_offset)) {
+        return false;
+    }
+
+    pio_sm_config c = pio_get_default_sm_config();
+    sm_config_set_in_pins(&c, kDacMosiPin);
+    sm_config_set_in_shift(&c, false, false, 32);  // MSB first, manual push
+    sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_RX);
+    sm_config_set_wrap(&c, g_sniff_offset, g_sniff_offset + g_sniff_program.length - 1);
+    pio_sm_init(g_sniff_pio, g_sniff_sm, g_sniff_offset, &c);
+    pio_sm_set_enabled(g_sniff_pio, g_sniff_sm, true);
+    return true;
+}
+
+void sniff_stop() {
+    pio_sm_set_enabled(g_sniff_pio, g_sniff_sm, false);
+    pio_remove_program_and_unclaim_sm(&g_sniff_program, g_sniff_pio, g_sniff_sm,
+                                      g_sniff_offset);
+    g_sniff_pio = nullptr;
+}
+
+void sniff_clear() {
+    pio_sm_clear_fifos(g_sniff_pio, g_sniff_sm);
+}
+
+// Last word captured since sniff_clear(). Returns false if nothing was
+// sent, which happens when the SDK skips an unchanged DAC code.
+bool sniff_last(uint16_t& word) {
+    // The SDK's blocking SPI write returns once the bus is idle; give the
+    // state machine a moment to push the final bit.
+    busy_wait_us_32(2);
+    bool got = false;
+    while (!pio_sm_is_rx_fifo_empty(g_sniff_pio, g_sniff_sm)) {
+        word = static_cast<uint16_t>(pio_sm_get(g_sniff_pio, g_sniff_sm) & 0xFFFFu);
+        got = true;
+    }
+    return got;
+}
+
+// Runs the reference conversion for `mv` and returns the word it sent,
+// falling back to `previous` when the SDK wrote nothing.
+bool capture(Brain& brain, uint8_t channel, int32_t mv, bool have_previous,
+             uint16_t previous, uint16_t& word) {
+    sniff_clear();
+    set_reference(brain, channel, mv);
+    if (sniff_last(word)) return true;
+    word = previous;
+    return have_previous;
+}
+
+// Brackets a sweep: slows the bus so the sniffer can keep up, and forces a
+// DAC change before the first point so it is always transmitted.
+bool sweep_begin(Brain& brain, uint32_t& saved_baud) {
+    if (!sniff_start()) return false;
+    saved_baud = spi_get_baudrate(g_spi);
+    spi_set_baudrate(g_spi, kSniffBaudHz);
+    set_reference(brain, 0, kDacFastMaxMv);
+    set_reference(brain, 1, kDacFastMaxMv);
+    return true;
+}
+
+void sweep_end(uint32_t saved_baud) {
+    spi_set_baudrate(g_spi, saved_baud);
+    sniff_stop();
+}
+
+#if BRAIN_DIAG_DAC_FAST_TABLE
+bool build_table(Brain& brain) {
+    uint32_t saved_baud = 0;
+    if (!sweep_begin(brain, saved_baud)) return false;
+    bool ok = true;
+    for (uint8_t ch = 0; ch < 2 && ok; ++ch) {
+        for (size_t i = 0; i < kTableSize; ++i) {
+            uint16_t prev = i ? g_table[ch][i - 1] : 0;
+            if (!capture(brain, ch, kDacFastMinMv + static_cast<int32_t>(i), i > 0, prev,
+                         g_table[ch][i])) {
+                ok = false;
+                break;
+            }
+        }
+    }
+    sweep_end(saved_baud);
+    return ok;
+}
+#endif
+
+int32_t floor_div(int32_t a, int32_t b) {
+    int32_t q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+// Fits one channel's words, fed in millivolt order, with as few segments
+// as an exact fit allows: a segment grows while some Q16 line still rounds
+// to every word in it, and a word that no line reaches (or a different
+// config field) starts the next one. The line's value at the segment start
+// is tried at kIntercepts points inside the first word's rounding
+// interval, each keeping the range of slopes that still fits.
+class SegmentFitter {
+public:
+    void reset(uint8_t channel) {
+        channel_ = channel;
+        open_ = false;
+        g_segment_count[channel] = 0;
+    }
+
+    bool push(int32_t offset, uint16_t word) {
+        if (open_ && (word & kConfigMask) == seg_.config) {
+            int32_t x = offset - seg_.start;
+            int32_t target = (word & kCodeMask) << 16;
+            bool any = false;
+            for (size_t k = 0; k < kIntercepts && !any; ++k) {
+                int32_t lo = lo_[k];
+                int32_t hi = hi_[k];
+                any = narrow(k, x, target, lo, hi);
+            }
+            if (any) {
+                for (size_t k = 0; k < kIntercepts; ++k) narrow(k, x, target, lo_[k], hi_[k]);
+                return true;
+            }
+        }
+        return close() && open(offset, word);
+    }
+
+    bool finish() { return close(); }
+
+private:
+    static constexpr size_t kIntercepts = 64;
+
+    // Candidate k sits (2k + 1 - kIntercepts) / (2 kIntercepts) of a code
+    // from the first word.
+    int32_t intercept(size_t k) const {
+        int32_t steps = 2 * static_cast<int32_t>(k) + 1 - static_cast<int32_t>(kIntercepts);
+        return seg_.code_q16 + steps * (0x8000 / static_cast<int32_t>(kIntercepts));
+    }
+
+    // Limits [lo, hi] to the slopes that put `target` at x:
+    // (intercept + slope * x + 0x8000) >> 16 == code. False once empty.
+    bool narrow(size_t k, int32_t x, int32_t target, int32_t& lo, int32_t& hi) const {
+        if (lo > hi) return false;
+        int32_t rise = target - intercept(k);
+        lo = std::max(lo, -floor_div(-(rise - 0x8000), x));
+        hi = std::min(hi, floor_div(rise + 0x7FFF, x));
+        return lo <= hi;
+    }
+
+    bool open(int32_t offset, uint16_t word) {
+        if (g_segment_count[channel_] == kMaxSegments) return false;
+        seg_.start = offset;
+        seg_.code_q16 = (word & kCodeMask) << 16;
+        seg_.config = word & kConfigMask;
+        std::fill(lo_, lo_ + kIntercepts, -kMaxSlopeQ16);
+        std::fill(hi_, hi_ + kIntercepts, kMaxSlopeQ16);
+        open_ = true;
+        return true;
+    }
+
+    bool close() {
+        if (!open_) return true;
+        size_t k = 0;
+        while (lo_[k] > hi_[k]) ++k;
+        seg_.code_q16 = intercept(k);
+        seg_.slope_q16 = lo_[k] + (hi_[k] - lo_[k]) / 2;
+        size_t index = g_segment_count[channel_]++;
+        g_segments[channel_][index] = seg_;
+        // Later segments overwrite the buckets from their own start on.
+        for (size_t b = (seg_.start + kBucketMv - 1) / kBucketMv; b < kBuckets; ++b) {
+            g_bucket[channel_][b] = static_cast<uint8_t>(index);
+        }
+        open_ = false;
+        return true;
+    }
+
+    uint8_t channel_ = 0;
+    Segment seg_{};
+    int32_t lo_[kIntercepts];
+    int32_t hi_[kIntercepts];
+    bool    open_ = false;
+};
+
+SegmentFitter g_fitter;  // 512 bytes of state: kept off the stack
+
+bool build_piecewise(Brain& brain) {
+#if BRAIN_DIAG_DAC_FAST_TABLE
+    if (g_table_ready) {
+        // Fitted straight from the table, no extra sweep needed.
+        for (uint8_t ch = 0; ch < 2; ++ch) {
+            g_fitter.reset(ch);
+            for (size_t i = 0; i < kTableSize; ++i) {
+                if (!g_fitter.push(static_cast<int32_t>(i), g_table[ch][i])) return false;
+            }
+            if (!g_fitter.finish()) return false;
+        }
+        return true;
+    }
+#endif
+
+    uint32_t saved_baud = 0;
+    if (!sweep_begin(brain, saved_baud)) return false;
+    bool ok = true;
+    for (uint8_t ch = 0; ch < 2 && ok; ++ch) {
+        g_fitter.reset(ch);
+        uint16_t word = 0;
+        for (size_t i = 0; i < kTableSize && ok; ++i) {
+            ok = capture(brain, ch, kDacFastMinMv + static_cast<int32_t>(i), i > 0, word, word) &&
+                 g_fitter.push(static_cast<int32_t>(i), word);
+        }
+        ok = ok && g_fitter.finish();
+    }
+    sweep_end(saved_baud);
+    return ok;
+}
+
+// Distance between two command words in DAC codes; a differing
+// channel/gain/shutdown field counts as full scale.
+uint32_t word_error(uint16_t a, uint16_t b) {
+    if ((a & kConfigMask) != (b & kConfigMask)) return kCodeMask;
+    return static_cast<uint32_t>(std::abs((a & kCodeMask) - (b & kCodeMask)));
+}
+
+uint32_t median_cycles() {
+    std::sort(g_samples, g_samples + kTimingSamples);
+    return g_samples[kTimingSamples / 2];
+}
+
+template <typename Fn>
+uint32_t time_median(Fn&& fn) {
+    for (uint32_t i = 0; i < kTimingSamples; ++i) {
+        int32_t mv = static_cast<int32_t>(i * 37 % kTableSize) + kDacFastMinMv;
+        uint32_t t0 = cycle_counter_read();
+        fn(mv);
+        g_samples[i] = cycle_counter_elapsed(t0, cycle_counter_read());
+    }
+    return median_cycles();
+}
+
+}  // namespace
+
+bool dac_fast_prepare(Brain& brain, DacFastMode mode) {
+    if (dac_fast_ready(mode)) return true;
+    ensure_calibration_loaded(brain);
+    brain.outputs.set_output_range(kOutputsChannelA, kOutputsRangeMinus5To5V);
+    brain.outputs.set_output_range(kOutputsChannelB, kOutputsRangeMinus5To5V);
+    if (g_spi == nullptr) detect_spi();
+
+    if (mode == kDacFastTable) {
+#if BRAIN_DIAG_DAC_FAST_TABLE
+        g_table_ready = build_table(brain);
+        return g_table_ready;
+#else
+        return false;
+#endif
+    }
+    g_piecewise_ready = build_piecewise(brain);
+    return g_piecewise_ready;
+}
+
+bool dac_fast_ready(DacFastMode mode) {
+#if BRAIN_DIAG_DAC_FAST_TABLE
+    if (mode == kDacFastTable) return g_table_ready;
+#else
+    if (mode == kDacFastTable) return false;
+#endif
+    return g_piecewise_ready;
+}
+
+uint16_t DIAG_HOT_FUNC(dac_fast_word)(uint8_t channel, int32_t mv, DacFastMode mode) {
+    if (mv < kDacFastMinMv) mv = kDacFastMinMv;
+    if (mv > kDacFastMaxMv) mv = kDacFastMaxMv;
+    int32_t offset = mv - kDacFastMinMv;
+
+#if BRAIN_DIAG_DAC_FAST_TABLE
+    if (mode == kDacFastTable) {
+        return g_table[channel][offset];
+    }
+#else
+    (void)mode;
+#endif
+
+    size_t s = g_bucket[channel][offset / kBucketMv];
+    while (s + 1 < g_segment_count[channel] && g_segments[channel][s + 1].start <= offset) ++s;
+    const Segment& seg = g_segments[channel][s];
+    int32_t code = (seg.code_q16 + seg.slope_q16 * (offset - seg.start) + 0x8000) >> 16;
+    return static_cast<uint16_t>(seg.config | code);
+}
+
+void DIAG_HOT_FUNC(dac_fast_write_word)(uint16_t word) {
+    if (g_cs_is_gpio) gpio_put(kDacCsPin, false);
+    if (g_16bit_frames) {
+        spi_write16_blocking(g_spi, &word, 1);
+    } else {
+        uint8_t bytes[2] = {static_cast<uint8_t>(word >> 8), static_cast<uint8_t>(word)};
+        spi_write_blocking(g_spi, bytes, 2);
+    }
+    if (g_cs_is_gpio) gpio_put(kDacCsPin, true);
+}
+
+void DIAG_HOT_FUNC(dac_fast_set_millivolts)(uint8_t channel, int32_t mv, DacFastMode mode) {
+    dac_fast_write_word(dac_fast_word(channel, mv, mode));
+}
+
+void dac_fast_check_enter(Brain& /*brain*/) {
+    g_check_done = false;
+}
+
+void dac_fast_check_run(Brain& brain, uint32_t /*now_ms*/) {
+    if (g_check_done) return;
+    g_check_done = true;
+
+    for (DacFastMode mode : kBuiltModes) {
+        if (!dac_fast_prepare(brain, mode)) {
+            printf("dacfast error=capture-failed\n");
+            printf("dacfast_done\n");
+            return;
+        }
+    }
+
+    // Exhaustive comparison against a fresh run of the reference path. A
+    // sample of fast-path writes is sniffed too, to prove the bits that
+    // reach the DAC are the same and not just the computed words.
+    uint32_t saved_baud = 0;
+    if (!sweep_begin(brain, saved_baud)) {
+        printf("dacfast error=sniffer-unavailable\n");
+        printf("dacfast_done\n");
+        return;
+    }
+    for (uint8_t ch = 0; ch < 2; ++ch) {
+        uint32_t mismatches[2] = {0, 0};
+        uint32_t max_err[2] = {0, 0};
+        uint16_t ref = 0;
+        for (size_t i = 0; i < kTableSize; ++i) {
+            int32_t mv = kDacFastMinMv + static_cast<int32_t>(i);
+            if (!capture(brain, ch, mv, i > 0, ref, ref)) {
+                for (DacFastMode mode : kBuiltModes) {
+                    ++mismatches[mode];
+                    max_err[mode] = kCodeMask;
+                }
+                continue;
+            }
+            for (DacFastMode mode : kBuiltModes) {
+                uint32_t err = word_error(dac_fast_word(ch, mv, mode), ref);
+                if (err != 0) ++mismatches[mode];
+                max_err[mode] = std::max(max_err[mode], err);
+            }
+
+            if (i % kWriteCheckStride == 0) {
+                uint16_t expected = dac_fast_word(ch, mv, kDacFastPiecewise);
+                uint16_t sent = 0;
+                sniff_clear();
+                dac_fast_write_word(expected);
+                if (!sniff_last(sent) || sent != expected) {
+                    ++mismatches[kDacFastPiecewise];
+                    max_err[kDacFastPiecewise] = std::max(max_err[kDacFastPiecewise],
+                                                          word_error(sent, expected));
+                }
+            }
+        }
+        printf("dacfast channel=%s segments=%lu\n", kChannelNames[ch],
+               static_cast<unsigned long>(g_segment_count[ch]));
+        for (DacFastMode mode : kBuiltModes) {
+            printf("dacfast channel=%s mode=%s mismatches=%lu max_err=%lu checked=%lu\n",
+                   kChannelNames[ch], mode == kDacFastTable ? "table" : "piecewise",
+                   static_cast<unsigned long>(mismatches[mode]),
+                   static_cast<unsigned long>(max_err[mode]),
+                   static_cast<unsigned long>(kTableSize));
+        }
+    }
+    sweep_end(saved_baud);
+
+    // Per-call cost at the normal bus speed: full call, and for the fast
+    // paths the mV -> word conversion alone.
+    for (uint8_t ch = 0; ch < 2; ++ch) {
+        uint32_t ref_call = time_median([&](int32_t mv) { set_reference(brain, ch, mv); });
+        printf("dacfast channel=%s path=reference call=%lu\n", kChannelNames[ch],
+               static_cast<unsigned long>(ref_call));
+        for (DacFastMode mode : kBuiltModes) {
+            uint32_t call = time_median([&](int32_t mv) { dac_fast_set_millivolts(ch, mv, mode); });
+            uint32_t convert = time_median([&](int32_t mv) {
+                volatile uint16_t w = dac_fast_word(ch, mv, mode);
+                (void)w;
+            });
+            printf("dacfast channel=%s path=%s call=%lu convert=%lu\n", kChannelNames[ch],
+                   mode == kDacFastTable ? "table" : "piecewise",
+                   static_cast<unsigned long>(call), static_cast<unsigned long>(convert));
+        }
+    }
+    set_reference(brain, 0, 0);
+    set_reference(brain, 1, 0);
+    printf("dacfast_done\n");
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+
+#include "tests.h"
+
+// Integer-only calibrated DAC path for high-rate CV output.
+//
+// set_voltage_calibrated_millivolts() runs the calibration math on every
+// call, which is expensive on the FPU-less RP2040. Instead, the SDK's own
+// calibrated conversion is captured once: a PIO state machine sniffs the
+// MCP4822 command words the SDK sends while every millivolt is run
+// through the reference path. From that the fast path keeps
+//
+//   - kDacFastPiecewise: fixed-point linear segments, each extended only
+//     while it still reproduces every captured word, so the fit is exact
+//     (up to 128 segments per channel, 4 KB of RAM), and
+//   - kDacFastTable: a dense mV -> command-word table (2 x 10001 words of
+//     RAM), only in builds with -DBRAIN_DIAG_DAC_FAST_TABLE=ON.
+//
+// Per sample, the conversion is then a lookup or a multiply-add and shift,
+// and the word goes straight to the SPI peripheral. Both CV outputs are
+// switched to the -5..+5 V range; the captured data is only valid there.
+//
+// The coefficients are not read from the calibration in flash: they come
+// from the words seen on the SPI bus. This relies on SDK internals that
+// its API doesn't promise: that the DAC is an MCP4822 on the SPI pins in
+// brain_pins.h, with CS framing each 16-bit word, and that the calibrated
+// call writes the DAC synchronously. An SDK change there shows up as a
+// capture failure or as mismatches in kTestDacFastCheck.
+
+enum DacFastMode : uint8_t {
+    kDacFastTable = 0,
+    kDacFastPiecewise,
+};
+
+constexpr int32_t kDacFastMinMv = -5000;
+constexpr int32_t kDacFastMaxMv =  5000;
+
+// Captures the reference conversion for both channels. Loads calibration
+// first if needed. The sweep takes well under a second and is done once
+// per boot; later calls are free. Returns false if the SPI traffic could
+// not be captured, or for kDacFastTable in builds without the table.
+bool dac_fast_prepare(Brain& brain, DacFastMode mode);
+bool dac_fast_ready(DacFastMode mode);
+
+// channel: 0 = CV out A, 1 = CV out B. mv is clamped to the ±5 V range.
+uint16_t dac_fast_word(uint8_t channel, int32_t mv, DacFastMode mode);
+void dac_fast_write_word(uint16_t word);
+void dac_fast_set_millivolts(uint8_t channel, int32_t mv, DacFastMode mode);
+
+// kTestDacFastCheck: builds the representations in this build, compares
+// them against the reference path for every millivolt on both channels,
+// and prints the segment count and cycle counts of the reference and fast
+// paths:
+//
+//   dacfast channel=<a|b> segments=<n>
+//   dacfast channel=<a|b> mode=<table|piecewise> mismatches=<n> max_err=<codes> checked=<n>
+//   dacfast channel=<a|b> path=<reference|table|piecewise> call=<cycles> convert=<cycles>
+//   dacfast_done
+void dac_fast_check_enter(Brain& brain);
+void dac_fast_check_run(Brain& brain, uint32_t now_ms);
@@ -0,0 +1,198 @@
+#include "dac_stream.h"
+
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/pio.h"
+#include "pico/stdlib.h"
+
+#include "brain_pins.h"
+#include "cycle_counter.h"
+
+namespace {
+
+constexpr uint32_t kSckHz = 10000000;  // well inside the MCP4822's 20 MHz
+// RP2350 keeps the top four bits of the count for the transfer mode; this
+// is the largest count both chips run as a normal transfer.
+constexpr uint32_t kTransferCount = 0x0FFFFFFFu;
+
+// Word-sized entries with the command in the top half: the PIO shifts MSB
+// first out of a 32-bit OSR. Aligned for the DMA read ring.
+alignas(kDacStreamMaxWords * sizeof(uint32_t)) uint32_t g_words[kDacStreamMaxWords];
+
+PIO           g_pio    = nullptr;
+uint          g_sm     = 0;
+uint          g_offset = 0;
+uint16_t      g_insns[6];
+pio_program_t g_program;
+int           g_dma    = -1;
+int           g_timer  = -1;
+bool          g_active = false;
+uint32_t      g_rate_hz  = 0;
+uint32_t      g_start_cycles = 0;
+uint32_t      g_divisor  = 1;
+gpio_function_t g_saved_cs_function = GPIO_FUNC_SIO;
+
+uint8_t log2_floor(uint32_t v) {
+    uint8_t r = 0;
+    while (v > 1) {
+        v >>= 1;
+        ++r;
+    }
+    return r;
+}
+
+// SPI master on PIO: CS low, 16 bits MSB first with data changing on the
+// falling SCK edge, CS high to latch. Out drives MOSI, set drives CS and
+// side-set drives SCK, so the program is assembled at runtime for whatever
+// pins the board uses.
+bool program_start() {
+    g_insns[0] = pio_encode_pull(false, true) | pio_encode_sideset(1, 0);
+    g_insns[1] = pio_encode_set(pio_pins, 0) | pio_encode_sideset(1, 0);
+    g_insns[2] = pio_encode_set(pio_x, 15) | pio_encode_sideset(1, 0);
+    g_insns[3] = pio_encode_out(pio_pins, 1) | pio_encode_sideset(1, 0) | pio_encode_delay(1);
+    g_insns[4] = pio_encode_jmp_x_dec(3) | pio_encode_sideset(1, 1) | pio_encode_delay(1);
+    g_insns[5] = pio_encode_set(pio_pins, 1) | pio_encode_sideset(1, 0) | pio_encode_delay(1);
+
+    g_program = {};
+    g_program.instructions = g_insns;
+    g_program.length = count_of(g_insns);
+    g_program.origin = -1;
+    if (!pio_claim_free_sm_and_add_program(&g_program, &g_pio, &g_sm, &g_offset)) {
+        return false;
+    }
+
+    pio_sm_config c = pio_get_default_sm_config();
+    sm_config_set_out_pins(&c, kDacMosiPin, 1);
+    sm_config_set_set_pins(&c, kDacCsPin, 1);
+    sm_config_set_sideset_pins(&c, kDacSckPin);
+    sm_config_set_sideset(&c, 1, false, false);
+    sm_config_set_out_shift(&c, false, false, 32);
+    sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_TX);
+    // Four PIO cycles per bit.
+    sm_config_set_clkdiv(&c, static_cast<float>(clock_get_hz(clk_sys)) / (4.0f * kSckHz));
+    sm_config_set_wrap(&c, g_offset, g_offset + g_program.length - 1);
+    pio_sm_init(g_pio, g_sm, g_offset, &c);
+
+    // Idle levels first, then hand the pins over, so CS never glitches low.
+    uint32_t cs = 1u << kDacCsPin;
+    uint32_t all = cs | (1u << kDacSckPin) | (1u << kDacMosiPin);
+    pio_sm_set_pins_with_mask(g_pio, g_sm, cs, all);
+    pio_sm_set_pindirs_with_mask(g_pio, g_sm, all, all);
+    g_saved_cs_function = gpio_get_function(kDacCsPin);
+    pio_gpio_init(g_pio, kDacCsPin);
+    pio_gpio_init(g_pio, kDacSckPin);
+    pio_gpio_init(g_pio, kDacMosiPin);
+    pio_sm_set_enabled(g_pio, g_sm, true);
+    return true;
+}
+
+void program_stop() {
+    // Let the last frame finish so the DAC never sees a cut-off word.
+    while (!pio_sm_is_tx_fifo_empty(g_pio, g_sm)) {
+        tight_loop_contents();
+    }
+    busy_wait_us_32(10);
+    pio_sm_set_enabled(g_pio, g_sm, false);
+
+    gpio_set_function(kDacSckPin, GPIO_FUNC_SPI);
+    gpio_set_function(kDacMosiPin, GPIO_FUNC_SPI);
+    if (g_saved_cs_function == GPIO_FUNC_SIO) gpio_put(kDacCsPin, true);
+    gpio_set_function(kDacCsPin, g_saved_cs_function);
+
+    pio_remove_program_and_unclaim_sm(&g_program, g_pio, g_sm, g_offset);
+    g_pio = nullptr;
+}
+
+void dma_start() {
+    uint ch = static_cast<uint>(g_dma);
+    dma_channel_config c = dma_channel_get_default_config(ch);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_ring(&c, false, log2_floor(sizeof(g_words)));
+    channel_config_set_dreq(&c, dma_get_timer_dreq(static_cast<uint>(g_timer)));
+    dma_channel_configure(ch, &c, &g_pio->txf[g_sm], g_words, kTransferCount, false);
+}
+
+void release_resources() {
+    if (g_dma >= 0) {
+        dma_channel_abort(static_cast<uint>(g_dma));
+        dma_channel_unclaim(static_cast<uint>(g_dma));
+        g_dma = -1;
+    }
+    if (g_timer >= 0) {
+        dma_timer_unclaim(static_cast<uint>(g_timer));
+        g_timer = -1;
+    }
+    if (g_pio != nullptr) program_stop();
+}
+
+}  // namespace
+
+bool dac_stream_start(const uint16_t* words, size_t count, uint32_t word_rate_hz) {
+    dac_stream_stop();
+    if (count < 2 || count > kDacStreamMaxWords || (count & (count - 1)) != 0) return false;
+    if (word_rate_hz == 0) return false;
+
+    g_dma = dma_claim_unused_channel(false);
+    g_timer = dma_claim_unused_timer(false);
+    if (g_dma < 0 || g_timer < 0 || !program_start()) {
+        release_resources();
+        return false;
+    }
+
+    // Tile the table over the whole buffer, so the ring size (and the
+    // buffer alignment it needs) is fixed.
+    for (size_t i = 0; i < kDacStreamMaxWords; ++i) {
+        g_words[i] = static_cast<uint32_t>(words[i & (count - 1)]) << 16;
+    }
+
+    // The timer fires at clk_sys * X / Y; X = 1 keeps the rate exact when
+    // it divides clk_sys.
+    uint32_t sys_hz = clock_get_hz(clk_sys);
+    uint32_t y = sys_hz / word_rate_hz;
+    if (y < 1) y = 1;
+    if (y > 0xFFFF) y = 0xFFFF;
+    dma_timer_set_fraction(static_cast<uint>(g_timer), 1, static_cast<uint16_t>(y));
+    g_rate_hz = sys_hz / y;
+    g_divisor = y;
+
+    dma_start();
+    g_active = true;
+    dma_channel_start(static_cast<uint>(g_dma));
+    // The first transfer may go out early on a pending timer request; the
+    // second one is on the timer's grid, so time that and step back.
+    uint32_t t0 = time_us_32();
+    while (kTransferCount - dma_channel_hw_addr(static_cast<uint>(g_dma))->transfer_count < 2 &&
+           time_us_32() - t0 < 1000) {
+        tight_loop_contents();
+    }
+    // SysTick counts down.
+    g_start_cycles = (cycle_counter_read() + g_divisor) & kCycleCounterMask;
+    return true;
+}
+
+void dac_stream_stop() {
+    if (!g_active) return;
+    g_active = false;
+    release_resources();
+}
+
+bool dac_stream_active() {
+    return g_active;
+}
+
+uint32_t dac_stream_rate_hz() {
+    return g_rate_hz;
+}
+
+uint32_t dac_stream_start_cycles() {
+    return g_start_cycles;
+}
+
+void dac_stream_service() {
+    if (!g_active || dma_channel_is_busy(static_cast<uint>(g_dma))) return;
+    // The read ring keeps the table phase continuous across the restart.
+    dma_channel_set_trans_count(static_cast<uint>(g_dma), kTransferCount, true);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// DMA-driven waveform playback on the MCP4822 DAC.
+//
+// A table of DAC command words (see dac_fast_word()) is played cyclically
+// at a fixed word rate with no CPU involvement: a DMA timer paces a DMA
+// channel that feeds a PIO state machine, and the PIO clocks each word out
+// with its own chip-select pulse. While streaming, the PIO owns the DAC's
+// SCK/MOSI/CS pins; they are handed back to the SDK's SPI on stop.
+//
+// Words may address either DAC channel, so interleaving A and B words
+// drives both outputs at half the word rate each. A channel that isn't in
+// the table keeps whatever it was last set to.
+
+constexpr size_t kDacStreamMaxWords = 1024;
+
+// `count` must be a power of two, 2..kDacStreamMaxWords. The DMA timer
+// divides clk_sys by at most 65535, so rates below ~2 kHz are raised to
+// that; use a longer table for slow waveforms. Returns false if no PIO
+// state machine, DMA channel or DMA timer is free.
+bool dac_stream_start(const uint16_t* words, size_t count, uint32_t word_rate_hz);
+void dac_stream_stop();
+bool dac_stream_active();
+
+// Word rate actually produced by the DMA timer.
+uint32_t dac_stream_rate_hz();
+
+// cycle_counter_read() at which word 0 of the table went out, to the
+// timer's grid. Lock-in detection uses it to know the drive phase.
+uint32_t dac_stream_start_cycles();
+
+// Restarts the DMA if its (very long) transfer count ran out. Call
+// occasionally from modes that stream for hours.
+void dac_stream_service();
@@ -0,0 +1,190 @@
+#include "event_bus.h"
+
+#include <cstdio>
+
+#include "hardware/clocks.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "pico/stdlib.h"
+
+#include "brain_pins.h"
+#include "cycle_counter.h"
+#include "hot_path.h"
+
+namespace {
+
+constexpr uint32_t kWindowUs   = 1000000;
+constexpr uint8_t  kPots       = 3;
+constexpr uint16_t kPotUnknown = 0xFFFF;
+
+struct Ring {
+    Event             buf[kEventRingSize];
+    volatile uint32_t head    = 0;  // written by the producer
+    volatile uint32_t tail    = 0;  // written by event_bus_dispatch()
+    volatile uint32_t queued  = 0;
+    volatile uint32_t dropped = 0;
+};
+
+Ring g_irq_ring;
+Ring g_loop_ring;
+
+uint32_t     g_mask          = 0;
+EventHandler g_handler       = nullptr;
+bool         g_irq_installed = false;
+uint16_t     g_last_pot[kPots];
+
+// Statistics since the last subscribe.
+uint32_t g_handled     = 0;
+uint64_t g_latency_sum = 0;
+uint32_t g_latency_max = 0;
+
+// Handling time, per one-second window.
+uint32_t g_window_start_us = 0;
+uint64_t g_window_cycles   = 0;
+uint32_t g_window_irq      = 0;  // g_irq_cycles when the window opened
+uint32_t g_cpu_us_per_s    = 0;
+uint32_t g_irq_us_per_s    = 0;
+
+// Cycles spent in pulse_irq_handler(), running; differences only.
+volatile uint32_t g_irq_cycles = 0;
+
+bool DIAG_HOT_FUNC(push)(Ring& ring, const Event& e) {
+    uint32_t head = ring.head;
+    if (head - ring.tail >= kEventRingSize) {
+        ++ring.dropped;
+        return false;
+    }
+    ring.buf[head % kEventRingSize] = e;
+    ring.head = head + 1;
+    ++ring.queued;
+    return true;
+}
+
+void DIAG_HOT_FUNC(pulse_irq_handler)() {
+    uint32_t start = cycle_counter_read();
+    uint32_t edges = gpio_get_irq_event_mask(kPulseInPin);
+    if (edges != 0) {  // else another pin on the bank
+        gpio_acknowledge_irq(kPulseInPin, edges);
+        Event e{time_us_32(), gpio_get(kPulseInPin) ? 1 : 0, kEventPulseIn, 0, 0};
+        push(g_irq_ring, e);
+    }
+    g_irq_cycles = g_irq_cycles + cycle_counter_elapsed(start, cycle_counter_read());
+}
+
+void set_pulse_irq(bool enabled) {
+    constexpr uint32_t kEdges = GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL;
+    if (enabled && !g_irq_installed) {
+        // A raw handler leaves the SDK's own GPIO callback alone.
+        gpio_add_raw_irq_handler(kPulseInPin, pulse_irq_handler);
+        irq_set_enabled(IO_IRQ_BANK0, true);
+        g_irq_installed = true;
+    }
+    if (!g_irq_installed) return;
+    gpio_set_irq_enabled(kPulseInPin, kEdges, false);
+    gpio_acknowledge_irq(kPulseInPin, kEdges);
+    if (enabled) gpio_set_irq_enabled(kPulseInPin, kEdges, true);
+}
+
+void reset_ring(Ring& ring) {
+    ring.tail = ring.head;
+    ring.queued = 0;
+    ring.dropped = 0;
+}
+
+void DIAG_HOT_FUNC(drain)(Brain& brain, Ring& ring) {
+    // Bounded, so a source that keeps publishing can't hold up the loop.
+    for (uint32_t n = 0; n < kEventRingSize; ++n) {
+        uint32_t tail = ring.tail;
+        if (tail == ring.head) return;
+        Event e = ring.buf[tail % kEventRingSize];
+        ring.tail = tail + 1;
+        if (g_handler == nullptr) continue;
+        g_handler(brain, e);
+        uint32_t latency = time_us_32() - e.time_us;
+        ++g_handled;
+        g_latency_sum += latency;
+        if (latency > g_latency_max) g_latency_max = latency;
+    }
+}
+
+}  // namespace
+
+void event_bus_subscribe(uint32_t mask, EventHandler handler) {
+    event_bus_unsubscribe();
+    for (uint16_t& p : g_last_pot) p = kPotUnknown;  // first poll publishes every pot
+    g_handled = 0;
+    g_latency_sum = 0;
+    g_latency_max = 0;
+    g_handler = handler;
+    g_mask = mask;
+    if (mask & event_mask(kEventPulseIn)) set_pulse_irq(true);
+}
+
+void event_bus_unsubscribe() {
+    g_mask = 0;
+    g_handler = nullptr;
+    set_pulse_irq(false);
+    reset_ring(g_irq_ring);
+    reset_ring(g_loop_ring);
+}
+
+void DIAG_HOT_FUNC(event_bus_publish)(EventType type, uint8_t index, uint8_t channel,
+                                      int32_t value, uint32_t time_us) {
+    if (!(g_mask & event_mask(type))) return;
+    Event e{time_us, value, type, index, channel};
+    push(g_loop_ring, e);
+}
+
+void DIAG_HOT_FUNC(event_bus_poll)(Brain& brain) {
+    if (!(g_mask & event_mask(kEventPot))) return;
+    uint32_t now = time_us_32();
+    for (uint8_t i = 0; i < kPots; ++i) {
+        uint16_t v = brain.pots.get_buffered(i);
+        if (v == g_last_pot[i]) continue;
+        g_last_pot[i] = v;
+        event_bus_publish(kEventPot, i, 0, v, now);
+    }
+}
+
+void DIAG_HOT_FUNC(event_bus_dispatch)(Brain& brain) {
+    if (g_mask == 0) return;
+    drain(brain, g_irq_ring);
+    drain(brain, g_loop_ring);
+}
+
+uint32_t DIAG_HOT_FUNC(event_bus_irq_cycles)() {
+    return g_irq_cycles;
+}
+
+void DIAG_HOT_FUNC(event_bus_account)(uint32_t cycles, uint32_t irq_start) {
+    // The pass's own time, less the interrupts that landed inside it;
+    // every interrupt is added once when the window closes.
+    uint32_t irq = g_irq_cycles;
+    uint32_t irq_in_pass = irq - irq_start;
+    g_window_cycles += cycles > irq_in_pass ? cycles - irq_in_pass : 0;
+    uint32_t now = time_us_32();
+    if (now - g_window_start_us < kWindowUs) return;
+    // Scaled to exactly one second, since the window closes on the first
+    // pass after it ends.
+    double scale = 1e6 / clock_get_hz(clk_sys) * kWindowUs / (now - g_window_start_us);
+    uint32_t irq_cycles = irq - g_window_irq;
+    g_irq_us_per_s = static_cast<uint32_t>(irq_cycles * scale);
+    g_cpu_us_per_s = static_cast<uint32_t>((g_window_cycles + irq_cycles) * scale);
+    g_window_cycles = 0;
+    g_window_irq = irq;
+    g_window_start_us = now;
+}
+
+void event_bus_report(TestId test) {
+    uint32_t dropped = g_irq_ring.dropped + g_loop_ring.dropped;
+    uint32_t events = g_irq_ring.queued + g_loop_ring.queued + dropped;
+    uint32_t mean = g_handled > 0 ? static_cast<uint32_t>(g_latency_sum / g_handled) : 0;
+    printf("bus mode=%s test=%u cpu_us_per_s=%lu irq_us_per_s=%lu events=%lu handled=%lu "
+           "dropped=%lu latency_us_mean=%lu latency_us_max=%lu\n",
+           g_mask != 0 ? "events" : "polled", static_cast<unsigned>(test),
+           static_cast<unsigned long>(g_cpu_us_per_s), static_cast<unsigned long>(g_irq_us_per_s),
+           static_cast<unsigned long>(events),
+           static_cast<unsigned long>(g_handled),
+           static_cast<unsigned long>(dropped),
+           static_cast<unsigned long>(mean), static_cast<unsigned long>(g_latency_max));
+}
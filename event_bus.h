@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+
+#include "tests.h"
+
+// Input events for the manual tests.
+//
+// Without the bus, the pot, Button B, MIDI and pulse-in tests redraw the
+// LEDs from the current input state on every pass of the main loop,
+// whether or not anything changed. With it, each source publishes a
+// timestamped event when its input changes, and the running test's
+// handler is called once per event:
+//
+//   pulse in  GPIO edge interrupt, both edges
+//   Button B  the SDK's press/release callbacks, inside Brain::update()
+//   pots      event_bus_poll() after Brain::update(), when a 7-bit
+//             reading differs from the last one published
+//   MIDI      the parser's note-on/off callbacks, stamped with the
+//             receive time of the byte that completed the message
+//
+// Events wait in two single-producer rings: one filled by the GPIO
+// interrupt and one filled from the main loop, so neither needs a lock.
+// Only the types the subscriber asked for are queued; a full ring drops
+// the event and counts it.
+//
+// The bus also keeps the numbers to compare both ways of running a test:
+// processor time per second spent in the test's input handling (polling,
+// dispatch and run_test() together) and the latency from an event's
+// timestamp to its handler.
+
+enum EventType : uint8_t {
+    kEventButton = 0,  // index 1 = Button B; value 1 = pressed
+    kEventPulseIn,     // value = GPIO level after the edge
+    kEventPot,         // index 0-2; value = 7-bit reading
+    kEventMidiNote,    // index = note, channel 0-15; value = velocity, 0 = off
+    kEventTypeCount,
+};
+
+constexpr uint32_t event_mask(EventType type) {
+    return 1u << type;
+}
+
+struct Event {
+    uint32_t time_us;  // time_us_32() when the input changed
+    int32_t  value;
+    uint8_t  type;
+    uint8_t  index;
+    uint8_t  channel;
+};
+
+using EventHandler = void (*)(Brain& brain, const Event& event);
+
+constexpr uint32_t kEventRingSize = 64;  // per ring, power of two
+
+// Routes the types in `mask` to `handler`, replacing any subscriber, and
+// clears the statistics. The pulse-in interrupt is only enabled while
+// someone listens for it.
+void event_bus_subscribe(uint32_t mask, EventHandler handler);
+void event_bus_unsubscribe();
+
+// Queues an event if its type is subscribed. Main loop only; the pulse-in
+// interrupt has its own ring.
+void event_bus_publish(EventType type, uint8_t index, uint8_t channel, int32_t value,
+                       uint32_t time_us);
+
+// Publishes pot changes. Call once per pass, after Brain::update().
+void event_bus_poll(Brain& brain);
+
+// Hands every queued event to the handler, the interrupt ring first.
+void event_bus_dispatch(Brain& brain);
+
+// Cycles spent in the pulse-in interrupt so far, for event_bus_account().
+uint32_t event_bus_irq_cycles();
+
+// Adds one pass's handling time, in cycle_counter cycles (a pass over
+// the counter's 2^24-cycle range is counted short). `irq_start` is
+// event_bus_irq_cycles() at the start of the pass, so interrupt time
+// inside the pass isn't counted twice.
+void event_bus_account(uint32_t cycles, uint32_t irq_start);
+
+// Prints "bus mode=<events|polled> test=<n> cpu_us_per_s=<t>
+// irq_us_per_s=<t> events=<n> handled=<n> dropped=<n> latency_us_mean=<t>
+// latency_us_max=<t>". The mode is "events" while a test is subscribed;
+// cpu_us_per_s includes the pulse-in interrupt, irq_us_per_s is that
+// interrupt alone, both from the last full second.
+void event_bus_report(TestId test);
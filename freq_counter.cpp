@@ -0,0 +1,228 @@
+#include "freq_counter.h"
+
+#include <cstdio>
+
+#include "adc_capture.h"
+#include "brain_pins.h"
+#include "hot_path.h"
+#include "settings.h"
+
+namespace {
+
+constexpr uint32_t kCaptureRateHz = 200000;  // both inputs together
+constexpr int32_t  kMinPkPk       = 16;      // counts; below this, no signal
+constexpr int32_t  kMinHysteresis = 2;
+
+struct Channel {
+    int32_t  center;
+    int32_t  hysteresis;
+    bool     levels_ready;
+    bool     armed;
+    bool     have_prev;
+    int32_t  prev;
+    int32_t  lo;
+    int32_t  hi;
+    double   first;      // crossing times, in samples
+    double   last;
+    uint32_t crossings;
+    FreqReading reading;
+};
+
+Channel  g_ch[2];
+uint8_t  g_slot[2]    = {0, 1};
+bool     g_active     = false;
+double   g_rate_hz    = 0.0;
+uint32_t g_gate       = 0;  // samples per channel
+uint32_t g_gate_end   = 0;
+uint32_t g_next_index = 0;  // expected index of the next frame
+uint32_t g_lost       = 0;  // samples per channel dropped, not yet reported
+
+// freq_counter_run() state.
+bool     g_run_started = false;
+bool     g_run_failed  = false;
+uint32_t g_run_gate_ms = 0;
+
+constexpr const char* kInputNames[2] = {"a", "b"};
+
+void reset_channel(Channel& c) {
+    c = Channel{};
+    c.lo = INT32_MAX;
+    c.hi = INT32_MIN;
+}
+
+// Thresholds for the next gate from this one's extremes.
+void update_levels(Channel& c) {
+    int32_t pkpk = c.hi - c.lo;
+    if (pkpk < kMinPkPk) {
+        c.levels_ready = false;
+        return;
+    }
+    c.center = c.lo + pkpk / 2;
+    c.hysteresis = pkpk / 8 > kMinHysteresis ? pkpk / 8 : kMinHysteresis;
+    c.levels_ready = true;
+}
+
+void DIAG_HOT_FUNC(push_sample)(Channel& c, int32_t x, uint32_t index) {
+    if (x < c.lo) c.lo = x;
+    if (x > c.hi) c.hi = x;
+    if (!c.levels_ready) return;
+
+    if (x < c.center - c.hysteresis) {
+        c.armed = true;
+    } else if (c.armed && x >= c.center) {
+        c.armed = false;
+        if (c.have_prev) {
+            // Linear interpolation between the samples either side.
+            double t = (index - 1) + static_cast<double>(c.center - c.prev) / (x - c.prev);
+            if (c.crossings == 0) c.first = t;
+            c.last = t;
+            ++c.crossings;
+        }
+    }
+    c.prev = x;
+    c.have_prev = true;
+}
+
+void finish_gate(Channel& c) {
+    FreqReading& r = c.reading;
+    r.pkpk = c.hi >= c.lo ? c.hi - c.lo : 0;
+    r.valid = c.crossings >= 2;
+    r.periods = r.valid ? c.crossings - 1 : 0;
+    r.hz = r.valid ? r.periods * g_rate_hz / (c.last - c.first) : 0.0;
+
+    update_levels(c);
+    c.lo = INT32_MAX;
+    c.hi = INT32_MIN;
+    // The last crossing opens the next gate, so no period goes uncounted.
+    if (c.crossings > 0 && c.levels_ready) {
+        c.first = c.last;
+        c.crossings = 1;
+    } else {
+        c.crossings = 0;
+    }
+}
+
+}  // namespace
+
+bool freq_counter_start(uint32_t gate_ms) {
+    freq_counter_stop();
+    uint8_t mask = static_cast<uint8_t>((1u << kCvInAAdcInput) | (1u << kCvInBAdcInput));
+    if (!adc_capture_start(mask, kCaptureRateHz)) return false;
+    adc_capture_set_exclusive(true);
+    g_slot[0] = adc_capture_slot(kCvInAAdcInput);
+    g_slot[1] = adc_capture_slot(kCvInBAdcInput);
+
+    g_rate_hz = static_cast<double>(adc_capture_rate_hz()) / adc_capture_inputs();
+    g_gate = static_cast<uint32_t>(g_rate_hz * gate_ms / 1000.0);
+    if (g_gate == 0) g_gate = 1;
+    g_gate_end = g_gate;
+    g_next_index = 0;
+    g_lost = 0;
+    reset_channel(g_ch[0]);
+    reset_channel(g_ch[1]);
+    g_active = true;
+    return true;
+}
+
+void freq_counter_stop() {
+    if (!g_active) return;
+    g_active = false;
+    adc_capture_stop();
+}
+
+bool freq_counter_active() {
+    return g_active;
+}
+
+bool DIAG_HOT_FUNC(freq_counter_service)() {
+    if (!g_active) return false;
+    bool completed = false;
+    uint32_t seq = 0;
+    const uint16_t* block;
+    uint8_t stride = adc_capture_inputs();
+    uint32_t frames = kAdcBlockSamples / stride;
+    while ((block = adc_capture_acquire(seq)) != nullptr) {
+        uint32_t index = seq * frames;
+        if (index != g_next_index) {
+            // Dropped blocks may hide crossings: start counting afresh, in
+            // the gate the capture resumed in rather than once per gate
+            // boundary that went by during the gap.
+            for (Channel& c : g_ch) {
+                c.have_prev = false;
+                c.crossings = 0;
+            }
+            g_lost += index - g_next_index;
+            if (index + 1 >= g_gate_end) g_gate_end = (index / g_gate + 1) * g_gate;
+        }
+        for (uint8_t ch = 0; ch < 2; ++ch) {
+            Channel& c = g_ch[ch];
+            if (c.levels_ready) continue;
+            // Seed the thresholds from the first block with a signal.
+            for (uint32_t f = 0; f < frames; ++f) {
+                int32_t x = block[f * stride + g_slot[ch]];
+                if (x < c.lo) c.lo = x;
+                if (x > c.hi) c.hi = x;
+            }
+            update_levels(c);
+        }
+        for (uint32_t f = 0; f < frames; ++f, ++index) {
+            const uint16_t* frame = block + f * stride;
+            push_sample(g_ch[0], frame[g_slot[0]], index);
+            push_sample(g_ch[1], frame[g_slot[1]], index);
+            if (index + 1 >= g_gate_end) {
+                finish_gate(g_ch[0]);
+                finish_gate(g_ch[1]);
+                g_gate_end += g_gate;
+                completed = true;
+            }
+        }
+        g_next_index = index;
+        adc_capture_release();
+    }
+    return completed;
+}
+
+const FreqReading& freq_counter_reading(uint8_t input) {
+    return g_ch[input].reading;
+}
+
+uint32_t freq_counter_take_lost() {
+    uint32_t lost = g_lost;
+    g_lost = 0;
+    return lost;
+}
+
+void freq_counter_enter(Brain& /*brain*/) {
+    g_run_started = false;
+    g_run_failed = false;
+}
+
+void freq_counter_run(Brain& /*brain*/, uint32_t /*now_ms*/) {
+    if (g_run_failed) return;
+    if (!g_run_started) {
+        g_run_started = true;
+        g_run_gate_ms = static_cast<uint32_t>(setting(kSettingFreqGateMs));
+        if (!freq_counter_start(g_run_gate_ms)) {
+            g_run_failed = true;
+            printf("freq error=start-failed\n");
+            return;
+        }
+    }
+    bool completed = freq_counter_service();
+    uint32_t lost = freq_counter_take_lost();
+    if (lost != 0) {
+        printf("freq gap lost_ms=%.1f\n", lost * 1000.0 / g_rate_hz);
+    }
+    if (!completed) return;
+    for (uint8_t ch = 0; ch < 2; ++ch) {
+        const FreqReading& r = g_ch[ch].reading;
+        if (r.valid) {
+            printf("freq input=%s hz=%.6f periods=%lu pkpk=%ld gate_ms=%lu\n", kInputNames[ch],
+                   r.hz, static_cast<unsigned long>(r.periods), static_cast<long>(r.pkpk),
+                   static_cast<unsigned long>(g_run_gate_ms));
+        } else {
+            printf("freq input=%s signal=none pkpk=%ld gate_ms=%lu\n", kInputNames[ch],
+                   static_cast<long>(r.pkpk), static_cast<unsigned long>(g_run_gate_ms));
+        }
+    }
+}
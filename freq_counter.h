@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+
+#include "tests.h"
+
+// Reciprocal frequency counter on the CV inputs.
+//
+// Both inputs are captured at 100 kHz each (see adc_capture.h). A Schmitt
+// trigger around the signal's midpoint picks out one rising crossing per
+// period, immune to noise near the threshold, and the crossing time is
+// interpolated between the two samples that straddle the midpoint. At the
+// end of a gate the frequency is (crossings - 1) periods divided by the
+// time from the first to the last crossing, so resolution comes from the
+// interpolated timing rather than from counting whole periods: a clean
+// audio-rate signal reads to about a ppm in a one-second gate. Absolute
+// accuracy is that of the board's crystal.
+//
+// Counting needs an unbroken sample stream, so the capture is exclusive
+// and Brain::update() is skipped until freq_counter_stop().
+
+struct FreqReading {
+    bool     valid;    // a signal with at least two crossings was found
+    double   hz;
+    uint32_t periods;
+    int32_t  pkpk;     // ADC counts, for judging the signal level
+};
+
+bool freq_counter_start(uint32_t gate_ms);
+void freq_counter_stop();
+bool freq_counter_active();
+
+// Consumes captured blocks. Returns true each time a gate completes on
+// both inputs; readings stay valid until the next one does.
+bool freq_counter_service();
+
+// input: 0 = CV in 1, 1 = CV in 2.
+const FreqReading& freq_counter_reading(uint8_t input);
+
+// Samples per input lost to dropped capture blocks since the last call.
+// Counting restarts after a gap, and the gate it falls in closes at its
+// usual boundary rather than every gate the gap spanned closing empty.
+uint32_t freq_counter_take_lost();
+
+// kTestFreqCounter: counts continuously with the freq_gate_ms gate time
+// and prints, per input and gate,
+//
+//   freq input=<a|b> hz=<f> periods=<n> pkpk=<counts> gate_ms=<ms>
+//   freq input=<a|b> signal=none pkpk=<counts> gate_ms=<ms>
+//
+// and once per gap in the capture
+//
+//   freq gap lost_ms=<ms>
+void freq_counter_enter(Brain& brain);
+void freq_counter_run(Brain& brain, uint32_t now_ms);
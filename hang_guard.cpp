@@ -0,0 +1,144 @@
+#include "hang_guard.h"
+
+#include <cstdio>
+
+#include "hardware/watchdog.h"
+#include "pico/stdlib.h"
+
+#include "hot_path.h"
+#include "settings.h"
+
+namespace {
+
+constexpr uint32_t kRecordMagic = 0x48414E47;  // "HANG"
+constexpr uint8_t  kMaxResumes  = 2;
+// The watchdog counts down at 1 MHz, twice per tick on RP2040 (erratum
+// RP2040-E1), from a 24-bit load value.
+#if PICO_RP2040
+constexpr uint32_t kLoadPerUs = 2;
+#else
+constexpr uint32_t kLoadPerUs = 1;
+#endif
+constexpr uint32_t kMaxLoad = 0xFFFFFF;
+
+constexpr const char* kPhaseNames[kGuardPhaseCount] = {
+    "other", "init", "update", "midi", "console", "test",
+};
+
+constexpr uint32_t kBudgetMs[kGuardPhaseCount] = {
+    1000,  // other: stdio_init_all() brings up USB
+    3000,  // init
+    250,   // update: may load calibration from flash on a test change;
+           // button callbacks mustn't print (USB stdio can block 500 ms)
+    50,    // midi
+    1000,  // console
+    0,     // test: from settings
+};
+
+// Survives a watchdog reset; validated by the magic and the check word.
+struct HangRecord {
+    uint32_t magic;
+    uint8_t  phase;
+    uint8_t  test;
+    uint8_t  last_phase;    // of the most recent hang
+    uint8_t  last_test;
+    uint8_t  repeats;       // consecutive hangs in last_test
+    uint32_t hangs;
+    uint32_t phase_hangs[kGuardPhaseCount];
+    uint32_t check;
+};
+
+HangRecord __uninitialized_ram(g_record);
+
+bool     g_hung_this_boot = false;
+uint8_t  g_phase          = kGuardOther;
+uint32_t g_phase_start_us = 0;
+uint32_t g_max_us[kGuardPhaseCount];
+
+uint32_t record_check(const HangRecord& r) {
+    uint32_t c = r.magic ^ r.hangs ^ (static_cast<uint32_t>(r.last_phase) << 8) ^ r.last_test ^
+                 (static_cast<uint32_t>(r.repeats) << 16);
+    for (uint32_t h : r.phase_hangs) c = (c << 5 | c >> 27) ^ h;
+    return c;
+}
+
+uint32_t budget_ms(uint8_t phase) {
+    if (phase == kGuardTest) return static_cast<uint32_t>(setting(kSettingWatchdogTestMs));
+    return kBudgetMs[phase];
+}
+
+void DIAG_HOT_FUNC(reload)(uint8_t phase) {
+    uint32_t load = budget_ms(phase) * 1000 * kLoadPerUs;
+    watchdog_hw->load = load > kMaxLoad ? kMaxLoad : load;
+}
+
+}  // namespace
+
+void hang_guard_start() {
+    bool valid = g_record.magic == kRecordMagic && g_record.check == record_check(g_record);
+    if (!valid) {
+        g_record = HangRecord{};
+        g_record.magic = kRecordMagic;
+    } else if (watchdog_enable_caused_reboot() && g_record.phase < kGuardPhaseCount) {
+        // Reset mid-phase by our own watchdog: that phase overran.
+        g_hung_this_boot = true;
+        ++g_record.hangs;
+        ++g_record.phase_hangs[g_record.phase];
+        bool same = g_record.repeats > 0 && g_record.last_test == g_record.test;
+        g_record.repeats = same ? static_cast<uint8_t>(g_record.repeats + 1) : 1;
+        g_record.last_phase = g_record.phase;
+        g_record.last_test = g_record.test;
+    }
+    g_record.phase = kGuardInit;
+    g_record.test = 0;
+    g_record.check = record_check(g_record);
+
+    g_phase = kGuardInit;
+    g_phase_start_us = time_us_32();
+    // Pausing on debug keeps a breakpoint from resetting the board.
+    watchdog_enable(budget_ms(kGuardInit), true);
+    reload(kGuardInit);
+}
+
+void DIAG_HOT_FUNC(hang_guard_enter)(GuardPhase phase, uint8_t test) {
+    uint32_t now = time_us_32();
+    uint32_t took = now - g_phase_start_us;
+    if (took > g_max_us[g_phase]) g_max_us[g_phase] = took;
+    g_phase = phase;
+    g_phase_start_us = now;
+    // The check word doesn't cover these two, so marking a phase is two
+    // byte stores.
+    g_record.phase = phase;
+    g_record.test = test;
+    if (g_record.repeats != 0 && test != g_record.last_test) {
+        // Moved on from the test that hung, so a later hang there is a
+        // fresh one.
+        g_record.repeats = 0;
+        g_record.check = record_check(g_record);
+    }
+    reload(phase);
+}
+
+bool hang_guard_resume(uint8_t& test) {
+    if (!g_hung_this_boot || g_record.repeats >= kMaxResumes) return false;
+    test = g_record.last_test;
+    return true;
+}
+
+void hang_guard_announce() {
+    if (!g_hung_this_boot) return;
+    printf("event hang phase=%s test=%u hangs=%lu resumed=%u\n", kPhaseNames[g_record.last_phase],
+           g_record.last_test, static_cast<unsigned long>(g_record.hangs),
+           g_record.repeats < kMaxResumes ? 1u : 0u);
+}
+
+void hang_guard_report() {
+    printf("watchdog hangs=%lu last_phase=%s last_test=%u\n",
+           static_cast<unsigned long>(g_record.hangs),
+           g_record.hangs > 0 ? kPhaseNames[g_record.last_phase] : "none", g_record.last_test);
+    for (uint8_t i = 0; i < kGuardPhaseCount; ++i) {
+        printf("watchdog phase=%s budget_ms=%lu max_us=%lu hangs=%lu\n", kPhaseNames[i],
+               static_cast<unsigned long>(budget_ms(i)), static_cast<unsigned long>(g_max_us[i]),
+               static_cast<unsigned long>(g_record.phase_hangs[i]));
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+
+// Hardware-watchdog supervision of the main loop.
+//
+// The loop marks which phase it is in, and each mark reloads the watchdog
+// with that phase's budget. If a peripheral wedges inside update() or a
+// test handler, the watchdog resets the board. The phase and test that
+// overran are kept in RAM that the boot code doesn't clear, so after the
+// reboot the firmware reports the hang and resumes the same test.
+enum GuardPhase : uint8_t {
+    kGuardOther = 0,  // indicator, USB start-up, anything between phases
+    kGuardInit,       // g_brain.init_all()
+    kGuardUpdate,     // g_brain.update(), including button callbacks
+    kGuardMidi,       // feeding the MIDI parser
+    kGuardConsole,    // console commands, including test changes
+    kGuardTest,       // run_test(); budget is the wd_test_ms setting
+    kGuardPhaseCount,
+};
+
+// Reads the record left by the previous run, then starts the watchdog.
+// Call first thing in main().
+void hang_guard_start();
+
+// Enters a phase and reloads the watchdog with its budget.
+void hang_guard_enter(GuardPhase phase, uint8_t test);
+
+// After a reset by the watchdog: the test to go back to. A test that hung
+// twice in a row is not resumed again.
+bool hang_guard_resume(uint8_t& test);
+
+// Prints "event hang phase=<name> test=<n> hangs=<n>" if this boot
+// followed a hang. Call once a host is listening.
+void hang_guard_announce();
+
+// Prints "watchdog hangs=<n> last_phase=<name> last_test=<n>" followed by
+// one "watchdog phase=<name> budget_ms=<n> max_us=<n> hangs=<n>" line per
+// phase. max_us is the longest the phase has taken since boot.
+void hang_guard_report();
@@ -0,0 +1,192 @@
+// brain-logic: records the firmware's logic analyzer (host-only test 31,
+// see logic_analyzer.h in the firmware) as a VCD file for a waveform
+// viewer such as GTKWave or PulseView.
+//
+//   brain-logic [--seconds S] [--rate HZ] [--burst] [--trigger N] [--pulse HZ]
+//       /dev/ttyACM0 > capture.vcd
+//
+// --rate sets logic_hz first, and --pulse logic_pulse_hz; without them the
+// board keeps its settings. logic_burst and logic_trigger are always set:
+// continuous and free-running unless --burst or --trigger (1-5, the
+// channel whose rising edge starts a capture) say otherwise.
+//
+// Times are in nanoseconds from the first sample, at the rate the status
+// frames report. Samples the board dropped or frames lost on the way show
+// as x on every channel until the stream picks up again, and each burst
+// starts with a "$comment burst N" line; bursts are laid end to end, as
+// the time between them isn't measured. Status frames go to stderr.
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "logic_decoder.h"
+#include "serial_port.h"
+#include "test_ids.h"
+
+namespace {
+
+// VCD identifiers and names, in the stream's bit order.
+constexpr char        kIds[kLogicChannels] = {'!', '"', '#', '$', '%'};
+constexpr const char* kNames[kLogicChannels] = {
+    "pulse_in", "pulse_out", "button_a", "button_b", "midi_rx",
+};
+
+void usage() {
+    std::fprintf(stderr,
+                 "usage: brain-logic [--seconds S] [--rate HZ] [--burst] [--trigger N] "
+                 "[--pulse HZ] DEVICE\n");
+}
+
+class VcdSink {
+public:
+    void change(uint64_t index, uint8_t state) {
+        if (!time(index)) return;
+        for (uint8_t i = 0; i < kLogicChannels; ++i) {
+            char level = state & (1u << i) ? '1' : '0';
+            if (level != levels_[i]) std::printf("%c%c\n", level, kIds[i]);
+            levels_[i] = level;
+        }
+    }
+
+    void gap(uint64_t from, uint64_t /*to*/) {
+        if (!time(from)) return;
+        for (uint8_t i = 0; i < kLogicChannels; ++i) {
+            if (levels_[i] != 'x') std::printf("x%c\n", kIds[i]);
+            levels_[i] = 'x';
+        }
+    }
+
+    void burst(uint32_t number, uint64_t index) {
+        if (!time(index)) return;
+        std::printf("$comment burst %u $end\n", number);
+    }
+
+    void status(const LogicStatus& st) {
+        std::fprintf(stderr,
+                     "status rate_hz=%u burst=%u trigger=%u samples=%u transitions=%u "
+                     "dropped=%u bursts=%u\n",
+                     st.rate_hz, st.burst, st.trigger, st.samples, st.transitions, st.dropped,
+                     st.bursts);
+        if (rate_hz_ != 0 || st.rate_hz == 0) return;
+        rate_hz_ = st.rate_hz;
+        std::printf("$version brain-logic $end\n$timescale 1 ns $end\n$scope module brain $end\n");
+        for (uint8_t i = 0; i < kLogicChannels; ++i) {
+            std::printf("$var wire 1 %c %s $end\n", kIds[i], kNames[i]);
+        }
+        std::printf("$upscope $end\n$enddefinitions $end\n");
+    }
+
+    uint64_t skipped() const { return skipped_; }
+
+private:
+    // Writes the timestamp for `index` if it moved on. False until a status
+    // frame has given the rate.
+    bool time(uint64_t index) {
+        if (rate_hz_ == 0) {
+            ++skipped_;
+            return false;
+        }
+        if (!have_origin_) {
+            have_origin_ = true;
+            origin_ = index;
+        }
+        auto ns = static_cast<unsigned long long>(
+            static_cast<double>(index - origin_) * 1e9 / rate_hz_ + 0.5);
+        if (!have_time_ || ns > last_ns_) std::printf("#%llu\n", ns);
+        have_time_ = true;
+        last_ns_ = ns;
+        return true;
+    }
+
+    uint32_t rate_hz_     = 0;
+    bool     have_origin_ = false;
+    uint64_t origin_      = 0;
+    bool     have_time_   = false;
+    unsigned long long last_ns_ = 0;
+    char     levels_[kLogicChannels] = {'?', '?', '?', '?', '?'};
+    uint64_t skipped_     = 0;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    long long seconds = 0;
+    long rate = -1;
+    long pulse = -1;
+    long trigger = 0;
+    bool burst = false;
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        if (a == "--seconds" && i + 1 < argc) {
+            seconds = std::atoll(argv[++i]);
+        } else if (a == "--rate" && i + 1 < argc) {
+            rate = std::atol(argv[++i]);
+        } else if (a == "--pulse" && i + 1 < argc) {
+            pulse = std::atol(argv[++i]);
+        } else if (a == "--trigger" && i + 1 < argc) {
+            trigger = std::atol(argv[++i]);
+        } else if (a == "--burst") {
+            burst = true;
+        } else {
+            args.push_back(a);
+        }
+    }
+    if (args.size() != 1 || trigger < 0 || trigger > kLogicChannels) {
+        usage();
+        return 2;
+    }
+
+    std::string error;
+    int fd = serial_open(args[0], error);
+    if (fd < 0) {
+        std::fprintf(stderr, "brain-logic: %s: %s\n", args[0].c_str(), error.c_str());
+        return 1;
+    }
+    std::string select;
+    if (rate >= 0) select += "set logic_hz " + std::to_string(rate) + "\n";
+    if (pulse >= 0) select += "set logic_pulse_hz " + std::to_string(pulse) + "\n";
+    select += "set logic_burst " + std::string(burst ? "1" : "0") + "\n";
+    select += "set logic_trigger " + std::to_string(trigger) + "\n";
+    select += "test " + std::to_string(kTestLogic) + "\n";
+    if (!write_all(fd, select)) {
+        std::fprintf(stderr, "brain-logic: write failed: %s\n", std::strerror(errno));
+        return 1;
+    }
+
+    stop_on_signals();
+    LogicDecoder decoder;
+    VcdSink sink;
+    static StreamBuffer<kLogicFrameMax> buffer;
+    long long start = monotonic_ms();
+    while (!stop_requested()) {
+        if (seconds > 0 && monotonic_ms() - start >= seconds * 1000) break;
+        if (!buffer.read_from(fd, decoder, sink)) {
+            std::fprintf(stderr, "brain-logic: device closed\n");
+            break;
+        }
+    }
+    // Back to test 1, so the board stops streaming into a closed port.
+    write_all(fd, "test " + std::to_string(kTestLeds) + "\n");
+    close(fd);
+
+    const LogicCounters& c = decoder.counters();
+    std::fprintf(stderr,
+                 "decoder frames=%llu transitions=%llu bad_frames=%llu missed_frames=%llu "
+                 "gaps=%llu gap_samples=%llu other_bytes=%llu before_status=%llu\n",
+                 static_cast<unsigned long long>(c.frames),
+                 static_cast<unsigned long long>(c.transitions),
+                 static_cast<unsigned long long>(c.bad_frames),
+                 static_cast<unsigned long long>(c.missed_frames),
+                 static_cast<unsigned long long>(c.gaps),
+                 static_cast<unsigned long long>(c.gap_samples),
+                 static_cast<unsigned long long>(c.other_bytes),
+                 static_cast<unsigned long long>(sink.skipped()));
+    return 0;
+}
@@ -0,0 +1,178 @@
+// brain-midi-sniff: logs every byte on a board's MIDI input from the
+// firmware's MIDI sniffer (host-only test 32, see midi_sniffer.h in the
+// firmware), with what the SDK's parser made of it.
+//
+//   brain-midi-sniff [--seconds S] [--stats] /dev/ttyACM0 > midi.log
+//
+// One line per record, times in device microseconds:
+//
+//   byte t_us=<t> value=0x<hh> [errors=<framing,parity,break,overrun>]
+//   note_on t_us=<t> channel=<0-15> note=<n> velocity=<v>
+//   note_off t_us=<t> channel=<0-15> note=<n> velocity=<v>
+//
+// Status frames go to stderr, and at the end a summary:
+//
+//   summary bytes=<n> peak_bytes_per_s=<n> line_errors=<n> overruns=<n> dropped=<n>
+//           lossless=<0|1>
+//
+// line_errors counts framing, parity and break errors: bad bits on the
+// wire, the sender's or the cable's doing. overruns are bytes the UART
+// lost before its interrupt ran, and dropped those the firmware's ring
+// lost; lossless is 1 when neither happened and no frame went missing on
+// the way, i.e. the board kept up. At full 31.25 kbaud, peak_bytes_per_s
+// reads 3125. --stats skips the per-record lines.
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "midi_sniff_decoder.h"
+#include "serial_port.h"
+#include "test_ids.h"
+
+namespace {
+
+void usage() {
+    std::fprintf(stderr, "usage: brain-midi-sniff [--seconds S] [--stats] DEVICE\n");
+}
+
+class LogSink {
+public:
+    explicit LogSink(bool log) : log_(log) {}
+
+    void byte(const MidiSniffByte& b) {
+        // Bytes per whole second of device time.
+        uint64_t second = b.t_us / 1000000;
+        if (second != second_) {
+            second_ = second;
+            window_ = 0;
+        }
+        if (++window_ > peak_) peak_ = window_;
+        if (b.flags & (kMidiSniffFraming | kMidiSniffParity | kMidiSniffBreak)) ++line_errors_;
+        if (b.flags & kMidiSniffOverrun) ++overruns_;
+        if (!log_) return;
+        std::printf("byte t_us=%llu value=0x%02x", static_cast<unsigned long long>(b.t_us),
+                    b.byte);
+        if (b.flags != 0) {
+            const char* names[] = {"framing", "parity", "break", "overrun"};
+            const char* sep = " errors=";
+            for (int i = 0; i < 4; ++i) {
+                if (!(b.flags & (1u << i))) continue;
+                std::printf("%s%s", sep, names[i]);
+                sep = ",";
+            }
+        }
+        std::printf("\n");
+    }
+
+    void note(const MidiSniffNote& n) {
+        if (!log_) return;
+        std::printf("%s t_us=%llu channel=%u note=%u velocity=%u\n",
+                    n.on ? "note_on" : "note_off", static_cast<unsigned long long>(n.t_us),
+                    n.channel, n.note, n.velocity);
+    }
+
+    void status(const MidiSniffStatus& st) {
+        std::fprintf(stderr,
+                     "status bytes=%u framing=%u parity=%u breaks=%u overruns=%u dropped=%u "
+                     "note_on=%u note_off=%u high_water=%u\n",
+                     st.bytes, st.framing, st.parity, st.breaks, st.overruns, st.dropped,
+                     st.note_on, st.note_off, st.high_water);
+        last_ = st;
+        have_status_ = true;
+    }
+
+    bool have_status() const { return have_status_; }
+    const MidiSniffStatus& last() const { return last_; }
+    uint32_t peak_bytes_per_s() const { return peak_; }
+    uint64_t line_errors() const { return line_errors_; }
+    uint64_t overruns() const { return overruns_; }
+
+private:
+    bool            log_;
+    uint64_t        second_ = UINT64_MAX;
+    uint32_t        window_ = 0;
+    uint32_t        peak_   = 0;
+    uint64_t        line_errors_ = 0;
+    uint64_t        overruns_    = 0;
+    bool            have_status_ = false;
+    MidiSniffStatus last_{};
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    long long seconds = 0;
+    bool log = true;
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        if (a == "--seconds" && i + 1 < argc) {
+            seconds = std::atoll(argv[++i]);
+        } else if (a == "--stats") {
+            log = false;
+        } else {
+            args.push_back(a);
+        }
+    }
+    if (args.size() != 1) {
+        usage();
+        return 2;
+    }
+
+    std::string error;
+    int fd = serial_open(args[0], error);
+    if (fd < 0) {
+        std::fprintf(stderr, "brain-midi-sniff: %s: %s\n", args[0].c_str(), error.c_str());
+        return 1;
+    }
+    if (!write_all(fd, "test " + std::to_string(kTestMidiSniffer) + "\n")) {
+        std::fprintf(stderr, "brain-midi-sniff: write failed: %s\n", std::strerror(errno));
+        return 1;
+    }
+
+    stop_on_signals();
+    MidiSniffDecoder decoder;
+    LogSink sink(log);
+    static StreamBuffer<kMidiSniffFrameMax> buffer;
+    long long start = monotonic_ms();
+    while (!stop_requested()) {
+        if (seconds > 0 && monotonic_ms() - start >= seconds * 1000) break;
+        if (!buffer.read_from(fd, decoder, sink)) {
+            std::fprintf(stderr, "brain-midi-sniff: device closed\n");
+            break;
+        }
+    }
+    // Back to test 1, so the board stops streaming into a closed port.
+    write_all(fd, "test " + std::to_string(kTestLeds) + "\n");
+    close(fd);
+
+    const MidiSniffCounters& c = decoder.counters();
+    std::fprintf(stderr,
+                 "decoder frames=%llu bytes=%llu notes=%llu bad_frames=%llu missed_frames=%llu "
+                 "other_bytes=%llu\n",
+                 static_cast<unsigned long long>(c.frames),
+                 static_cast<unsigned long long>(c.bytes),
+                 static_cast<unsigned long long>(c.notes),
+                 static_cast<unsigned long long>(c.bad_frames),
+                 static_cast<unsigned long long>(c.missed_frames),
+                 static_cast<unsigned long long>(c.other_bytes));
+    // Only the ring's drops have to come from a status frame, which may be
+    // up to a second old; the rest is counted from the records themselves.
+    uint32_t dropped = sink.have_status() ? sink.last().dropped : 0;
+    bool lossless = sink.have_status() && sink.overruns() == 0 && dropped == 0 &&
+                    c.missed_frames == 0 && c.bad_frames == 0;
+    std::fprintf(stderr,
+                 "summary bytes=%llu peak_bytes_per_s=%u line_errors=%llu overruns=%llu "
+                 "dropped=%u lossless=%d\n",
+                 static_cast<unsigned long long>(c.bytes), sink.peak_bytes_per_s(),
+                 static_cast<unsigned long long>(sink.line_errors()),
+                 static_cast<unsigned long long>(sink.overruns()), dropped, lossless ? 1 : 0);
+    return 0;
+}
@@ -0,0 +1,371 @@
+// brain-orchestrator: runs a test sequence on every attached Brain at once.
+//
+// All boards share one poll() loop with non-blocking descriptors, so the
+// fixture scales to dozens of boards without a thread per board. Each board
+// is identified by its flash unique ID (the console "id" command) and the
+// results are reported keyed by that ID, independent of which tty it
+// enumerated as.
+//
+//   brain-orchestrator                          # discover /dev/ttyACM* etc.
+//   brain-orchestrator --seq 7:3000,10:2000 /dev/ttyACM0 /dev/ttyACM1
+//
+// Output is tab-separated, one line per device line collected:
+//
+//   <unique-id> <step> <test> <line>
+//
+// preceded by one "# board ..." summary line per board.
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+#include <unistd.h>
+
+#include "serial_port.h"
+#include "test_ids.h"
+
+namespace {
+
+constexpr int kDefaultDwellMs   = 1000;
+constexpr int kDefaultTimeoutMs = 2000;
+
+struct Step {
+    int test;
+    int dwell_ms;
+};
+
+struct StepResult {
+    int test;
+    std::vector<std::string> lines;
+};
+
+enum BoardState {
+    kIdentify,
+    kSelect,
+    kDwell,
+    kDone,
+    kFailed,
+};
+
+struct Board {
+    std::string path;
+    int         fd = -1;
+    LineBuffer  rx;
+    std::string tx;
+    BoardState  state    = kIdentify;
+    long long   deadline = 0;
+    size_t      step     = 0;
+    std::string uid;
+    std::string platform;
+    std::string error;
+    std::vector<StepResult> results;
+};
+
+void usage() {
+    std::fprintf(stderr,
+        "usage: brain-orchestrator [--seq T[:MS],...] [--timeout MS] [--out FILE] [device...]\n"
+        "  --seq      tests to run in order, each with an optional dwell time\n"
+        "             (default: all %d manual tests, %d ms each)\n"
+        "  --timeout  per-command reply timeout in ms (default %d)\n"
+        "  --out      write results to FILE instead of stdout\n"
+        "  device     tty paths; default is every /dev/ttyACM* or /dev/cu.usbmodem*\n",
+        static_cast<int>(kTestCount), kDefaultDwellMs, kDefaultTimeoutMs);
+}
+
+bool parse_sequence(const std::string& spec, std::vector<Step>& steps) {
+    size_t pos = 0;
+    while (pos <= spec.size()) {
+        size_t comma = spec.find(',', pos);
+        std::string item = spec.substr(pos, comma == std::string::npos ? std::string::npos
+                                                                       : comma - pos);
+        char* end = nullptr;
+        long test = std::strtol(item.c_str(), &end, 10);
+        if (end == item.c_str() || test < 0 || test > 63) return false;
+        long dwell = kDefaultDwellMs;
+        if (*end == ':') {
+            char* dwell_end = nullptr;
+            dwell = std::strtol(end + 1, &dwell_end, 10);
+            if (dwell_end == end + 1 || *dwell_end != '\0' || dwell < 0) return false;
+        } else if (*end != '\0') {
+            return false;
+        }
+        steps.push_back({static_cast<int>(test), static_cast<int>(dwell)});
+        if (comma == std::string::npos) break;
+        pos = comma + 1;
+    }
+    return !steps.empty();
+}
+
+void send(Board& b, const std::string& line) {
+    b.tx += line;
+    b.tx += '\n';
+}
+
+void fail(Board& b, const std::string& reason) {
+    b.state = kFailed;
+    b.error = reason;
+}
+
+void start_step(Board& b, const std::vector<Step>& steps, long long now, int timeout_ms) {
+    if (b.step >= steps.size()) {
+        b.state = kDone;
+        return;
+    }
+    send(b, "test " + std::to_string(steps[b.step].test));
+    b.state = kSelect;
+    b.deadline = now + timeout_ms;
+}
+
+// Returns the value of `key=` in a reply line, or "" if absent.
+std::string field(const std::string& line, const std::string& key) {
+    std::string needle = " " + key + "=";
+    size_t at = line.find(needle);
+    if (at == std::string::npos) return "";
+    at += needle.size();
+    return line.substr(at, line.find(' ', at) - at);
+}
+
+void handle_line(Board& b, const std::string& line, const std::vector<Step>& steps,
+                 long long now, int timeout_ms) {
+    if (line.empty()) return;
+    switch (b.state) {
+        case kIdentify:
+            // Anything before the id reply (manual-test events, stale output)
+            // is noise from before we took over.
+            if (line.compare(0, 3, "id ") == 0) {
+                size_t end = line.find(' ', 3);
+                b.uid = line.substr(3, end == std::string::npos ? std::string::npos : end - 3);
+                b.platform = field(line, "platform");
+                start_step(b, steps, now, timeout_ms);
+            }
+            break;
+        case kSelect:
+            if (line.compare(0, 4, "err ") == 0) {
+                fail(b, "step " + std::to_string(b.step) + ": " + line);
+            } else if (line.compare(0, 3, "ok ") == 0 &&
+                       field(line, "test") == std::to_string(steps[b.step].test)) {
+                b.results.push_back({steps[b.step].test, {}});
+                b.state = kDwell;
+                b.deadline = now + steps[b.step].dwell_ms;
+            }
+            break;
+        case kDwell:
+            b.results.back().lines.push_back(line);
+            break;
+        case kDone:
+        case kFailed:
+            break;
+    }
+}
+
+void handle_deadline(Board& b, const std::vector<Step>& steps, long long now, int timeout_ms) {
+    switch (b.state) {
+        case kIdentify:
+            fail(b, "no id reply (not a brain-diagnostics device?)");
+            break;
+        case kSelect:
+            fail(b, "step " + std::to_string(b.step) + ": no reply to test select");
+            break;
+        case kDwell:
+            ++b.step;
+            start_step(b, steps, now, timeout_ms);
+            break;
+        case kDone:
+        case kFailed:
+            break;
+    }
+}
+
+bool active(const Board& b) {
+    return b.state != kDone && b.state != kFailed;
+}
+
+void pump_read(Board& b, const std::vector<Step>& steps, int timeout_ms) {
+    char buf[4096];
+    while (true) {
+        ssize_t n = read(b.fd, buf, sizeof(buf));
+        if (n > 0) {
+            b.rx.append(buf, static_cast<size_t>(n));
+            continue;
+        }
+        // A raw tty with VMIN=0 reports "no data" as 0, not EAGAIN; hang-ups
+        // are picked up from POLLHUP instead.
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            fail(b, "disconnected");
+        }
+        break;
+    }
+    long long now = monotonic_ms();
+    std::string line;
+    while (active(b) && b.rx.next_line(line)) {
+        handle_line(b, line, steps, now, timeout_ms);
+    }
+}
+
+void pump_write(Board& b) {
+    while (!b.tx.empty()) {
+        ssize_t n = write(b.fd, b.tx.data(), b.tx.size());
+        if (n > 0) {
+            b.tx.erase(0, static_cast<size_t>(n));
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) break;
+        fail(b, "write failed");
+        break;
+    }
+}
+
+void run(std::vector<std::unique_ptr<Board>>& boards, const std::vector<Step>& steps,
+         int timeout_ms) {
+    long long now = monotonic_ms();
+    for (auto& b : boards) {
+        // Leading newline flushes any half-typed line on the device side.
+        send(*b, "");
+        send(*b, "id");
+        b->deadline = now + timeout_ms;
+    }
+
+    std::vector<pollfd> fds;
+    std::vector<Board*> polled;
+    while (true) {
+        fds.clear();
+        polled.clear();
+        long long next_deadline = -1;
+        for (auto& b : boards) {
+            if (!active(*b)) continue;
+            short events = POLLIN;
+            if (!b->tx.empty()) events |= POLLOUT;
+            fds.push_back({b->fd, events, 0});
+            polled.push_back(b.get());
+            if (next_deadline < 0 || b->deadline < next_deadline) next_deadline = b->deadline;
+        }
+        if (fds.empty()) break;
+
+        now = monotonic_ms();
+        int wait_ms = static_cast<int>(std::max(0LL, next_deadline - now));
+        int ready = poll(fds.data(), fds.size(), wait_ms);
+        if (ready < 0 && errno != EINTR) {
+            std::perror("poll");
+            return;
+        }
+
+        for (size_t i = 0; i < fds.size(); ++i) {
+            Board& b = *polled[i];
+            if (fds[i].revents & POLLIN) pump_read(b, steps, timeout_ms);
+            if (active(b) && (fds[i].revents & POLLOUT)) pump_write(b);
+            if (active(b) && (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL))) {
+                fail(b, "disconnected");
+            }
+        }
+
+        now = monotonic_ms();
+        for (auto& b : boards) {
+            if (!active(*b)) continue;
+            if (!b->tx.empty()) pump_write(*b);
+            if (active(*b) && now >= b->deadline) handle_deadline(*b, steps, now, timeout_ms);
+        }
+    }
+}
+
+void report(FILE* out, const std::vector<std::unique_ptr<Board>>& boards) {
+    // Key by unique ID so the report does not depend on enumeration order.
+    std::multimap<std::string, const Board*> by_id;
+    for (const auto& b : boards) {
+        by_id.emplace(b->uid.empty() ? "unknown:" + b->path : b->uid, b.get());
+    }
+
+    for (const auto& entry : by_id) {
+        const Board& b = *entry.second;
+        std::fprintf(out, "# board %s platform=%s path=%s status=%s%s%s\n",
+                     entry.first.c_str(), b.platform.empty() ? "-" : b.platform.c_str(),
+                     b.path.c_str(), b.state == kDone ? "ok" : "failed",
+                     b.error.empty() ? "" : " reason=", b.error.c_str());
+    }
+    for (const auto& entry : by_id) {
+        const Board& b = *entry.second;
+        for (size_t s = 0; s < b.results.size(); ++s) {
+            for (const std::string& line : b.results[s].lines) {
+                std::fprintf(out, "%s\t%zu\t%d\t%s\n", entry.first.c_str(), s,
+                             b.results[s].test, line.c_str());
+            }
+        }
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::vector<Step> steps;
+    std::vector<std::string> paths;
+    int timeout_ms = kDefaultTimeoutMs;
+    const char* out_path = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--seq" && i + 1 < argc) {
+            if (!parse_sequence(argv[++i], steps)) {
+                std::fprintf(stderr, "bad --seq value: %s\n", argv[i]);
+                return 2;
+            }
+        } else if (arg == "--timeout" && i + 1 < argc) {
+            timeout_ms = std::atoi(argv[++i]);
+        } else if (arg == "--out" && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (arg == "-h" || arg == "--help") {
+            usage();
+            return 0;
+        } else if (!arg.empty() && arg[0] == '-') {
+            usage();
+            return 2;
+        } else {
+            paths.push_back(arg);
+        }
+    }
+
+    if (steps.empty()) {
+        for (int t = 0; t < kTestCount; ++t) steps.push_back({t, kDefaultDwellMs});
+    }
+    if (paths.empty()) paths = serial_discover();
+    if (paths.empty()) {
+        std::fprintf(stderr, "no devices found\n");
+        return 1;
+    }
+
+    std::vector<std::unique_ptr<Board>> boards;
+    for (const std::string& path : paths) {
+        auto b = std::make_unique<Board>();
+        b->path = path;
+        std::string error;
+        b->fd = serial_open(path, error);
+        if (b->fd < 0) fail(*b, "open: " + error);
+        boards.push_back(std::move(b));
+    }
+
+    run(boards, steps, timeout_ms);
+
+    FILE* out = stdout;
+    if (out_path != nullptr) {
+        out = std::fopen(out_path, "w");
+        if (out == nullptr) {
+            std::perror(out_path);
+            return 1;
+        }
+    }
+    report(out, boards);
+    if (out != stdout) std::fclose(out);
+
+    int failed = 0;
+    for (auto& b : boards) {
+        if (b->fd >= 0) close(b->fd);
+        if (b->state != kDone) ++failed;
+    }
+    std::fprintf(stderr, "%zu board(s), %d failed\n", boards.size(), failed);
+    return failed == 0 ? 0 : 1;
+}
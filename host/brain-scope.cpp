@@ -0,0 +1,161 @@
+// brain-scope: streams both CV inputs from the firmware's scope mode
+// (host-only test 30, see scope.h in the firmware) and prints them as CSV.
+//
+//   brain-scope [--seconds S] [--rate HZ] [--stats] /dev/ttyACM0 > scope.csv
+//
+// The columns are t_us, a_mv and b_mv, in nominal millivolts (±5 V over
+// 12 bits, no calibration). t_us is the time of each A/B pair from the
+// first one, worked out from the block sequence numbers, so dropped blocks
+// show as a jump in time; B was converted half a sample period after A.
+// After a rate change the time carries on from the last pair.
+//
+// --rate sets scope_hz first; 0, the firmware's default, lets the board
+// step down to the fastest rate it sustains. Status frames go to stderr,
+// and at the end a summary with the highest rate that ran for three
+// seconds in a row without dropping a block. --stats skips the
+// CSV, for measuring the link alone.
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "scope_decoder.h"
+#include "serial_port.h"
+#include "test_ids.h"
+
+namespace {
+
+constexpr uint32_t kSustainedSeconds = 3;
+constexpr double   kMvPerCount       = 10000.0 / 4096.0;
+constexpr int      kMidScale         = 2048;
+
+void usage() {
+    std::fprintf(stderr, "usage: brain-scope [--seconds S] [--rate HZ] [--stats] DEVICE\n");
+}
+
+class CsvSink {
+public:
+    explicit CsvSink(bool csv) : csv_(csv) {
+        if (csv_) std::printf("t_us,a_mv,b_mv\n");
+    }
+
+    void block(const ScopeBlock& b) {
+        if (period_us_ <= 0.0) return;  // no status yet, so no rate
+        if (new_segment_) {
+            new_segment_ = false;
+            base_seq_ = b.seq;
+            base_us_ = next_us_;
+        }
+        double t = base_us_ + static_cast<double>(b.seq - base_seq_) * b.pairs * period_us_;
+        for (size_t i = 0; i < b.pairs; ++i, t += period_us_) {
+            if (!csv_) continue;
+            std::printf("%.2f,%.2f,%.2f\n", t, (b.a(i) - kMidScale) * kMvPerCount,
+                        (b.b(i) - kMidScale) * kMvPerCount);
+        }
+        next_us_ = t;
+    }
+
+    void status(const ScopeStatus& st) {
+        std::fprintf(stderr,
+                     "status rate_hz=%u clean_s=%u blocks_sent=%u blocks_dropped=%u "
+                     "bytes_per_s=%u\n",
+                     st.rate_hz, st.clean_s, st.blocks_sent, st.blocks_dropped, st.bytes_per_s);
+        if (st.rate_hz != rate_hz_) {
+            rate_hz_ = st.rate_hz;
+            period_us_ = st.rate_hz > 0 ? 2e6 / st.rate_hz : 0.0;  // two inputs per pair
+            new_segment_ = true;
+        }
+        if (st.clean_s >= kSustainedSeconds && st.rate_hz > sustained_hz_) {
+            sustained_hz_ = st.rate_hz;
+            sustained_bytes_per_s_ = st.bytes_per_s;
+        }
+    }
+
+    uint32_t sustained_hz() const { return sustained_hz_; }
+    uint32_t sustained_bytes_per_s() const { return sustained_bytes_per_s_; }
+
+private:
+    bool     csv_;
+    uint32_t rate_hz_     = 0;
+    double   period_us_   = 0.0;
+    bool     new_segment_ = false;
+    uint32_t base_seq_    = 0;
+    double   base_us_     = 0.0;
+    double   next_us_     = 0.0;
+    uint32_t sustained_hz_ = 0;
+    uint32_t sustained_bytes_per_s_ = 0;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    long long seconds = 0;
+    long rate = -1;
+    bool csv = true;
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        if (a == "--seconds" && i + 1 < argc) {
+            seconds = std::atoll(argv[++i]);
+        } else if (a == "--rate" && i + 1 < argc) {
+            rate = std::atol(argv[++i]);
+        } else if (a == "--stats") {
+            csv = false;
+        } else {
+            args.push_back(a);
+        }
+    }
+    if (args.size() != 1) {
+        usage();
+        return 2;
+    }
+
+    std::string error;
+    int fd = serial_open(args[0], error);
+    if (fd < 0) {
+        std::fprintf(stderr, "brain-scope: %s: %s\n", args[0].c_str(), error.c_str());
+        return 1;
+    }
+    std::string select;
+    if (rate >= 0) select += "set scope_hz " + std::to_string(rate) + "\n";
+    select += "test " + std::to_string(kTestScope) + "\n";
+    if (!write_all(fd, select)) {
+        std::fprintf(stderr, "brain-scope: write failed: %s\n", std::strerror(errno));
+        return 1;
+    }
+
+    stop_on_signals();
+    ScopeDecoder decoder;
+    CsvSink sink(csv);
+    static StreamBuffer<kScopeFrameMax> buffer;
+    long long start = monotonic_ms();
+    while (!stop_requested()) {
+        if (seconds > 0 && monotonic_ms() - start >= seconds * 1000) break;
+        if (!buffer.read_from(fd, decoder, sink)) {
+            std::fprintf(stderr, "brain-scope: device closed\n");
+            break;
+        }
+    }
+    // Back to test 1, so the board stops streaming into a closed port.
+    write_all(fd, "test " + std::to_string(kTestLeds) + "\n");
+    close(fd);
+
+    const ScopeCounters& c = decoder.counters();
+    std::fprintf(stderr,
+                 "decoder frames=%llu blocks=%llu pairs=%llu bad_frames=%llu "
+                 "missed_blocks=%llu other_bytes=%llu\n",
+                 static_cast<unsigned long long>(c.frames),
+                 static_cast<unsigned long long>(c.blocks),
+                 static_cast<unsigned long long>(c.pairs),
+                 static_cast<unsigned long long>(c.bad_frames),
+                 static_cast<unsigned long long>(c.missed_blocks),
+                 static_cast<unsigned long long>(c.other_bytes));
+    std::fprintf(stderr, "summary sustained_hz=%u bytes_per_s=%u\n", sink.sustained_hz(),
+                 sink.sustained_bytes_per_s());
+    return 0;
+}
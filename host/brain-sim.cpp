@@ -0,0 +1,148 @@
+// brain-sim: simulated brain-diagnostics boards on local ptys.
+//
+// Creates N pseudo-terminals that speak the firmware's console protocol
+// (see console.h) and prints the slave paths, one per line, so they can be
+// handed straight to the host tools:
+//
+//   ./brain-sim --count 32 > devices.txt &
+//   ./brain-orchestrator --seq 0:200,7:200 $(cat devices.txt)
+//
+// --mute N leaves board N silent, to exercise timeout handling.
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "serial_port.h"
+
+namespace {
+
+constexpr int kTestLimit = 64;  // the LED indicator can show up to 63
+
+struct SimBoard {
+    int         master = -1;
+    int         slave  = -1;  // kept open so the pty survives between clients
+    std::string path;
+    std::string uid;
+    LineBuffer  rx;
+    std::string tx;
+    int         test  = 0;
+    bool        muted = false;
+};
+
+bool open_pty(SimBoard& b) {
+    b.master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (b.master < 0 || grantpt(b.master) != 0 || unlockpt(b.master) != 0) return false;
+    const char* name = ptsname(b.master);
+    if (name == nullptr) return false;
+    b.path = name;
+
+    // Raw mode on the slave end disables echo, otherwise every reply would
+    // loop back to us as a command.
+    b.slave = open(name, O_RDWR | O_NOCTTY);
+    if (b.slave < 0 || !serial_make_raw(b.slave)) return false;
+    int flags = fcntl(b.master, F_GETFL, 0);
+    return fcntl(b.master, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+void handle_command(SimBoard& b, const std::string& line) {
+    char word[16] = {0};
+    int arg = 0;
+    int fields = std::sscanf(line.c_str(), "%15s %d", word, &arg);
+    if (fields < 1) return;
+
+    char reply[128];
+    std::string cmd = word;
+    if (cmd == "id") {
+        std::snprintf(reply, sizeof(reply), "id %s platform=sim\n", b.uid.c_str());
+    } else if (cmd == "status") {
+        std::snprintf(reply, sizeof(reply), "status test=%d uptime_ms=%lld\n", b.test,
+                      monotonic_ms());
+    } else if (cmd == "test" && fields == 2 && arg >= 0 && arg < kTestLimit) {
+        b.test = arg;
+        std::snprintf(reply, sizeof(reply), "ok test=%d\nresult test=%d sim=1\n", arg, arg);
+    } else if (cmd == "test") {
+        std::snprintf(reply, sizeof(reply), "err bad-test\n");
+    } else {
+        std::snprintf(reply, sizeof(reply), "err unknown-command\n");
+    }
+    b.tx += reply;
+}
+
+void pump(SimBoard& b) {
+    char buf[1024];
+    ssize_t n;
+    while ((n = read(b.master, buf, sizeof(buf))) > 0) {
+        if (!b.muted) b.rx.append(buf, static_cast<size_t>(n));
+    }
+    std::string line;
+    while (b.rx.next_line(line)) handle_command(b, line);
+
+    while (!b.tx.empty()) {
+        n = write(b.master, b.tx.data(), b.tx.size());
+        if (n <= 0) break;
+        b.tx.erase(0, static_cast<size_t>(n));
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int count = 1;
+    int muted = -1;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--count" && i + 1 < argc) {
+            count = std::atoi(argv[++i]);
+        } else if (arg == "--mute" && i + 1 < argc) {
+            muted = std::atoi(argv[++i]);
+        } else {
+            std::fprintf(stderr, "usage: brain-sim [--count N] [--mute INDEX]\n");
+            return 2;
+        }
+    }
+    if (count < 1) count = 1;
+
+    stop_on_signals();
+
+    std::vector<SimBoard> boards(static_cast<size_t>(count));
+    for (int i = 0; i < count; ++i) {
+        SimBoard& b = boards[static_cast<size_t>(i)];
+        if (!open_pty(b)) {
+            std::perror("pty");
+            return 1;
+        }
+        char uid[17];
+        std::snprintf(uid, sizeof(uid), "E66038B7%08X", 0x1000u + static_cast<unsigned>(i));
+        b.uid = uid;
+        b.muted = (i == muted);
+        std::printf("%s\n", b.path.c_str());
+    }
+    std::fflush(stdout);
+
+    std::vector<pollfd> fds(boards.size());
+    while (!stop_requested()) {
+        for (size_t i = 0; i < boards.size(); ++i) {
+            short events = POLLIN;
+            if (!boards[i].tx.empty()) events |= POLLOUT;
+            fds[i] = {boards[i].master, events, 0};
+        }
+        if (poll(fds.data(), fds.size(), 200) < 0 && errno != EINTR) break;
+        for (size_t i = 0; i < boards.size(); ++i) {
+            if (fds[i].revents & (POLLIN | POLLOUT)) pump(boards[i]);
+        }
+    }
+
+    for (SimBoard& b : boards) {
+        close(b.slave);
+        close(b.master);
+    }
+    return 0;
+}
@@ -0,0 +1,496 @@
+// brain-telemetry: records, replays and slices the firmware's binary
+// telemetry stream (host-only test 25, see telemetry.h in the firmware).
+//
+//   brain-telemetry record [--seconds S] [--rate HZ] /dev/ttyACM0 run1
+//   brain-telemetry replay [--from US] [--to US] run1 > run1.csv
+//   brain-telemetry slice --from US --to US run1 run1-part
+//   brain-telemetry bench [--mb N]
+//
+// A capture is two column files, <name>.samples and <name>.midi (see
+// column_file.h). record selects the telemetry mode, decodes frames as
+// they arrive and appends them; status frames and decoder counters go to
+// stderr. replay prints the capture as CSV in time order, and slice copies
+// a time range into a new capture. bench decodes a synthetic stream, with
+// and without recording, and compares the throughput with USB full speed.
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "column_file.h"
+#include "serial_port.h"
+#include "telemetry_decoder.h"
+#include "test_ids.h"
+
+namespace {
+
+constexpr long long kCommitMs       = 250;
+// USB full-speed bulk tops out near 1.2 MB/s of payload.
+constexpr double   kUsbFullSpeedBytesPerS = 1.2e6;
+
+// Sample columns: t_us, the seven fields, bits.
+constexpr size_t kColTime = 0;
+constexpr size_t kColBits = 1 + kTelemetryFields;
+const std::vector<uint8_t> kSampleWidths = {8, 4, 4, 4, 4, 4, 4, 4, 1};
+const std::vector<uint8_t> kMidiWidths   = {8, 1};
+
+const char* const kFieldNames[kTelemetryFields] = {
+    "pot1", "pot2", "pot3", "cv1_mv", "cv2_mv", "out1_mv", "out2_mv",
+};
+
+void usage() {
+    std::fprintf(stderr,
+        "usage: brain-telemetry record [--seconds S] [--rate HZ] DEVICE CAPTURE\n"
+        "       brain-telemetry replay [--from US] [--to US] CAPTURE\n"
+        "       brain-telemetry slice --from US --to US CAPTURE OUT\n"
+        "       brain-telemetry bench [--mb N]\n");
+}
+
+struct NullSink {
+    uint64_t check = 0;
+    void sample(const TelemetrySample& s) {
+        check = check * 31 + s.t_us + static_cast<uint32_t>(s.v[3]) + s.bits;
+    }
+    void midi(const TelemetryMidi& m) { check = check * 31 + m.t_us + m.byte; }
+    void status(const TelemetryStatus&) {}
+};
+
+class RecordSink {
+public:
+    RecordSink(ColumnFile& samples, ColumnFile& midi) : samples_(samples), midi_(midi) {}
+
+    void sample(const TelemetrySample& s) {
+        uint64_t row;
+        if (!samples_.append(row)) {
+            failed = true;
+            return;
+        }
+        samples_.at<uint64_t>(kColTime, row) = s.t_us;
+        for (size_t i = 0; i < kTelemetryFields; ++i) samples_.at<int32_t>(1 + i, row) = s.v[i];
+        samples_.at<uint8_t>(kColBits, row) = s.bits;
+        check = check * 31 + s.t_us + static_cast<uint32_t>(s.v[3]) + s.bits;
+    }
+
+    void midi(const TelemetryMidi& m) {
+        uint64_t row;
+        if (!midi_.append(row)) {
+            failed = true;
+            return;
+        }
+        midi_.at<uint64_t>(0, row) = m.t_us;
+        midi_.at<uint8_t>(1, row) = m.byte;
+        check = check * 31 + m.t_us + m.byte;
+    }
+
+    void status(const TelemetryStatus& st) {
+        if (!print_status) return;
+        std::fprintf(stderr,
+                     "status rate_hz=%u decimation=%u sent=%u dropped=%u frames_dropped=%u "
+                     "overruns=%u midi_dropped=%u\n",
+                     st.rate_hz, st.decimation, st.samples_sent, st.samples_dropped,
+                     st.frames_dropped, st.loop_overruns, st.midi_dropped);
+    }
+
+    void commit() {
+        samples_.commit();
+        midi_.commit();
+    }
+
+    bool     print_status = true;
+    bool     failed = false;
+    uint64_t check  = 0;
+
+private:
+    ColumnFile& samples_;
+    ColumnFile& midi_;
+};
+
+void report_counters(const TelemetryDecoder& d) {
+    const TelemetryCounters& c = d.counters();
+    std::fprintf(stderr,
+                 "decoder frames=%llu samples=%llu midi_bytes=%llu bad_frames=%llu "
+                 "missed_frames=%llu other_bytes=%llu\n",
+                 static_cast<unsigned long long>(c.frames),
+                 static_cast<unsigned long long>(c.samples),
+                 static_cast<unsigned long long>(c.midi_bytes),
+                 static_cast<unsigned long long>(c.bad_frames),
+                 static_cast<unsigned long long>(c.missed_frames),
+                 static_cast<unsigned long long>(c.other_bytes));
+}
+
+bool create_capture(const std::string& name, ColumnFile& samples, ColumnFile& midi) {
+    std::string error;
+    if (!samples.create(name + ".samples", kSampleWidths, error) ||
+        !midi.create(name + ".midi", kMidiWidths, error)) {
+        std::fprintf(stderr, "brain-telemetry: %s: %s\n", name.c_str(), error.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool open_capture(const std::string& name, ColumnFile& samples, ColumnFile& midi) {
+    std::string error;
+    if (!samples.open(name + ".samples", error) || !midi.open(name + ".midi", error)) {
+        std::fprintf(stderr, "brain-telemetry: %s: %s\n", name.c_str(), error.c_str());
+        return false;
+    }
+    if (samples.columns() != kSampleWidths.size() || midi.columns() != kMidiWidths.size()) {
+        std::fprintf(stderr, "brain-telemetry: %s: not a telemetry capture\n", name.c_str());
+        return false;
+    }
+    return true;
+}
+
+// First row with t_us >= t; the time column is non-decreasing.
+uint64_t lower_bound(const ColumnFile& f, uint64_t t) {
+    uint64_t lo = 0, hi = f.rows();
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (f.at<uint64_t>(kColTime, mid) < t) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+bool parse_u64(const char* text, uint64_t& value) {
+    char* end = nullptr;
+    errno = 0;
+    unsigned long long v = std::strtoull(text, &end, 10);
+    if (end == text || *end != '\0' || errno != 0) return false;
+    value = v;
+    return true;
+}
+
+int cmd_record(int argc, char** argv) {
+    long long seconds = 0;
+    long rate = 0;
+    std::vector<std::string> args;
+    for (int i = 0; i < argc; ++i) {
+        std::string a = argv[i];
+        if (a == "--seconds" && i + 1 < argc) {
+            seconds = std::atoll(argv[++i]);
+        } else if (a == "--rate" && i + 1 < argc) {
+            rate = std::atol(argv[++i]);
+        } else {
+            args.push_back(a);
+        }
+    }
+    if (args.size() != 2) {
+        usage();
+        return 2;
+    }
+
+    std::string error;
+    int fd = serial_open(args[0], error);
+    if (fd < 0) {
+        std::fprintf(stderr, "brain-telemetry: %s: %s\n", args[0].c_str(), error.c_str());
+        return 1;
+    }
+    ColumnFile samples, midi;
+    if (!create_capture(args[1], samples, midi)) return 1;
+
+    std::string select;
+    if (rate > 0) select += "set telemetry_hz " + std::to_string(rate) + "\n";
+    select += "test " + std::to_string(kTestTelemetry) + "\n";
+    if (!write_all(fd, select)) {
+        std::fprintf(stderr, "brain-telemetry: write failed: %s\n", std::strerror(errno));
+        return 1;
+    }
+
+    stop_on_signals();
+    TelemetryDecoder decoder;
+    RecordSink sink(samples, midi);
+    static StreamBuffer<kTelemetryFrameMax> buffer;
+    long long start = monotonic_ms();
+    long long last_commit = start;
+    while (!stop_requested() && !sink.failed) {
+        long long now = monotonic_ms();
+        if (seconds > 0 && now - start >= seconds * 1000) break;
+        if (now - last_commit >= kCommitMs) {
+            sink.commit();
+            last_commit = now;
+        }
+        if (!buffer.read_from(fd, decoder, sink)) {
+            std::fprintf(stderr, "brain-telemetry: device closed\n");
+            break;
+        }
+    }
+    sink.commit();
+    close(fd);
+    report_counters(decoder);
+    std::fprintf(stderr, "capture samples=%llu midi=%llu\n",
+                 static_cast<unsigned long long>(samples.rows()),
+                 static_cast<unsigned long long>(midi.rows()));
+    return sink.failed ? 1 : 0;
+}
+
+int cmd_replay(int argc, char** argv) {
+    uint64_t from = 0, to = UINT64_MAX;
+    std::vector<std::string> args;
+    for (int i = 0; i < argc; ++i) {
+        std::string a = argv[i];
+        bool ok = true;
+        if (a == "--from" && i + 1 < argc) {
+            ok = parse_u64(argv[++i], from);
+        } else if (a == "--to" && i + 1 < argc) {
+            ok = parse_u64(argv[++i], to);
+        } else {
+            args.push_back(a);
+        }
+        if (!ok) {
+            usage();
+            return 2;
+        }
+    }
+    if (args.size() != 1) {
+        usage();
+        return 2;
+    }
+    ColumnFile samples, midi;
+    if (!open_capture(args[0], samples, midi)) return 1;
+
+    std::printf("kind,t_us");
+    for (const char* name : kFieldNames) std::printf(",%s", name);
+    std::printf(",pulse_in,button_b,midi_byte\n");
+
+    // Merge the two tables by time.
+    uint64_t s = lower_bound(samples, from), s_end = lower_bound(samples, to);
+    uint64_t m = lower_bound(midi, from), m_end = lower_bound(midi, to);
+    while (s < s_end || m < m_end) {
+        bool take_sample = m >= m_end || (s < s_end && samples.at<uint64_t>(kColTime, s) <=
+                                                           midi.at<uint64_t>(kColTime, m));
+        if (take_sample) {
+            std::printf("sample,%llu",
+                        static_cast<unsigned long long>(samples.at<uint64_t>(kColTime, s)));
+            for (size_t i = 0; i < kTelemetryFields; ++i) {
+                std::printf(",%d", samples.at<int32_t>(1 + i, s));
+            }
+            uint8_t bits = samples.at<uint8_t>(kColBits, s);
+            std::printf(",%u,%u,\n", bits & 1u, (bits >> 1) & 1u);
+            ++s;
+        } else {
+            std::printf("midi,%llu,,,,,,,,,,%u\n",
+                        static_cast<unsigned long long>(midi.at<uint64_t>(kColTime, m)),
+                        midi.at<uint8_t>(1, m));
+            ++m;
+        }
+    }
+    return 0;
+}
+
+bool copy_rows(const ColumnFile& in, ColumnFile& out, uint64_t first, uint64_t last) {
+    for (uint64_t r = first; r < last; ++r) {
+        uint64_t row;
+        if (!out.append(row)) return false;
+        for (size_t c = 0; c < in.columns(); ++c) {
+            std::memcpy(out.cell(c, row), in.cell(c, r), in.width(c));
+        }
+    }
+    out.commit();
+    return true;
+}
+
+int cmd_slice(int argc, char** argv) {
+    uint64_t from = 0, to = 0;
+    bool have_from = false, have_to = false;
+    std::vector<std::string> args;
+    for (int i = 0; i < argc; ++i) {
+        std::string a = argv[i];
+        if (a == "--from" && i + 1 < argc) {
+            have_from = parse_u64(argv[++i], from);
+        } else if (a == "--to" && i + 1 < argc) {
+            have_to = parse_u64(argv[++i], to);
+        } else {
+            args.push_back(a);
+        }
+    }
+    if (args.size() != 2 || !have_from || !have_to || to < from) {
+        usage();
+        return 2;
+    }
+    ColumnFile samples, midi, out_samples, out_midi;
+    if (!open_capture(args[0], samples, midi)) return 1;
+    if (!create_capture(args[1], out_samples, out_midi)) return 1;
+    if (!copy_rows(samples, out_samples, lower_bound(samples, from), lower_bound(samples, to)) ||
+        !copy_rows(midi, out_midi, lower_bound(midi, from), lower_bound(midi, to))) {
+        std::fprintf(stderr, "brain-telemetry: %s: write failed\n", args[1].c_str());
+        return 1;
+    }
+    std::fprintf(stderr, "capture samples=%llu midi=%llu\n",
+                 static_cast<unsigned long long>(out_samples.rows()),
+                 static_cast<unsigned long long>(out_midi.rows()));
+    return 0;
+}
+
+// Appends a frame built with the firmware's own encoder.
+void append(std::vector<uint8_t>& out, UsbFrame& frame) {
+    size_t n = frame.finish();
+    out.insert(out.end(), frame.data(), frame.data() + n);
+}
+
+// A busy board: CV inputs moving every sample, pots now and then, a MIDI
+// byte every few milliseconds, and some console text in between.
+std::vector<uint8_t> synthetic_stream(size_t bytes, uint64_t& samples) {
+    std::vector<uint8_t> out;
+    out.reserve(bytes + 4096);
+    UsbFrame w;
+    uint8_t seq = 0;
+    std::mt19937 rng(1);
+    int32_t v[kTelemetryFields] = {64, 100, 12, 0, 1250, 0, 1000};
+    uint8_t bits = 0;
+    uint32_t t = 0xFFF00000u;  // wraps early on
+    samples = 0;
+    while (out.size() < bytes) {
+        w.begin(kTelemetrySamples, seq++);
+        int32_t prev[kTelemetryFields];
+        uint8_t prev_bits = bits;
+        for (size_t n = 0; w.size() < 200; ++n) {
+            std::copy(v, v + kTelemetryFields, prev);
+            prev_bits = bits;
+            t += 50 + rng() % 3;
+            v[3] += static_cast<int32_t>(rng() % 9) - 4;
+            v[4] += static_cast<int32_t>(rng() % 41) - 20;
+            if (rng() % 64 == 0) v[rng() % 3] = static_cast<int32_t>(rng() % 128);
+            if (rng() % 256 == 0) bits ^= 1;
+            if (n == 0) {
+                w.put_varint(t);
+                for (int32_t x : v) w.put_signed(x);
+                w.put(bits);
+            } else {
+                w.put_varint(50);
+                uint8_t mask = bits != prev_bits ? 0x80 : 0;
+                for (size_t i = 0; i < kTelemetryFields; ++i) {
+                    if (v[i] != prev[i]) mask |= static_cast<uint8_t>(1u << i);
+                }
+                w.put(mask);
+                for (size_t i = 0; i < kTelemetryFields; ++i) {
+                    if (mask & (1u << i)) w.put_signed(v[i] - prev[i]);
+                }
+                if (mask & 0x80) w.put(bits);
+            }
+            ++samples;
+        }
+        append(out, w);
+        if (rng() % 8 == 0) {
+            w.begin(kTelemetryMidi, seq++);
+            w.put_varint(t);
+            w.put(0x90);
+            w.put_varint(320);
+            w.put(60);
+            w.put_varint(320);
+            w.put(100);
+            append(out, w);
+        }
+        if (rng() % 512 == 0) {
+            std::string text = "ok test=" + std::to_string(kTestTelemetry) + "\n";
+            out.insert(out.end(), text.begin(), text.end());
+        }
+    }
+    return out;
+}
+
+// Returns seconds spent decoding. Both passes checksum what they decode,
+// so the recorder can be checked against the plain decode.
+template <class Sink>
+double run_bench(const std::vector<uint8_t>& stream, Sink& sink, TelemetryDecoder& decoder) {
+    static StreamBuffer<kTelemetryFrameMax> buffer;
+    auto t0 = std::chrono::steady_clock::now();
+    // Feed it the way reads arrive: in chunks of whatever size.
+    size_t pos = 0;
+    size_t chunk = 4096;
+    while (pos < stream.size()) {
+        size_t n = std::min({chunk, stream.size() - pos, buffer.space_len()});
+        std::memcpy(buffer.space(), stream.data() + pos, n);
+        buffer.filled(n, decoder, sink);
+        pos += n;
+        chunk = chunk == 4096 ? 1000 : 4096;
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(t1 - t0).count();
+}
+
+int cmd_bench(int argc, char** argv) {
+    long mb = 64;
+    for (int i = 0; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--mb") == 0 && i + 1 < argc) {
+            mb = std::atol(argv[++i]);
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (mb <= 0) mb = 64;
+
+    uint64_t expected = 0;
+    std::vector<uint8_t> stream = synthetic_stream(static_cast<size_t>(mb) << 20, expected);
+    double bytes = static_cast<double>(stream.size());
+
+    TelemetryDecoder plain;
+    NullSink null_sink;
+    double s_decode = run_bench(stream, null_sink, plain);
+
+    char path[] = "/tmp/brain-telemetry-bench-XXXXXX";
+    int tmp = mkstemp(path);
+    if (tmp < 0) {
+        std::fprintf(stderr, "brain-telemetry: mkstemp: %s\n", std::strerror(errno));
+        return 1;
+    }
+    close(tmp);
+    std::string name = path;
+    TelemetryDecoder recorded;
+    double s_record;
+    uint64_t check;
+    {
+        ColumnFile samples, midi;
+        if (!create_capture(name, samples, midi)) return 1;
+        RecordSink sink(samples, midi);
+        sink.print_status = false;
+        s_record = run_bench(stream, sink, recorded);
+        sink.commit();
+        check = sink.check;
+    }
+    unlink(path);
+    unlink((name + ".samples").c_str());
+    unlink((name + ".midi").c_str());
+
+    const TelemetryCounters& c = plain.counters();
+    bool ok = c.samples == expected && c.bad_frames == 0 && c.missed_frames == 0 &&
+              check == null_sink.check;
+    for (int stage = 0; stage < 2; ++stage) {
+        double s = stage == 0 ? s_decode : s_record;
+        std::printf("bench stage=%s bytes=%.0f samples=%llu mb_per_s=%.1f msamples_per_s=%.2f "
+                    "usb_fs_ratio=%.0f\n",
+                    stage == 0 ? "decode" : "record", bytes,
+                    static_cast<unsigned long long>(c.samples), bytes / s / 1e6,
+                    static_cast<double>(c.samples) / s / 1e6, bytes / s / kUsbFullSpeedBytesPerS);
+    }
+    std::printf("bench verified=%d\n", ok ? 1 : 0);
+    return ok ? 0 : 1;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        usage();
+        return 2;
+    }
+    std::string cmd = argv[1];
+    if (cmd == "record") return cmd_record(argc - 2, argv + 2);
+    if (cmd == "replay") return cmd_replay(argc - 2, argv + 2);
+    if (cmd == "slice") return cmd_slice(argc - 2, argv + 2);
+    if (cmd == "bench") return cmd_bench(argc - 2, argv + 2);
+    usage();
+    return 2;
+}
@@ -0,0 +1,160 @@
+#include "column_file.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char     kMagic[8]    = {'B', 'R', 'A', 'I', 'N', 'C', 'O', 'L'};
+constexpr uint32_t kVersion     = 1;
+constexpr size_t   kRowsOffset  = 24;
+constexpr size_t   kWidthsOffset = 32;
+
+struct HeaderFields {
+    char     magic[8];
+    uint32_t version;
+    uint32_t columns;
+    uint64_t segment_rows;
+    uint64_t rows;
+};
+static_assert(sizeof(HeaderFields) == kWidthsOffset, "header layout");
+
+}  // namespace
+
+ColumnFile::~ColumnFile() {
+    close();
+}
+
+bool ColumnFile::create(const std::string& path, const std::vector<uint8_t>& widths,
+                        std::string& error) {
+    close();
+    if (widths.empty() || widths.size() > kMaxColumns) {
+        error = "bad column count";
+        return false;
+    }
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0 || ftruncate(fd_, kHeaderBytes) != 0) {
+        error = std::strerror(errno);
+        close();
+        return false;
+    }
+    void* h = mmap(nullptr, kHeaderBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (h == MAP_FAILED) {
+        error = std::strerror(errno);
+        close();
+        return false;
+    }
+    header_ = static_cast<uint8_t*>(h);
+    writable_ = true;
+
+    HeaderFields f{};
+    std::memcpy(f.magic, kMagic, sizeof(kMagic));
+    f.version = kVersion;
+    f.columns = static_cast<uint32_t>(widths.size());
+    f.segment_rows = kSegmentRows;
+    f.rows = 0;
+    std::memcpy(header_, &f, sizeof(f));
+    std::memcpy(header_ + kWidthsOffset, widths.data(), widths.size());
+
+    widths_ = widths;
+    offsets_.clear();
+    uint64_t row_bytes = 0;
+    for (uint8_t w : widths_) {
+        offsets_.push_back(row_bytes * kSegmentRows);
+        row_bytes += w;
+    }
+    segment_bytes_ = row_bytes * kSegmentRows;
+    rows_ = 0;
+    return true;
+}
+
+bool ColumnFile::open(const std::string& path, std::string& error) {
+    close();
+    fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0) {
+        error = std::strerror(errno);
+        return false;
+    }
+    void* h = mmap(nullptr, kHeaderBytes, PROT_READ, MAP_SHARED, fd_, 0);
+    if (h == MAP_FAILED) {
+        error = std::strerror(errno);
+        close();
+        return false;
+    }
+    header_ = static_cast<uint8_t*>(h);
+
+    HeaderFields f;
+    std::memcpy(&f, header_, sizeof(f));
+    if (std::memcmp(f.magic, kMagic, sizeof(kMagic)) != 0 || f.version != kVersion ||
+        f.columns == 0 || f.columns > kMaxColumns || f.segment_rows != kSegmentRows) {
+        error = "not a capture file";
+        close();
+        return false;
+    }
+    widths_.assign(header_ + kWidthsOffset, header_ + kWidthsOffset + f.columns);
+    uint64_t row_bytes = 0;
+    for (uint8_t w : widths_) {
+        offsets_.push_back(row_bytes * kSegmentRows);
+        row_bytes += w;
+    }
+    segment_bytes_ = row_bytes * kSegmentRows;
+    rows_ = f.rows;
+    for (size_t i = 0; i * kSegmentRows < rows_; ++i) {
+        if (!map_segment(i, error)) {
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void ColumnFile::close() {
+    if (writable_) commit();
+    for (Segment& s : segments_) munmap(s.base, segment_bytes_);
+    segments_.clear();
+    if (header_ != nullptr) munmap(header_, kHeaderBytes);
+    header_ = nullptr;
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+    writable_ = false;
+    widths_.clear();
+    offsets_.clear();
+    rows_ = 0;
+}
+
+bool ColumnFile::map_segment(size_t index, std::string& error) {
+    off_t offset = static_cast<off_t>(kHeaderBytes + index * segment_bytes_);
+    if (writable_ && ftruncate(fd_, offset + static_cast<off_t>(segment_bytes_)) != 0) {
+        error = std::strerror(errno);
+        return false;
+    }
+    int prot = writable_ ? PROT_READ | PROT_WRITE : PROT_READ;
+    void* base = mmap(nullptr, segment_bytes_, prot, MAP_SHARED, fd_, offset);
+    if (base == MAP_FAILED) {
+        error = std::strerror(errno);
+        return false;
+    }
+    segments_.push_back({static_cast<uint8_t*>(base)});
+    return true;
+}
+
+bool ColumnFile::append(uint64_t& row) {
+    if (!writable_) return false;
+    if (rows_ == segments_.size() * kSegmentRows) {
+        std::string error;
+        if (!map_segment(segments_.size(), error)) return false;
+    }
+    row = rows_++;
+    return true;
+}
+
+void ColumnFile::commit() {
+    if (!writable_) return;
+    // The rows themselves are already in the shared mapping; publishing
+    // the count is what makes them part of the capture.
+    std::memcpy(header_ + kRowsOffset, &rows_, sizeof(rows_));
+}
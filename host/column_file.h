@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Append-only, memory-mapped columnar capture file.
+//
+// Rows are stored in fixed segments of kSegmentRows. Within a segment each
+// column is one contiguous array, so replaying or slicing reads only the
+// columns it needs. The header records the committed row count. A reader
+// never sees a partly written row, and a capture cut short by a crash
+// still opens at its last commit.
+//
+// Layout: a kHeaderBytes header, then segment k at
+// kHeaderBytes + k * kSegmentRows * row_bytes, with column c at
+// kSegmentRows * (sum of the widths before c) inside it. Values are
+// little-endian, as written by the host.
+class ColumnFile {
+public:
+    static constexpr uint64_t kSegmentRows = 65536;
+    static constexpr size_t   kHeaderBytes = 16384;  // a page on every host
+    static constexpr size_t   kMaxColumns  = 32;
+
+    ColumnFile() = default;
+    ~ColumnFile();
+    ColumnFile(const ColumnFile&) = delete;
+    ColumnFile& operator=(const ColumnFile&) = delete;
+
+    // Creates (truncating) a capture with one column per width in bytes.
+    bool create(const std::string& path, const std::vector<uint8_t>& widths, std::string& error);
+    // Opens an existing capture read-only.
+    bool open(const std::string& path, std::string& error);
+    void close();
+
+    uint64_t rows() const { return rows_; }
+    size_t columns() const { return widths_.size(); }
+    uint8_t width(size_t column) const { return widths_[column]; }
+
+    // Writer: room for one more row, returned as its index. Nothing is
+    // visible to readers until commit().
+    bool append(uint64_t& row);
+    void commit();
+
+    // Address of a cell. The row must be below rows() (or appended).
+    void* cell(size_t column, uint64_t row) const {
+        const Segment& s = segments_[row / kSegmentRows];
+        return s.base + offsets_[column] + (row % kSegmentRows) * widths_[column];
+    }
+
+    template <class T>
+    T& at(size_t column, uint64_t row) const {
+        return *static_cast<T*>(cell(column, row));
+    }
+
+private:
+    struct Segment {
+        uint8_t* base;
+    };
+
+    bool map_segment(size_t index, std::string& error);
+
+    int      fd_       = -1;
+    bool     writable_ = false;
+    uint8_t* header_   = nullptr;
+    std::vector<uint8_t>  widths_;
+    std::vector<uint64_t> offsets_;  // column offsets within a segment
+    std::vector<Segment>  segments_;
+    uint64_t segment_bytes_ = 0;
+    uint64_t rows_          = 0;  // appended, committed or not
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <poll.h>
+#include <unistd.h>
+
+#include "usb_frame.h"
+
+// Reading the firmware's framed binary streams, shared by the decoders and
+// the tools that run them. The framing, CRC and frame builder are the
+// firmware's own (usb_frame.h at the top of the repository):
+//
+//   0xA5 <len> <type> <seq> <payload, len - 2 bytes> <crc8>
+//
+// frame_scan() finds the frames in a read buffer and StreamBuffer keeps
+// the buffer, so a decoder only has to parse one frame body.
+
+constexpr size_t kFrameMax = kUsbFrameMax;  // sync, len, 255 bytes, crc
+
+// Hands every complete frame in [data, data + len) to
+// on_frame(const uint8_t* body, const uint8_t* end), body pointing at the
+// type byte, and returns the number of bytes consumed; the rest is the
+// start of a frame, to pass again with the next read. Bytes outside frames
+// are skipped until the next sync byte with a valid CRC. A frame that
+// on_frame() rejects by returning false is counted as bad and the scan
+// resynchronises one byte on, as the sync byte may have been data.
+template <class OnFrame>
+size_t frame_scan(const uint8_t* data, size_t len, uint64_t& bad_frames, uint64_t& other_bytes,
+                  OnFrame&& on_frame) {
+    size_t pos = 0;
+    while (pos < len) {
+        if (data[pos] != kUsbFrameSync) {
+            ++other_bytes;
+            ++pos;
+            continue;
+        }
+        if (len - pos < 2) break;
+        size_t body = data[pos + 1];
+        size_t total = body + 3;
+        if (len - pos < total) break;
+        if (body < 2 || usb_frame_crc8(data + pos + 1, body + 1) != data[pos + total - 1] ||
+            !on_frame(data + pos + 2, data + pos + 2 + body)) {
+            // Not a frame after all; resynchronise one byte on.
+            ++bad_frames;
+            ++other_bytes;
+            ++pos;
+            continue;
+        }
+        pos += total;
+    }
+    return pos;
+}
+
+constexpr size_t kStreamReadBytes = 65536;
+
+// Read buffer that a decoder works on in place. Only the unfinished frame
+// at the end of a read is moved, to the front, before the next one.
+// kMaxFrame is the decoder's longest frame. Large: give it static storage.
+template <size_t kMaxFrame>
+class StreamBuffer {
+public:
+    uint8_t* space() { return data_ + have_; }
+    size_t space_len() const { return sizeof(data_) - have_; }
+
+    // Decodes after n bytes were written to space(). The decoder needs
+    // size_t decode(const uint8_t* data, size_t len, Sink& sink).
+    template <class Decoder, class Sink>
+    void filled(size_t n, Decoder& decoder, Sink& sink) {
+        have_ += n;
+        size_t used = decoder.decode(data_, have_, sink);
+        std::memmove(data_, data_ + used, have_ - used);
+        have_ -= used;
+    }
+
+    // Waits up to 100 ms for `fd` to have data and decodes what it read.
+    // False once the device has closed.
+    template <class Decoder, class Sink>
+    bool read_from(int fd, Decoder& decoder, Sink& sink) {
+        pollfd p{fd, POLLIN, 0};
+        if (poll(&p, 1, 100) <= 0) return true;
+        ssize_t n = read(fd, space(), space_len());
+        if (n > 0) {
+            filled(static_cast<size_t>(n), decoder, sink);
+            return true;
+        }
+        return n < 0 && (errno == EAGAIN || errno == EINTR);
+    }
+
+private:
+    uint8_t data_[kStreamReadBytes + kMaxFrame];
+    size_t  have_ = 0;
+};
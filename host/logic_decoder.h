@@ -0,0 +1,174 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "telemetry_decoder.h"
+
+// Incremental decoder for the binary stream of the firmware's logic
+// analyzer (frame layout in logic_analyzer.h at the top of the
+// repository). Frames are found by frame_scan(), as for TelemetryDecoder.
+//
+// The run-length records are turned back into channel changes at 64-bit
+// sample indices. A transitions frame that doesn't start where the last
+// one ended, because the firmware dropped samples or a frame was lost in
+// between, is reported as a gap of unknown levels.
+
+constexpr uint8_t kLogicTransitions  = 1;
+constexpr uint8_t kLogicStatus       = 2;
+constexpr uint8_t kLogicBurst        = 3;
+constexpr uint8_t kLogicChannels     = 5;  // pulse in, pulse out, Button A, Button B, MIDI RX
+constexpr uint8_t kLogicStateBits    = 5;
+constexpr size_t  kLogicFrameMax     = kFrameMax;
+
+struct LogicStatus {
+    uint32_t rate_hz;
+    uint32_t burst;
+    uint32_t trigger;
+    uint32_t samples;  // mod 2^32
+    uint32_t transitions;
+    uint32_t dropped;
+    uint32_t bursts;
+};
+
+struct LogicCounters {
+    uint64_t frames        = 0;
+    uint64_t transitions   = 0;
+    uint64_t bad_frames    = 0;  // CRC or payload errors
+    uint64_t missed_frames = 0;  // gaps in the sequence number
+    uint64_t gaps          = 0;
+    uint64_t gap_samples   = 0;
+    uint64_t other_bytes   = 0;  // skipped outside frames
+};
+
+class LogicDecoder {
+public:
+    // Decodes every complete frame in [data, data + len) and returns the
+    // number of bytes consumed; pass the rest again with the next read.
+    // The sink needs
+    //   void change(uint64_t index, uint8_t state);  // levels from index on
+    //   void gap(uint64_t from, uint64_t to);        // [from, to) unknown
+    //   void burst(uint32_t number, uint64_t index);
+    //   void status(const LogicStatus&);
+    template <class Sink>
+    size_t decode(const uint8_t* data, size_t len, Sink& sink);
+
+    const LogicCounters& counters() const { return counters_; }
+
+private:
+    // A transitions frame holds at most this many records, one byte or
+    // more each.
+    static constexpr size_t kMaxRecords = kFrameMax;
+
+    template <class Sink>
+    bool frame(const uint8_t* p, const uint8_t* end, Sink& sink);
+
+    void accept(uint8_t seq);
+    uint64_t extend(uint32_t index);
+
+    LogicCounters counters_;
+    bool     have_seq_   = false;
+    uint8_t  next_seq_   = 0;
+    bool     have_index_ = false;
+    uint64_t last_index_ = 0;  // for extending 32-bit indices
+    bool     have_pos_   = false;
+    uint64_t pos_        = 0;  // sample index the stream accounts for up to
+    uint8_t  state_      = 0;
+};
+
+inline void LogicDecoder::accept(uint8_t seq) {
+    if (have_seq_ && seq != next_seq_) {
+        counters_.missed_frames += static_cast<uint8_t>(seq - next_seq_);
+    }
+    have_seq_ = true;
+    next_seq_ = static_cast<uint8_t>(seq + 1);
+    ++counters_.frames;
+}
+
+inline uint64_t LogicDecoder::extend(uint32_t index) {
+    if (!have_index_) {
+        have_index_ = true;
+        last_index_ = index;
+        return last_index_;
+    }
+    int32_t d = static_cast<int32_t>(index - static_cast<uint32_t>(last_index_));
+    last_index_ += d;
+    return last_index_;
+}
+
+template <class Sink>
+size_t LogicDecoder::decode(const uint8_t* data, size_t len, Sink& sink) {
+    return frame_scan(data, len, counters_.bad_frames, counters_.other_bytes,
+                      [&](const uint8_t* p, const uint8_t* end) { return frame(p, end, sink); });
+}
+
+// As in TelemetryDecoder, the payload is parsed in full before any of it
+// is passed on or counted.
+template <class Sink>
+bool LogicDecoder::frame(const uint8_t* p, const uint8_t* end, Sink& sink) {
+    using telemetry_detail::varint;
+
+    uint8_t type = *p++;
+    uint8_t seq = *p++;
+
+    switch (type) {
+        case kLogicTransitions: {
+            uint32_t start;
+            if (!varint(p, end, start) || p >= end) return false;
+            uint8_t state = *p++;
+            uint32_t records[kMaxRecords];
+            size_t n = 0;
+            while (p < end) {
+                if (n == kMaxRecords || !varint(p, end, records[n++])) return false;
+            }
+
+            accept(seq);
+            uint64_t index = extend(start);
+            if (!have_pos_ || index != pos_ || state != state_) {
+                if (have_pos_ && index > pos_) {
+                    sink.gap(pos_, index);
+                    ++counters_.gaps;
+                    counters_.gap_samples += index - pos_;
+                }
+                sink.change(index, state);
+            }
+            have_pos_ = true;
+            state_ = state;
+            for (size_t i = 0; i < n; ++i) {
+                index += records[i] >> kLogicStateBits;
+                auto next = static_cast<uint8_t>(records[i] & ((1u << kLogicStateBits) - 1));
+                if (next != state_) {
+                    sink.change(index, next);
+                    state_ = next;
+                    ++counters_.transitions;
+                }
+            }
+            last_index_ = index;
+            pos_ = index;
+            return true;
+        }
+        case kLogicBurst: {
+            uint32_t number;
+            uint32_t start;
+            if (!varint(p, end, number) || !varint(p, end, start)) return false;
+            accept(seq);
+            sink.burst(number, extend(start));
+            return true;
+        }
+        case kLogicStatus: {
+            LogicStatus st;
+            uint32_t* fields[] = {&st.rate_hz,     &st.burst,   &st.trigger, &st.samples,
+                                  &st.transitions, &st.dropped, &st.bursts};
+            for (uint32_t* f : fields) {
+                if (!varint(p, end, *f)) return false;
+            }
+            accept(seq);
+            sink.status(st);
+            return true;
+        }
+        default:
+            // Unknown types are skipped whole, for forward compatibility.
+            accept(seq);
+            return true;
+    }
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "telemetry_decoder.h"
+
+// Incremental decoder for the binary stream of the firmware's MIDI
+// sniffer (frame layout in midi_sniffer.h at the top of the repository).
+// Frames are found by frame_scan(), as for TelemetryDecoder, and times are
+// extended past the 32-bit wrap in the same way.
+
+constexpr uint8_t kMidiSniffRecords      = 1;
+constexpr uint8_t kMidiSniffStatus       = 2;
+constexpr uint8_t kMidiSniffByte         = 0;
+constexpr uint8_t kMidiSniffByteError    = 1;
+constexpr uint8_t kMidiSniffNoteOn       = 2;
+constexpr uint8_t kMidiSniffNoteOff      = 3;
+constexpr uint8_t kMidiSniffKindBits     = 2;
+constexpr size_t  kMidiSniffFrameMax     = kFrameMax;
+
+// MidiSniffByte::flags, as the firmware's MidiRxEvent::flags.
+constexpr uint8_t kMidiSniffFraming = 1u << 0;
+constexpr uint8_t kMidiSniffParity  = 1u << 1;
+constexpr uint8_t kMidiSniffBreak   = 1u << 2;
+constexpr uint8_t kMidiSniffOverrun = 1u << 3;
+
+struct MidiSniffByte {
+    uint64_t t_us;
+    uint8_t  byte;
+    uint8_t  flags;
+};
+
+struct MidiSniffNote {
+    uint64_t t_us;  // of the byte that completed the message
+    bool     on;
+    uint8_t  note;
+    uint8_t  velocity;
+    uint8_t  channel;
+};
+
+struct MidiSniffStatus {
+    uint32_t bytes;
+    uint32_t framing;
+    uint32_t parity;
+    uint32_t breaks;
+    uint32_t overruns;
+    uint32_t dropped;  // lost in the firmware's receive ring
+    uint32_t note_on;
+    uint32_t note_off;
+    uint32_t high_water;
+};
+
+struct MidiSniffCounters {
+    uint64_t frames        = 0;
+    uint64_t bytes         = 0;
+    uint64_t notes         = 0;
+    uint64_t bad_frames    = 0;  // CRC or payload errors
+    uint64_t missed_frames = 0;  // gaps in the sequence number
+    uint64_t other_bytes   = 0;  // skipped outside frames
+};
+
+class MidiSniffDecoder {
+public:
+    // Decodes every complete frame in [data, data + len) and returns the
+    // number of bytes consumed; pass the rest again with the next read.
+    // The sink needs
+    //   void byte(const MidiSniffByte&);
+    //   void note(const MidiSniffNote&);
+    //   void status(const MidiSniffStatus&);
+    template <class Sink>
+    size_t decode(const uint8_t* data, size_t len, Sink& sink);
+
+    const MidiSniffCounters& counters() const { return counters_; }
+
+private:
+    // A records frame holds at most this many records, one byte or more
+    // each.
+    static constexpr size_t kMaxRecords = kFrameMax;
+
+    // A record parsed but not yet passed on.
+    struct Staged {
+        uint32_t t_us;
+        uint8_t  kind;
+        uint8_t  data[3];  // flags and byte, or note, velocity and channel
+    };
+
+    template <class Sink>
+    bool frame(const uint8_t* p, const uint8_t* end, Sink& sink);
+
+    void accept(uint8_t seq);
+    uint64_t extend(uint32_t t_us);
+
+    MidiSniffCounters counters_;
+    bool     have_seq_  = false;
+    uint8_t  next_seq_  = 0;
+    bool     have_time_ = false;
+    uint64_t last_us_   = 0;
+};
+
+inline void MidiSniffDecoder::accept(uint8_t seq) {
+    if (have_seq_ && seq != next_seq_) {
+        counters_.missed_frames += static_cast<uint8_t>(seq - next_seq_);
+    }
+    have_seq_ = true;
+    next_seq_ = static_cast<uint8_t>(seq + 1);
+    ++counters_.frames;
+}
+
+inline uint64_t MidiSniffDecoder::extend(uint32_t t_us) {
+    if (!have_time_) {
+        have_time_ = true;
+        last_us_ = t_us;
+        return last_us_;
+    }
+    int32_t d = static_cast<int32_t>(t_us - static_cast<uint32_t>(last_us_));
+    last_us_ += d;
+    return last_us_;
+}
+
+template <class Sink>
+size_t MidiSniffDecoder::decode(const uint8_t* data, size_t len, Sink& sink) {
+    return frame_scan(data, len, counters_.bad_frames, counters_.other_bytes,
+                      [&](const uint8_t* p, const uint8_t* end) { return frame(p, end, sink); });
+}
+
+// As in TelemetryDecoder, the payload is parsed in full before any of it
+// is passed on or counted.
+template <class Sink>
+bool MidiSniffDecoder::frame(const uint8_t* p, const uint8_t* end, Sink& sink) {
+    using telemetry_detail::varint;
+
+    uint8_t type = *p++;
+    uint8_t seq = *p++;
+
+    switch (type) {
+        case kMidiSniffRecords: {
+            Staged staged[kMaxRecords];
+            size_t n = 0;
+            uint32_t t;
+            if (!varint(p, end, t)) return false;
+            while (p < end) {
+                uint32_t record;
+                if (n == kMaxRecords || !varint(p, end, record)) return false;
+                t += record >> kMidiSniffKindBits;
+                Staged& r = staged[n++];
+                r.t_us = t;
+                r.kind = record & ((1u << kMidiSniffKindBits) - 1);
+                r.data[0] = 0;
+                if (r.kind == kMidiSniffByte || r.kind == kMidiSniffByteError) {
+                    if (r.kind == kMidiSniffByteError) {
+                        if (p >= end) return false;
+                        r.data[0] = *p++;
+                    }
+                    if (p >= end) return false;
+                    r.data[1] = *p++;
+                } else {
+                    if (end - p < 3) return false;
+                    std::copy(p, p + 3, r.data);
+                    p += 3;
+                }
+            }
+
+            accept(seq);
+            for (size_t i = 0; i < n; ++i) {
+                const Staged& r = staged[i];
+                if (r.kind == kMidiSniffByte || r.kind == kMidiSniffByteError) {
+                    MidiSniffByte b{extend(r.t_us), r.data[1], r.data[0]};
+                    sink.byte(b);
+                    ++counters_.bytes;
+                } else {
+                    MidiSniffNote note{extend(r.t_us), r.kind == kMidiSniffNoteOn, r.data[0],
+                                       r.data[1], r.data[2]};
+                    sink.note(note);
+                    ++counters_.notes;
+                }
+            }
+            return true;
+        }
+        case kMidiSniffStatus: {
+            MidiSniffStatus st;
+            uint32_t* fields[] = {&st.bytes,    &st.framing, &st.parity,
+                                  &st.breaks,   &st.overruns, &st.dropped,
+                                  &st.note_on,  &st.note_off, &st.high_water};
+            for (uint32_t* f : fields) {
+                if (!varint(p, end, *f)) return false;
+            }
+            accept(seq);
+            sink.status(st);
+            return true;
+        }
+        default:
+            // Unknown types are skipped whole, for forward compatibility.
+            accept(seq);
+            return true;
+    }
+}
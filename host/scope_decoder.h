@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "frame_stream.h"
+
+// Incremental decoder for the binary stream of the firmware's scope mode
+// (frame layout in scope.h at the top of the repository).
+//
+// Like TelemetryDecoder, decode() works in place on the caller's read
+// buffer and hands sample blocks to the sink without copying them; only
+// the tail of a frame split across reads has to be kept for the next
+// call. A frame whose header or payload check fails is skipped one byte at
+// a time until the next valid header, and the blocks it cost show up as a
+// gap in the sequence numbers.
+
+constexpr uint8_t kScopeSync0        = 0xA5;
+constexpr uint8_t kScopeSync1        = 0x5C;
+constexpr uint8_t kScopeSamples      = 1;
+constexpr uint8_t kScopeStatus       = 2;
+constexpr size_t  kScopeHeaderBytes  = 11;
+constexpr size_t  kScopePayloadMax   = 4096;  // longer is taken to be noise
+constexpr size_t  kScopeFrameMax     = kScopeHeaderBytes + kScopePayloadMax + 2;
+constexpr size_t  kScopeStatusFields = 5;
+
+struct ScopeBlock {
+    uint32_t       seq;
+    uint8_t        a_slot;  // position of CV A in each pair
+    const uint8_t* data;    // little-endian 12-bit samples, interleaved A/B
+    size_t         pairs;
+
+    uint16_t sample(size_t pair, uint8_t slot) const {
+        const uint8_t* p = data + 4 * pair + 2 * slot;
+        return static_cast<uint16_t>(p[0] | p[1] << 8);
+    }
+    uint16_t a(size_t pair) const { return sample(pair, a_slot); }
+    uint16_t b(size_t pair) const { return sample(pair, a_slot ^ 1); }
+};
+
+struct ScopeStatus {
+    uint32_t rate_hz;  // both inputs together
+    uint32_t clean_s;
+    uint32_t blocks_sent;
+    uint32_t blocks_dropped;
+    uint32_t bytes_per_s;
+};
+
+struct ScopeCounters {
+    uint64_t frames        = 0;
+    uint64_t blocks        = 0;
+    uint64_t pairs         = 0;
+    uint64_t bad_frames    = 0;  // header CRC, sum or length errors
+    uint64_t missed_blocks = 0;  // gaps in the block sequence number
+    uint64_t other_bytes   = 0;  // skipped outside frames
+};
+
+class ScopeDecoder {
+public:
+    // Decodes every complete frame in [data, data + len) and returns the
+    // number of bytes consumed; pass the rest again with the next read.
+    // The sink needs
+    //   void block(const ScopeBlock&);
+    //   void status(const ScopeStatus&);
+    template <class Sink>
+    size_t decode(const uint8_t* data, size_t len, Sink& sink);
+
+    const ScopeCounters& counters() const { return counters_; }
+
+private:
+    ScopeCounters counters_;
+    bool     have_seq_ = false;
+    uint32_t next_seq_ = 0;
+};
+
+namespace scope_detail {
+
+inline uint16_t u16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | p[1] << 8);
+}
+
+inline uint32_t u32(const uint8_t* p) {
+    return u16(p) | static_cast<uint32_t>(u16(p + 2)) << 16;
+}
+
+inline uint16_t sum16(const uint8_t* p, size_t len) {
+    uint16_t sum = 0;
+    for (size_t i = 0; i + 1 < len; i += 2) sum = static_cast<uint16_t>(sum + u16(p + i));
+    return sum;
+}
+
+}  // namespace scope_detail
+
+template <class Sink>
+size_t ScopeDecoder::decode(const uint8_t* data, size_t len, Sink& sink) {
+    using scope_detail::sum16;
+    using scope_detail::u16;
+    using scope_detail::u32;
+
+    size_t pos = 0;
+    while (pos < len) {
+        const uint8_t* p = data + pos;
+        if (p[0] != kScopeSync0) {
+            ++counters_.other_bytes;
+            ++pos;
+            continue;
+        }
+        if (len - pos < kScopeHeaderBytes) break;
+        size_t body = u16(p + 8);
+        bool header_ok = p[1] == kScopeSync1 && body <= kScopePayloadMax &&
+                         usb_frame_crc8(p, kScopeHeaderBytes - 1) == p[kScopeHeaderBytes - 1];
+        if (header_ok && len - pos < kScopeHeaderBytes + body + 2) break;
+        const uint8_t* payload = p + kScopeHeaderBytes;
+        uint8_t type = p[2];
+        bool ok = header_ok && sum16(payload, body) == u16(payload + body) &&
+                  (type != kScopeSamples || body % 4 == 0) &&
+                  (type != kScopeStatus || body >= 4 * kScopeStatusFields);
+        if (!ok) {
+            // Not a frame after all, or text landed inside it; resynchronise
+            // one byte on.
+            if (header_ok) ++counters_.bad_frames;
+            ++counters_.other_bytes;
+            ++pos;
+            continue;
+        }
+        ++counters_.frames;
+        if (type == kScopeSamples) {
+            ScopeBlock b{u32(p + 4), static_cast<uint8_t>(p[3] & 1), payload, body / 4};
+            if (have_seq_ && b.seq != next_seq_) counters_.missed_blocks += b.seq - next_seq_;
+            have_seq_ = true;
+            next_seq_ = b.seq + 1;
+            ++counters_.blocks;
+            counters_.pairs += b.pairs;
+            sink.block(b);
+        } else if (type == kScopeStatus) {
+            ScopeStatus st{u32(payload), u32(payload + 4), u32(payload + 8), u32(payload + 12),
+                           u32(payload + 16)};
+            sink.status(st);
+        }
+        // Unknown types are skipped whole, for forward compatibility.
+        pos += kScopeHeaderBytes + body + 2;
+    }
+    return pos;
+}
@@ -0,0 +1,126 @@
+#include "serial_port.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+
+#include <fcntl.h>
+#include <glob.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+bool serial_make_raw(int fd) {
+    termios tio;
+    if (tcgetattr(fd, &tio) != 0) return false;
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    // CDC-ACM ignores the baud rate, but some drivers refuse B0.
+    cfsetispeed(&tio, B115200);
+    cfsetospeed(&tio, B115200);
+    if (tcsetattr(fd, TCSANOW, &tio) != 0) return false;
+
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+int serial_open(const std::string& path, std::string& error) {
+    int fd = open(path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        error = std::strerror(errno);
+        return -1;
+    }
+    if (!serial_make_raw(fd)) {
+        error = std::strerror(errno);
+        close(fd);
+        return -1;
+    }
+    tcflush(fd, TCIOFLUSH);
+    return fd;
+}
+
+std::vector<std::string> serial_discover() {
+    std::vector<std::string> paths;
+    for (const char* pattern : {"/dev/ttyACM*", "/dev/cu.usbmodem*"}) {
+        glob_t g;
+        if (glob(pattern, 0, nullptr, &g) == 0) {
+            for (size_t i = 0; i < g.gl_pathc; ++i) paths.emplace_back(g.gl_pathv[i]);
+        }
+        globfree(&g);
+    }
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+bool write_all(int fd, const std::string& text) {
+    size_t off = 0;
+    while (off < text.size()) {
+        ssize_t n = write(fd, text.data() + off, text.size() - off);
+        if (n > 0) {
+            off += static_cast<size_t>(n);
+        } else if (n < 0 && errno != EAGAIN && errno != EINTR) {
+            return false;
+        } else {
+            pollfd p{fd, POLLOUT, 0};
+            poll(&p, 1, 100);
+        }
+    }
+    return true;
+}
+
+long long monotonic_ms() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<long long>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+namespace {
+
+volatile std::sig_atomic_t g_stop = 0;
+
+void on_signal(int) {
+    g_stop = 1;
+}
+
+}  // namespace
+
+void stop_on_signals() {
+    std::signal(SIGINT, on_signal);
+    std::signal(SIGTERM, on_signal);
+}
+
+bool stop_requested() {
+    return g_stop != 0;
+}
+
+void LineBuffer::append(const char* data, size_t len) {
+    if (next_ > 0 && next_ == lines_.size()) {
+        lines_.clear();
+        next_ = 0;
+    }
+    for (size_t i = 0; i < len; ++i) {
+        char c = data[i];
+        if (c == '\n') {
+            if (!pending_.empty() && pending_.back() == '\r') pending_.pop_back();
+            lines_.push_back(std::move(pending_));
+            pending_.clear();
+            truncating_ = false;
+        } else if (!truncating_) {
+            if (pending_.size() < max_line_) {
+                pending_.push_back(c);
+            } else {
+                truncating_ = true;
+            }
+        }
+    }
+}
+
+bool LineBuffer::next_line(std::string& line) {
+    if (next_ >= lines_.size()) return false;
+    line = std::move(lines_[next_++]);
+    return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Small POSIX helpers shared by the host tools. Everything here is
+// non-blocking; callers multiplex descriptors with poll().
+
+// Opens a tty (real CDC device or pty slave) in raw, non-blocking mode.
+// Returns -1 and fills `error` on failure.
+int serial_open(const std::string& path, std::string& error);
+
+// Puts an already-open descriptor into raw, non-blocking mode.
+bool serial_make_raw(int fd);
+
+// Lists CDC-ACM devices that could be a Brain (/dev/ttyACM* on Linux,
+// /dev/cu.usbmodem* on macOS), sorted by path.
+std::vector<std::string> serial_discover();
+
+// Writes all of `text`, waiting for room as needed. False on a write
+// error.
+bool write_all(int fd, const std::string& text);
+
+// Monotonic milliseconds, for event-loop deadlines.
+long long monotonic_ms();
+
+// Makes SIGINT and SIGTERM set a flag instead of ending the process, so a
+// tool can leave its loop, put the board back and report.
+void stop_on_signals();
+bool stop_requested();
+
+// Accumulates bytes and hands out complete '\n'-terminated lines with any
+// trailing '\r' stripped. Overlong lines are truncated rather than grown
+// without bound, so a misbehaving device cannot exhaust memory.
+class LineBuffer {
+public:
+    explicit LineBuffer(size_t max_line = 512) : max_line_(max_line) {}
+
+    void append(const char* data, size_t len);
+    bool next_line(std::string& line);
+
+private:
+    std::string pending_;
+    std::vector<std::string> lines_;
+    size_t next_ = 0;
+    size_t max_line_;
+    bool truncating_ = false;
+};
@@ -0,0 +1,225 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "frame_stream.h"
+
+// Incremental decoder for the binary stream of the firmware's telemetry
+// mode (frame layout in telemetry.h at the top of the repository).
+//
+// decode() works in place on the caller's read buffer: frames are parsed
+// where they lie and handed to the sink field by field, and only the tail
+// of a frame split across reads has to be kept for the next call. Bytes
+// outside frames (console text interleaved with the stream, or garbage
+// after a lost byte) are skipped by frame_scan().
+
+constexpr uint8_t kTelemetrySync       = kUsbFrameSync;
+constexpr uint8_t kTelemetrySamples    = 1;
+constexpr uint8_t kTelemetryMidi       = 2;
+constexpr uint8_t kTelemetryStatus     = 3;
+constexpr size_t  kTelemetryFields     = 7;    // pot1-3, cv1-2 mV, out1-2 mV
+constexpr size_t  kTelemetryFrameMax   = kFrameMax;
+
+struct TelemetrySample {
+    uint64_t t_us;  // extended past the firmware's 32-bit wrap
+    int32_t  v[kTelemetryFields];
+    uint8_t  bits;  // 0 = pulse in, 1 = Button B
+};
+
+struct TelemetryMidi {
+    uint64_t t_us;
+    uint8_t  byte;
+};
+
+struct TelemetryStatus {
+    uint32_t rate_hz;
+    uint32_t decimation;
+    uint32_t samples_sent;
+    uint32_t samples_dropped;
+    uint32_t frames_dropped;
+    uint32_t loop_overruns;
+    uint32_t midi_dropped;
+};
+
+struct TelemetryCounters {
+    uint64_t frames       = 0;
+    uint64_t samples      = 0;
+    uint64_t midi_bytes   = 0;
+    uint64_t bad_frames   = 0;  // CRC or payload errors
+    uint64_t missed_frames = 0; // gaps in the sequence number
+    uint64_t other_bytes  = 0;  // skipped outside frames
+};
+
+class TelemetryDecoder {
+public:
+    // Decodes every complete frame in [data, data + len) and returns the
+    // number of bytes consumed. The rest is the start of a frame: pass it
+    // again, followed by newly read bytes. The sink needs
+    //   void sample(const TelemetrySample&);
+    //   void midi(const TelemetryMidi&);
+    //   void status(const TelemetryStatus&);
+    template <class Sink>
+    size_t decode(const uint8_t* data, size_t len, Sink& sink);
+
+    const TelemetryCounters& counters() const { return counters_; }
+
+private:
+    // A frame holds at most this many samples or MIDI bytes: a delta
+    // sample takes two bytes or more, a MIDI byte at least one.
+    static constexpr size_t kMaxRecords = kFrameMax;
+
+    template <class Sink>
+    bool frame(const uint8_t* p, const uint8_t* end, Sink& sink);
+
+    void accept(uint8_t seq);
+    uint64_t extend(uint32_t t_us);
+
+    TelemetryCounters counters_;
+    bool     have_seq_  = false;
+    uint8_t  next_seq_  = 0;
+    bool     have_time_ = false;
+    uint64_t last_us_   = 0;
+};
+
+namespace telemetry_detail {
+
+inline bool varint(const uint8_t*& p, const uint8_t* end, uint32_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 35 && p < end; shift += 7) {
+        uint8_t b = *p++;
+        v |= static_cast<uint32_t>(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+inline bool signed_varint(const uint8_t*& p, const uint8_t* end, int32_t& v) {
+    uint32_t u;
+    if (!varint(p, end, u)) return false;
+    v = static_cast<int32_t>((u >> 1) ^ (~(u & 1) + 1));
+    return true;
+}
+
+}  // namespace telemetry_detail
+
+inline void TelemetryDecoder::accept(uint8_t seq) {
+    if (have_seq_ && seq != next_seq_) {
+        counters_.missed_frames += static_cast<uint8_t>(seq - next_seq_);
+    }
+    have_seq_ = true;
+    next_seq_ = static_cast<uint8_t>(seq + 1);
+    ++counters_.frames;
+}
+
+inline uint64_t TelemetryDecoder::extend(uint32_t t_us) {
+    // Frames are not strictly in time order (MIDI goes out before the
+    // samples frame it overlaps), so step by the signed difference.
+    if (!have_time_) {
+        have_time_ = true;
+        last_us_ = t_us;
+        return last_us_;
+    }
+    int32_t d = static_cast<int32_t>(t_us - static_cast<uint32_t>(last_us_));
+    last_us_ += d;
+    return last_us_;
+}
+
+template <class Sink>
+size_t TelemetryDecoder::decode(const uint8_t* data, size_t len, Sink& sink) {
+    return frame_scan(data, len, counters_.bad_frames, counters_.other_bytes,
+                      [&](const uint8_t* p, const uint8_t* end) { return frame(p, end, sink); });
+}
+
+// The payload is parsed in full before the sink, the counters or the
+// time base see any of it: a frame that fails part way is rescanned as
+// noise by frame_scan(), and must leave nothing behind.
+template <class Sink>
+bool TelemetryDecoder::frame(const uint8_t* p, const uint8_t* end, Sink& sink) {
+    using telemetry_detail::signed_varint;
+    using telemetry_detail::varint;
+
+    uint8_t type = *p++;
+    uint8_t seq = *p++;
+
+    switch (type) {
+        case kTelemetrySamples: {
+            TelemetrySample staged[kMaxRecords];
+            uint32_t times[kMaxRecords];
+            size_t n = 0;
+            TelemetrySample s;
+            uint32_t t;
+            if (!varint(p, end, t)) return false;
+            for (int32_t& v : s.v) {
+                if (!signed_varint(p, end, v)) return false;
+            }
+            if (p >= end) return false;
+            s.bits = *p++;
+            staged[n] = s;
+            times[n++] = t;
+            while (p < end) {
+                uint32_t dt;
+                if (!varint(p, end, dt) || p >= end || n == kMaxRecords) return false;
+                uint8_t mask = *p++;
+                t += dt;
+                for (size_t i = 0; i < kTelemetryFields; ++i) {
+                    if (!(mask & (1u << i))) continue;
+                    int32_t d;
+                    if (!signed_varint(p, end, d)) return false;
+                    s.v[i] += d;
+                }
+                if (mask & 0x80) {
+                    if (p >= end) return false;
+                    s.bits = *p++;
+                }
+                staged[n] = s;
+                times[n++] = t;
+            }
+            accept(seq);
+            for (size_t i = 0; i < n; ++i) {
+                staged[i].t_us = extend(times[i]);
+                sink.sample(staged[i]);
+            }
+            counters_.samples += n;
+            return true;
+        }
+        case kTelemetryMidi: {
+            uint32_t times[kMaxRecords];
+            uint8_t bytes[kMaxRecords];
+            size_t n = 0;
+            uint32_t t;
+            if (!varint(p, end, t)) return false;
+            while (p < end) {
+                uint32_t dt = 0;
+                if (n != 0 && !varint(p, end, dt)) return false;
+                if (p >= end || n == kMaxRecords) return false;
+                t += dt;
+                times[n] = t;
+                bytes[n++] = *p++;
+            }
+            accept(seq);
+            for (size_t i = 0; i < n; ++i) {
+                TelemetryMidi m{extend(times[i]), bytes[i]};
+                sink.midi(m);
+            }
+            counters_.midi_bytes += n;
+            return true;
+        }
+        case kTelemetryStatus: {
+            TelemetryStatus st;
+            uint32_t* fields[] = {&st.rate_hz,         &st.decimation,     &st.samples_sent,
+                                  &st.samples_dropped, &st.frames_dropped, &st.loop_overruns,
+                                  &st.midi_dropped};
+            for (uint32_t* f : fields) {
+                if (!varint(p, end, *f)) return false;
+            }
+            accept(seq);
+            sink.status(st);
+            return true;
+        }
+        default:
+            // Unknown types are skipped whole, for forward compatibility.
+            accept(seq);
+            return true;
+    }
+}
@@ -0,0 +1,386 @@
+// Checks the host decoders (telemetry, scope, logic analyzer and MIDI
+// sniffer) against streams built with the firmware's own frame encoder
+// (usb_frame.h): field values, 32-bit time and index extension, sequence
+// gaps, console text between frames, frames split across reads, and
+// frames with a good CRC but a malformed payload, which must leave no
+// trace in the sink or the counters. Prints every check and exits
+// non-zero if any failed.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "frame_stream.h"
+#include "logic_decoder.h"
+#include "midi_sniff_decoder.h"
+#include "scope_decoder.h"
+#include "telemetry_decoder.h"
+#include "usb_frame.h"
+
+namespace {
+
+int g_failures = 0;
+
+void check(bool ok, const char* what, uint64_t got, uint64_t want) {
+    std::printf("%s %s got=%llu want=%llu\n", ok ? "ok  " : "FAIL", what,
+                static_cast<unsigned long long>(got), static_cast<unsigned long long>(want));
+    if (!ok) ++g_failures;
+}
+
+void check_eq(const char* what, uint64_t got, uint64_t want) {
+    check(got == want, what, got, want);
+}
+
+void append(std::vector<uint8_t>& out, UsbFrame& frame) {
+    size_t n = frame.finish();
+    out.insert(out.end(), frame.data(), frame.data() + n);
+}
+
+void append_text(std::vector<uint8_t>& out, const char* text) {
+    while (*text) out.push_back(static_cast<uint8_t>(*text++));
+}
+
+// Feeds `stream` to the decoder in two reads split at `split`, through the
+// tools' StreamBuffer.
+template <size_t kMaxFrame, class Decoder, class Sink>
+void feed(const std::vector<uint8_t>& stream, size_t split, Decoder& decoder, Sink& sink) {
+    auto buffer = std::make_unique<StreamBuffer<kMaxFrame>>();
+    size_t pos = 0;
+    for (size_t end : {split, stream.size()}) {
+        std::copy(stream.begin() + pos, stream.begin() + end, buffer->space());
+        buffer->filled(end - pos, decoder, sink);
+        pos = end;
+    }
+}
+
+struct TelemetrySink {
+    std::vector<TelemetrySample> samples;
+    std::vector<TelemetryMidi>   midi_bytes;
+    std::vector<TelemetryStatus> statuses;
+
+    void sample(const TelemetrySample& s) { samples.push_back(s); }
+    void midi(const TelemetryMidi& m) { midi_bytes.push_back(m); }
+    void status(const TelemetryStatus& st) { statuses.push_back(st); }
+};
+
+void test_telemetry() {
+    std::vector<uint8_t> stream;
+    UsbFrame w;
+
+    // Two samples, the second a delta frame that crosses the 32-bit wrap.
+    const int32_t v[kTelemetryFields] = {10, -20, 30, 1250, -1250, 0, 5000};
+    w.begin(kTelemetrySamples, 7);
+    w.put_varint(0xFFFFFF00u);
+    for (int32_t x : v) w.put_signed(x);
+    w.put(1);
+    w.put_varint(0x200);
+    w.put(0x80 | 1u << 1);
+    w.put_signed(5);
+    w.put(2);
+    append(stream, w);
+
+    append_text(stream, "console text\n");
+
+    // Good CRC, but the delta's varint runs off the end: dropped whole.
+    w.begin(kTelemetrySamples, 8);
+    w.put_varint(0);
+    for (int32_t x : v) w.put_signed(x);
+    w.put(0);
+    w.put_varint(50);
+    w.put(1);
+    w.put(0x80);
+    append(stream, w);
+
+    w.begin(kTelemetryMidi, 8);
+    w.put_varint(0x100);
+    w.put(0x90);
+    w.put_varint(320);
+    w.put(60);
+    append(stream, w);
+
+    w.begin(kTelemetryStatus, 10);
+    for (uint32_t f = 1; f <= 7; ++f) w.put_varint(f * 1000);
+    append(stream, w);
+
+    TelemetryDecoder decoder;
+    TelemetrySink sink;
+    feed<kTelemetryFrameMax>(stream, 17, decoder, sink);
+
+    const TelemetryCounters& c = decoder.counters();
+    check_eq("telemetry samples", sink.samples.size(), 2);
+    check_eq("telemetry counted samples", c.samples, 2);
+    if (sink.samples.size() == 2) {
+        check_eq("telemetry first time", sink.samples[0].t_us, 0xFFFFFF00u);
+        check_eq("telemetry wrapped time", sink.samples[1].t_us, 0x100000100ull);
+        check_eq("telemetry field", static_cast<uint64_t>(sink.samples[0].v[1] + 100), 80);
+        check_eq("telemetry delta", static_cast<uint64_t>(sink.samples[1].v[1] + 100), 85);
+        check_eq("telemetry bits", sink.samples[1].bits, 2);
+    }
+    check_eq("telemetry midi", sink.midi_bytes.size(), 2);
+    if (sink.midi_bytes.size() == 2) {
+        check_eq("telemetry midi time", sink.midi_bytes[1].t_us, 0x100000100ull + 320);
+        check_eq("telemetry midi byte", sink.midi_bytes[1].byte, 60);
+    }
+    check_eq("telemetry status", sink.statuses.size(), 1);
+    if (!sink.statuses.empty()) {
+        check_eq("telemetry status field", sink.statuses[0].midi_dropped, 7000);
+    }
+    check_eq("telemetry frames", c.frames, 3);
+    check_eq("telemetry bad frames", c.bad_frames, 1);
+    // The malformed frame 8 wasn't taken as received, so the good 8 after
+    // it is in sequence and only 9 is missing.
+    check_eq("telemetry missed frames", c.missed_frames, 1);
+    check(c.other_bytes >= 13, "telemetry other bytes", c.other_bytes, 13);
+}
+
+struct ScopeSink {
+    std::vector<uint32_t> seqs;
+    std::vector<uint16_t> a;
+    std::vector<uint16_t> b;
+    std::vector<ScopeStatus> status_frames;
+
+    void block(const ScopeBlock& blk) {
+        seqs.push_back(blk.seq);
+        for (size_t i = 0; i < blk.pairs; ++i) {
+            a.push_back(blk.a(i));
+            b.push_back(blk.b(i));
+        }
+    }
+    void status(const ScopeStatus& st) { status_frames.push_back(st); }
+};
+
+void put16(std::vector<uint8_t>& out, uint16_t v) {
+    out.push_back(static_cast<uint8_t>(v));
+    out.push_back(static_cast<uint8_t>(v >> 8));
+}
+
+void put32(std::vector<uint8_t>& out, uint32_t v) {
+    put16(out, static_cast<uint16_t>(v));
+    put16(out, static_cast<uint16_t>(v >> 16));
+}
+
+// Scope frames have their own header (scope.h in the firmware).
+void scope_frame(std::vector<uint8_t>& out, uint8_t type, uint8_t info, uint32_t seq,
+                 const std::vector<uint8_t>& payload, bool corrupt_sum = false) {
+    size_t start = out.size();
+    out.push_back(kScopeSync0);
+    out.push_back(kScopeSync1);
+    out.push_back(type);
+    out.push_back(info);
+    put32(out, seq);
+    put16(out, static_cast<uint16_t>(payload.size()));
+    out.push_back(usb_frame_crc8(out.data() + start, kScopeHeaderBytes - 1));
+    out.insert(out.end(), payload.begin(), payload.end());
+    uint16_t sum = scope_detail::sum16(payload.data(), payload.size());
+    put16(out, static_cast<uint16_t>(sum + (corrupt_sum ? 1 : 0)));
+}
+
+void test_scope() {
+    std::vector<uint8_t> pairs;
+    for (uint16_t i = 0; i < 8; ++i) {
+        put16(pairs, static_cast<uint16_t>(100 + i));   // B first: info = 1
+        put16(pairs, static_cast<uint16_t>(2000 + i));
+    }
+    std::vector<uint8_t> status;
+    for (uint32_t f = 1; f <= kScopeStatusFields; ++f) put32(status, f * 11);
+
+    std::vector<uint8_t> stream;
+    scope_frame(stream, kScopeSamples, 1, 41, pairs);
+    append_text(stream, "console text\n");
+    scope_frame(stream, kScopeSamples, 1, 42, pairs, true);
+    scope_frame(stream, kScopeStatus, 0, 0, status);
+    scope_frame(stream, kScopeSamples, 1, 44, pairs);
+
+    ScopeDecoder decoder;
+    ScopeSink sink;
+    feed<kScopeFrameMax>(stream, 30, decoder, sink);
+
+    const ScopeCounters& c = decoder.counters();
+    check_eq("scope blocks", sink.seqs.size(), 2);
+    check_eq("scope pairs", sink.a.size(), 16);
+    if (sink.a.size() == 16) {
+        check_eq("scope a", sink.a[3], 2003);
+        check_eq("scope b", sink.b[3], 103);
+    }
+    check_eq("scope status", sink.status_frames.size(), 1);
+    if (!sink.status_frames.empty()) {
+        check_eq("scope status field", sink.status_frames[0].bytes_per_s, 55);
+    }
+    check_eq("scope bad frames", c.bad_frames, 1);
+    check_eq("scope missed blocks", c.missed_blocks, 2);
+}
+
+struct LogicSink {
+    struct Change {
+        uint64_t index;
+        uint8_t  state;
+    };
+    std::vector<Change> changes;
+    std::vector<std::pair<uint64_t, uint64_t>> gaps;
+    std::vector<uint32_t> bursts;
+    size_t status_frames = 0;
+
+    void change(uint64_t index, uint8_t state) { changes.push_back({index, state}); }
+    void gap(uint64_t from, uint64_t to) { gaps.push_back({from, to}); }
+    void burst(uint32_t number, uint64_t) { bursts.push_back(number); }
+    void status(const LogicStatus&) { ++status_frames; }
+};
+
+uint32_t logic_record(uint32_t run, uint8_t state) {
+    return run << kLogicStateBits | state;
+}
+
+void test_logic() {
+    std::vector<uint8_t> stream;
+    UsbFrame w;
+
+    // 0xFFFFFFF0: channel 0 high 10 samples on, low 20 after that, then
+    // 6 more samples unchanged; the frame ends at index 2^32 + 20.
+    w.begin(kLogicTransitions, 0);
+    w.put_varint(0xFFFFFFF0u);
+    w.put(0);
+    w.put_varint(logic_record(10, 1));
+    w.put_varint(logic_record(20, 0));
+    w.put_varint(logic_record(6, 0));
+    append(stream, w);
+
+    // Good CRC, but the last record is cut short: dropped whole.
+    w.begin(kLogicTransitions, 1);
+    w.put_varint(20);
+    w.put(0);
+    w.put_varint(logic_record(3, 2));
+    w.put(0x81);
+    append(stream, w);
+
+    // Picks up 100 samples later than the first frame ended.
+    w.begin(kLogicTransitions, 1);
+    w.put_varint(120);
+    w.put(4);
+    w.put_varint(logic_record(5, 4));
+    append(stream, w);
+
+    w.begin(kLogicBurst, 2);
+    w.put_varint(3);
+    w.put_varint(200);
+    append(stream, w);
+
+    w.begin(kLogicStatus, 3);
+    for (uint32_t f = 1; f <= 7; ++f) w.put_varint(f);
+    append(stream, w);
+
+    LogicDecoder decoder;
+    LogicSink sink;
+    feed<kLogicFrameMax>(stream, 9, decoder, sink);
+
+    const LogicCounters& c = decoder.counters();
+    check_eq("logic changes", sink.changes.size(), 4);
+    if (sink.changes.size() == 4) {
+        check_eq("logic first index", sink.changes[0].index, 0xFFFFFFF0u);
+        check_eq("logic rise", sink.changes[1].index, 0xFFFFFFFAu);
+        check_eq("logic wrapped fall", sink.changes[2].index, 0x10000000Eull);
+        check_eq("logic resumed index", sink.changes[3].index, 0x100000078ull);
+        check_eq("logic resumed state", sink.changes[3].state, 4);
+    }
+    check_eq("logic gaps", sink.gaps.size(), 1);
+    if (!sink.gaps.empty()) {
+        check_eq("logic gap from", sink.gaps[0].first, 0x100000014ull);
+        check_eq("logic gap to", sink.gaps[0].second, 0x100000078ull);
+    }
+    check_eq("logic bursts", sink.bursts.size(), 1);
+    check_eq("logic status", sink.status_frames, 1);
+    check_eq("logic transitions", c.transitions, 2);
+    check_eq("logic frames", c.frames, 4);
+    check_eq("logic bad frames", c.bad_frames, 1);
+    check_eq("logic missed frames", c.missed_frames, 0);
+}
+
+struct MidiSniffSink {
+    std::vector<MidiSniffByte> bytes;
+    std::vector<MidiSniffNote> notes;
+    size_t status_frames = 0;
+
+    void byte(const MidiSniffByte& b) { bytes.push_back(b); }
+    void note(const MidiSniffNote& n) { notes.push_back(n); }
+    void status(const MidiSniffStatus&) { ++status_frames; }
+};
+
+uint32_t midi_record(uint32_t dt, uint8_t kind) {
+    return dt << kMidiSniffKindBits | kind;
+}
+
+void test_midi_sniff() {
+    std::vector<uint8_t> stream;
+    UsbFrame w;
+
+    w.begin(kMidiSniffRecords, 200);
+    w.put_varint(1000);
+    w.put_varint(midi_record(0, kMidiSniffByte));
+    w.put(0x90);
+    w.put_varint(midi_record(320, kMidiSniffByte));
+    w.put(60);
+    w.put_varint(midi_record(320, kMidiSniffByte));
+    w.put(100);
+    w.put_varint(midi_record(0, kMidiSniffNoteOn));
+    w.put(60);
+    w.put(100);
+    w.put(0);
+    w.put_varint(midi_record(50, kMidiSniffByteError));
+    w.put(kMidiSniffFraming);
+    w.put(0x00);
+    append(stream, w);
+
+    // Good CRC, but the note record is two bytes short: dropped whole.
+    w.begin(kMidiSniffRecords, 201);
+    w.put_varint(5000);
+    w.put_varint(midi_record(0, kMidiSniffByte));
+    w.put(0x80);
+    w.put_varint(midi_record(0, kMidiSniffNoteOff));
+    w.put(60);
+    append(stream, w);
+
+    append_text(stream, "console text\n");
+
+    w.begin(kMidiSniffStatus, 201);
+    for (uint32_t f = 1; f <= 9; ++f) w.put_varint(f);
+    append(stream, w);
+
+    MidiSniffDecoder decoder;
+    MidiSniffSink sink;
+    feed<kMidiSniffFrameMax>(stream, 12, decoder, sink);
+
+    const MidiSniffCounters& c = decoder.counters();
+    check_eq("midi bytes", sink.bytes.size(), 4);
+    if (sink.bytes.size() == 4) {
+        check_eq("midi byte time", sink.bytes[2].t_us, 1640);
+        check_eq("midi error flags", sink.bytes[3].flags, kMidiSniffFraming);
+        check_eq("midi error time", sink.bytes[3].t_us, 1690);
+    }
+    check_eq("midi notes", sink.notes.size(), 1);
+    if (!sink.notes.empty()) {
+        check_eq("midi note on", sink.notes[0].on, 1);
+        check_eq("midi note", sink.notes[0].note, 60);
+        check_eq("midi velocity", sink.notes[0].velocity, 100);
+    }
+    check_eq("midi status", sink.status_frames, 1);
+    check_eq("midi frames", c.frames, 2);
+    check_eq("midi bad frames", c.bad_frames, 1);
+    check_eq("midi missed frames", c.missed_frames, 0);
+}
+
+}  // namespace
+
+int main() {
+    test_telemetry();
+    test_scope();
+    test_logic();
+    test_midi_sniff();
+    if (g_failures != 0) {
+        std::printf("%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    std::printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,252 @@
+// Checks the lock-in amplifier's detector (tone_detect.h in the firmware)
+// and its per-block loop (lockin_demod.h) against synthetic captures: a
+// sine drive seen through a delay, ADC quantisation and Gaussian noise,
+// captured as interleaved CV A/B blocks with some of them dropped. Prints
+// every check and exits non-zero if any failed.
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "adc_capture.h"
+#include "lockin_demod.h"
+#include "tone_detect.h"
+
+namespace {
+
+constexpr double   kPi          = 3.14159265358979323846;
+constexpr double   kCaptureHz   = 200000.0;  // both inputs, as in lockin.cpp
+constexpr uint32_t kInputs      = 2;
+constexpr double   kRateHz      = kCaptureHz / kInputs;
+constexpr uint32_t kFrames      = kAdcBlockSamples / kInputs;
+constexpr double   kFreqHz      = 195.3125;  // lockin.h's default
+constexpr double   kFloorRatio  = 4.0 / 3.0;
+constexpr int32_t  kMidScale    = LockInDemod::kAdcMidScale;
+
+int g_failures = 0;
+
+void check(bool ok, const char* what, double got, double want, double tolerance) {
+    std::printf("%s %s got=%.4f want=%.4f tolerance=%.4f\n", ok ? "ok  " : "FAIL", what, got,
+                want, tolerance);
+    if (!ok) ++g_failures;
+}
+
+void check_near(const char* what, double got, double want, double tolerance) {
+    check(std::fabs(got - want) <= tolerance, what, got, want, tolerance);
+}
+
+void check_below(const char* what, double got, double limit) {
+    check(got <= limit, what, got, 0.0, limit);
+}
+
+// Difference of two angles in degrees, wrapped to (-180, 180].
+double angle_diff(double a, double b) {
+    double d = std::fmod(a - b, 360.0);
+    if (d > 180.0) d -= 360.0;
+    if (d <= -180.0) d += 360.0;
+    return d;
+}
+
+struct Capture {
+    double   amplitude  = 1.0;   // peak, ADC counts, on CV A only
+    double   lag_deg    = 0.0;   // of CV A behind the drive
+    double   noise_rms  = 0.0;   // counts, on both inputs
+    double   start_s    = 0.0;   // capture start after the drive started
+    uint32_t blocks     = 400;
+    uint32_t drop_every = 0;     // every Nth block is lost, 0 = none
+    bool     realign    = true;  // number blocks by capture time, not arrival
+    uint32_t settle     = 0;     // samples per input
+    uint32_t target     = ~0u;   // samples per integration
+    uint32_t seed       = 1;
+};
+
+struct Detected {
+    double   amplitude[2];
+    double   phase_deg[2];
+    double   floor[2];
+    uint32_t samples;
+    uint32_t latches = 0;
+    uint32_t latched_samples = 0;  // of the last latch
+};
+
+void read_out(Detected& d, const ToneDetector* tone, const ToneDetector* floor) {
+    for (uint32_t ch = 0; ch < 2; ++ch) {
+        d.amplitude[ch] = tone[ch].amplitude();
+        d.phase_deg[ch] = tone[ch].phase_deg();
+        d.floor[ch] = floor[ch].amplitude();
+    }
+    d.samples = tone[0].samples();
+}
+
+// Builds each capture block, drops some, and runs the rest through
+// LockInDemod as lockin_service() does. Without a latch the detectors'
+// state at the end is returned.
+Detected run(const Capture& c) {
+    std::mt19937 rng(c.seed);
+    std::normal_distribution<double> noise(0.0, c.noise_rms > 0.0 ? c.noise_rms : 1.0);
+
+    uint32_t phase0[2];
+    for (uint32_t ch = 0; ch < 2; ++ch) {
+        // CV A is converted first in each pair, CV B one capture period on.
+        phase0[ch] = tone_sine_phase(kFreqHz, c.start_s + ch / kCaptureHz);
+    }
+    const uint8_t slot[2] = {0, 1};
+    LockInDemod demod;
+    demod.reset(tone_phase_step(kFreqHz, kRateHz), tone_phase_step(kFreqHz * kFloorRatio, kRateHz),
+                phase0, slot, c.settle, c.target);
+
+    Detected d;
+    std::vector<uint16_t> block(kAdcBlockSamples);
+    uint32_t arrived = 0;
+    for (uint32_t seq = 0; seq < c.blocks; ++seq) {
+        bool lost = c.drop_every != 0 && seq % c.drop_every == c.drop_every / 2;
+        // A burst of lost blocks as well, as when USB or the CPU stalls.
+        if (c.drop_every != 0 && seq >= c.blocks / 2 && seq < c.blocks / 2 + 5) lost = true;
+        if (lost) continue;
+        uint32_t first = seq * kFrames;
+        for (uint32_t f = 0; f < kFrames; ++f) {
+            for (uint32_t ch = 0; ch < 2; ++ch) {
+                double t = c.start_s + (first + f) / kRateHz + ch / kCaptureHz;
+                double v = 0.0;
+                if (ch == 0) {
+                    double lag = c.lag_deg * kPi / 180.0;
+                    v = c.amplitude * std::sin(2.0 * kPi * kFreqHz * t - lag);
+                }
+                if (c.noise_rms > 0.0) v += noise(rng);
+                long code = std::lround(kMidScale + v);
+                block[f * kInputs + slot[ch]] =
+                    static_cast<uint16_t>(code < 0 ? 0 : code > 4095 ? 4095 : code);
+            }
+        }
+        demod.block(block.data(), c.realign ? seq : arrived, kFrames, kInputs,
+                    [&](const ToneDetector* tone, const ToneDetector* floor) {
+                        read_out(d, tone, floor);
+                        ++d.latches;
+                        d.latched_samples = d.samples;
+                    });
+        ++arrived;
+    }
+
+    if (d.latches == 0) {
+        const ToneDetector tone[2] = {demod.tone(0), demod.tone(1)};
+        const ToneDetector floor[2] = {demod.floor(0), demod.floor(1)};
+        read_out(d, tone, floor);
+    }
+    return d;
+}
+
+// A tone well above the LSB, at several delays, with dropped blocks and a
+// capture that starts part way into a period: amplitude and phase come
+// out to quantisation accuracy.
+void test_large_tone() {
+    for (double lag : {-150.0, -30.0, 0.0, 45.0, 100.0, 179.0}) {
+        Capture c;
+        c.amplitude = 500.0;
+        c.lag_deg = lag;
+        c.noise_rms = 0.5;
+        c.start_s = 0.00037;
+        c.drop_every = 7;
+        Detected d = run(c);
+        char what[64];
+        std::snprintf(what, sizeof(what), "large amplitude lag=%.0f", lag);
+        check_near(what, d.amplitude[0], c.amplitude, 0.005 * c.amplitude);
+        std::snprintf(what, sizeof(what), "large phase lag=%.0f", lag);
+        check_near(what, angle_diff(d.phase_deg[0], -lag), 0.0, 0.5);
+        check_below("large idle input", d.amplitude[1], 0.05);
+    }
+}
+
+// A 0.3-count tone in 2 counts RMS of noise: far below an LSB and the
+// noise, still found with its phase. The noise in the amplitude is about
+// rms * sqrt(2 / samples), under 0.01 counts here; the tolerances are 5 sigma.
+void test_sub_lsb_tone() {
+    for (uint32_t seed = 1; seed <= 4; ++seed) {
+        Capture c;
+        c.amplitude = 0.3;
+        c.lag_deg = 30.0;
+        c.noise_rms = 2.0;
+        c.start_s = 0.00021;
+        c.blocks = 800;
+        c.drop_every = 7;
+        c.seed = seed;
+        Detected d = run(c);
+        double sigma = c.noise_rms * std::sqrt(2.0 / d.samples);
+        check_near("sub-lsb amplitude", d.amplitude[0], c.amplitude, 5 * sigma);
+        check_near("sub-lsb phase", angle_diff(d.phase_deg[0], -c.lag_deg), 0.0,
+                   5 * sigma / c.amplitude * 180.0 / kPi);
+        check_below("sub-lsb floor", d.floor[0], 5 * sigma);
+        check_below("sub-lsb idle input", d.amplitude[1], 5 * sigma);
+    }
+}
+
+// Numbered by arrival instead of capture time, a dropped block shifts the
+// reference by the block's length, half a period at this frequency, so
+// the sums cancel: this is what the per-block realignment is for.
+void test_drops_need_realignment() {
+    Capture c;
+    c.amplitude = 500.0;
+    c.lag_deg = 45.0;
+    c.noise_rms = 0.5;
+    c.drop_every = 7;
+    c.realign = false;
+    Detected d = run(c);
+    check_below("unaligned amplitude collapses", d.amplitude[0], 0.8 * c.amplitude);
+}
+
+// Blocks inside the settle time are skipped and each latch covers exactly
+// the target number of samples, dropped blocks or not.
+void test_settle_and_latch() {
+    Capture c;
+    c.amplitude = 500.0;
+    c.lag_deg = 60.0;
+    c.noise_rms = 0.5;
+    c.blocks = 200;
+    c.drop_every = 9;
+    c.settle = 10 * kFrames;
+    // 32 reference periods per latch.
+    c.target = static_cast<uint32_t>(std::lround(32 * kRateHz / kFreqHz));
+    Detected d = run(c);
+    uint32_t arrived = 0;
+    for (uint32_t seq = 10; seq < c.blocks; ++seq) {
+        bool lost = seq % c.drop_every == c.drop_every / 2 ||
+                    (seq >= c.blocks / 2 && seq < c.blocks / 2 + 5);
+        if (!lost) ++arrived;
+    }
+    check_near("latch count", d.latches, arrived * kFrames / c.target, 0.0);
+    check_near("latched samples", d.latched_samples, c.target, 0.0);
+    check_near("latched amplitude", d.amplitude[0], c.amplitude, 0.005 * c.amplitude);
+    check_near("latched phase", angle_diff(d.phase_deg[0], -c.lag_deg), 0.0, 0.5);
+}
+
+// A strong tone at the floor detector's frequency doesn't leak into the
+// reference bin over whole periods of both.
+void test_off_frequency_rejection() {
+    ToneDetector tone;
+    uint32_t step = tone_phase_step(kFreqHz, kRateHz);
+    tone.reset(step);
+    uint32_t n = static_cast<uint32_t>(std::lround(3 * 16 * kRateHz / kFreqHz));
+    for (uint32_t i = 0; i < n; ++i) {
+        double t = i / kRateHz;
+        tone.push(static_cast<int32_t>(
+            std::lround(1000.0 * std::sin(2.0 * kPi * kFreqHz * kFloorRatio * t))));
+    }
+    check_below("off-frequency leakage", tone.amplitude(), 0.1);
+}
+
+}  // namespace
+
+int main() {
+    test_large_tone();
+    test_sub_lsb_tone();
+    test_drops_need_realignment();
+    test_settle_and_latch();
+    test_off_frequency_rejection();
+    if (g_failures != 0) {
+        std::printf("%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    std::printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "pico/platform.h"
+
+// Real-time paths (main loop body, run_test() dispatch, per-test handlers)
+// are placed in SRAM so XIP cache misses don't add jitter. The
+// BRAIN_DIAG_RAM_HOT_PATHS CMake option turns this off to get a plain XIP
+// build for comparison; a copy_to_ram build runs everything from SRAM
+// regardless.
+#if BRAIN_DIAG_RAM_HOT_PATHS
+#define DIAG_HOT_FUNC(name) __not_in_flash_func(name)
+#else
+#define DIAG_HOT_FUNC(name) name
+#endif
@@ -0,0 +1,224 @@
+#include "lockin.h"
+
+#include <cmath>
+#include <cstdio>
+
+#include "hardware/clocks.h"
+
+#include "adc_capture.h"
+#include "brain_pins.h"
+#include "cycle_counter.h"
+#include "dac_fast.h"
+#include "dac_stream.h"
+#include "hot_path.h"
+#include "lockin_demod.h"
+#include "pulse_pwm.h"
+#include "settings.h"
+
+namespace {
+
+constexpr uint32_t kCaptureRateHz   = 200000;  // both inputs together
+constexpr size_t   kMaxWords        = 64;      // DAC updates per period
+constexpr double   kMinWordRateHz   = 4000.0;  // above the DMA timer floor
+constexpr double   kMaxWordRateHz   = 200000.0;
+constexpr double   kFloorRatio      = 4.0 / 3.0;
+constexpr double   kUvPerCount      = 10000000.0 / 4096.0;  // ±5 V nominal
+constexpr double   kPi              = 3.14159265358979323846;
+
+LockInConfig g_config;
+bool         g_active    = false;
+double       g_freq_hz   = 0.0;
+uint32_t     g_ref_cycles = 0;
+double       g_zoh_gain  = 1.0;
+double       g_zoh_deg   = 0.0;
+LockInDemod  g_demod;
+LockInResult g_result[2];
+uint16_t     g_words[kDacStreamMaxWords];
+
+// Power-of-two table length that keeps the DAC word rate inside what the
+// DMA timer and the PIO writer can do.
+size_t words_for(double freq_hz) {
+    size_t words = kMaxWords;
+    while (words > 2 && words * freq_hz > kMaxWordRateHz) words /= 2;
+    while (words < kDacStreamMaxWords && words * freq_hz < kMinWordRateHz) words *= 2;
+    return words;
+}
+
+bool start_cv_reference(uint8_t channel) {
+    // The idle output is set while the SPI still owns the DAC; the stream
+    // only carries words for the driven channel.
+    dac_fast_set_millivolts(channel ^ 1, 0, kDacFastPiecewise);
+    size_t words = words_for(g_config.freq_hz);
+    for (size_t i = 0; i < words; ++i) {
+        double s = std::sin(2.0 * kPi * i / words);
+        g_words[i] = dac_fast_word(channel,
+                                   static_cast<int32_t>(std::lround(g_config.amplitude_mv * s)),
+                                   kDacFastPiecewise);
+    }
+    auto rate = static_cast<uint32_t>(std::lround(g_config.freq_hz * words));
+    if (!dac_stream_start(g_words, words, rate)) return false;
+    g_freq_hz = static_cast<double>(dac_stream_rate_hz()) / words;
+    g_ref_cycles = dac_stream_start_cycles();
+    // Zero-order hold of the DAC staircase: sinc(pi f / rate) in
+    // amplitude, half an update in delay.
+    double x = kPi / words;
+    g_zoh_gain = std::sin(x) / x;
+    g_zoh_deg = 180.0 / words;
+    return true;
+}
+
+// Square wave on pulse out, high for the first half period so its
+// fundamental lines up with a CV reference sine.
+bool start_pulse_reference() {
+    if (!pulse_pwm_start(g_config.freq_hz)) return false;
+    g_freq_hz = pulse_pwm_freq_hz();
+    g_zoh_gain = 1.0;
+    g_zoh_deg = 0.0;
+    g_ref_cycles = pulse_pwm_start_cycles();
+    return true;
+}
+
+// Reference phase, in 2^32 units per cycle, at the first sample of a
+// channel. The drive is sin(2 pi f (t - t_ref)).
+uint32_t initial_phase(uint8_t slot) {
+    double rate = adc_capture_rate_hz();
+    // The capture starts a few hundred microseconds after the reference,
+    // well inside the cycle counter's range.
+    uint32_t dt = cycle_counter_elapsed(g_ref_cycles, adc_capture_start_cycles());
+    double dt_s = static_cast<double>(dt) / clock_get_hz(clk_sys);
+    return tone_sine_phase(g_freq_hz, dt_s + slot / rate);
+}
+
+void latch_results(const ToneDetector* tone, const ToneDetector* floor) {
+    for (uint8_t ch = 0; ch < 2; ++ch) {
+        g_result[ch].amplitude_uv = tone[ch].amplitude() * kUvPerCount / g_zoh_gain;
+        double phase = tone[ch].phase_deg() + g_zoh_deg;
+        g_result[ch].phase_deg = phase > 180.0 ? phase - 360.0 : phase;
+        g_result[ch].floor_uv = floor[ch].amplitude() * kUvPerCount;
+        g_result[ch].samples = tone[ch].samples();
+    }
+}
+
+// lockin_run() state.
+bool g_run_started = false;
+bool g_run_failed  = false;
+
+constexpr const char* kInputNames[2] = {"a", "b"};
+
+}  // namespace
+
+bool lockin_start(Brain& brain, const LockInConfig& config) {
+    lockin_stop();
+    g_config = config;
+
+    bool cv = config.reference != kLockInPulseOut;
+    // Building the fast DAC fit uses the SDK path, so it must happen before
+    // the stream takes the DAC pins.
+    if (cv && !dac_fast_prepare(brain, kDacFastPiecewise)) return false;
+    bool ok = cv ? start_cv_reference(config.reference == kLockInCvOutA ? 0 : 1)
+                 : start_pulse_reference();
+    if (!ok) return false;
+    g_active = true;
+
+    uint8_t mask = static_cast<uint8_t>((1u << kCvInAAdcInput) | (1u << kCvInBAdcInput));
+    if (!adc_capture_start(mask, kCaptureRateHz)) {
+        lockin_stop();
+        return false;
+    }
+    adc_capture_set_exclusive(true);
+    uint8_t slot[2] = {adc_capture_slot(kCvInAAdcInput), adc_capture_slot(kCvInBAdcInput)};
+
+    double rate = static_cast<double>(adc_capture_rate_hz()) / adc_capture_inputs();
+    uint32_t phase0[2];
+    for (uint8_t ch = 0; ch < 2; ++ch) {
+        phase0[ch] = initial_phase(slot[ch]);
+        g_result[ch] = LockInResult{};
+    }
+    auto settle = static_cast<uint32_t>(rate * config.settle_ms / 1000);
+
+    // Whole reference periods, so DC and harmonics don't leak in.
+    double periods = std::round(g_freq_hz * config.integration_ms / 1000.0);
+    if (periods < 1.0) periods = 1.0;
+    auto target = static_cast<uint32_t>(std::lround(periods * rate / g_freq_hz));
+    g_demod.reset(tone_phase_step(g_freq_hz, rate), tone_phase_step(g_freq_hz * kFloorRatio, rate),
+                  phase0, slot, settle, target);
+    return true;
+}
+
+void lockin_stop() {
+    if (!g_active) return;
+    g_active = false;
+    adc_capture_stop();
+    if (g_config.reference == kLockInPulseOut) {
+        pulse_pwm_stop();
+    } else {
+        dac_stream_stop();
+        dac_fast_set_millivolts(0, 0, kDacFastPiecewise);
+        dac_fast_set_millivolts(1, 0, kDacFastPiecewise);
+    }
+}
+
+bool lockin_active() {
+    return g_active;
+}
+
+bool DIAG_HOT_FUNC(lockin_service)() {
+    if (!g_active) return false;
+    bool completed = false;
+    uint32_t seq = 0;
+    const uint16_t* block;
+    uint8_t stride = adc_capture_inputs();
+    uint32_t frames = kAdcBlockSamples / stride;
+    while ((block = adc_capture_acquire(seq)) != nullptr) {
+        if (g_demod.block(block, seq, frames, stride, latch_results)) completed = true;
+        adc_capture_release();
+    }
+    dac_stream_service();
+    return completed;
+}
+
+const LockInResult& lockin_result(uint8_t input) {
+    return g_result[input];
+}
+
+double lockin_freq_hz() {
+    return g_freq_hz;
+}
+
+const char* lockin_reference_name(LockInReference reference) {
+    switch (reference) {
+        case kLockInCvOutA:   return "cv_a";
+        case kLockInCvOutB:   return "cv_b";
+        case kLockInPulseOut: return "pulse";
+    }
+    return "?";
+}
+
+void lockin_enter(Brain& /*brain*/) {
+    g_run_started = false;
+    g_run_failed = false;
+}
+
+void lockin_run(Brain& brain, uint32_t /*now_ms*/) {
+    if (g_run_failed) return;
+    if (!g_run_started) {
+        g_run_started = true;
+        LockInConfig config;
+        config.reference = static_cast<LockInReference>(setting(kSettingLockInRef));
+        config.amplitude_mv = setting(kSettingLockInMv);
+        config.integration_ms = static_cast<uint32_t>(setting(kSettingLockInMs));
+        if (!lockin_start(brain, config)) {
+            g_run_failed = true;
+            printf("lockin error=start-failed\n");
+            return;
+        }
+    }
+    if (!lockin_service()) return;
+    for (uint8_t ch = 0; ch < 2; ++ch) {
+        const LockInResult& r = g_result[ch];
+        printf("lockin ref=%s input=%s freq_hz=%.4f amp_uv=%.2f phase_deg=%.1f floor_uv=%.2f "
+               "samples=%lu\n",
+               lockin_reference_name(g_config.reference), kInputNames[ch], g_freq_hz,
+               r.amplitude_uv, r.phase_deg, r.floor_uv, static_cast<unsigned long>(r.samples));
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+
+#include "tests.h"
+
+// Lock-in amplifier for signals below an ADC LSB.
+//
+// A reference sine is streamed to a CV output (dac_stream.h), or a square
+// wave is put on pulse out by a PWM slice, and both CV inputs are captured
+// at 100 kHz each and demodulated in phase and in quadrature against that
+// same reference (tone_detect.h). Integrating over N samples narrows the
+// detection bandwidth to about rate / N, so noise falls with the square
+// root of the integration time while the coherent signal does not.
+//
+// The reference phase is tied to the drive: DAC and ADC start times are
+// recorded, and each captured block carries its sample index, so dropped
+// blocks only cost signal, never coherence. A CV reference is a staircase
+// of DAC updates; its sinc droop and half-update delay are divided out of
+// the results, so they describe the analog path alone. A second detector at 4/3 the
+// reference frequency, integrated the same way, gives the noise floor.
+//
+// Measuring takes the ADC exclusively; Brain::update() is skipped until
+// lockin_stop() (see adc_capture.h).
+
+enum LockInReference : uint8_t {
+    kLockInCvOutA = 0,
+    kLockInCvOutB,
+    kLockInPulseOut,
+};
+
+struct LockInConfig {
+    LockInReference reference      = kLockInCvOutA;
+    int32_t         amplitude_mv   = 1000;       // peak, CV references only
+    double          freq_hz        = 195.3125;   // a 100 kHz / 512 period
+    uint32_t        integration_ms = 1000;
+    uint32_t        settle_ms      = 100;        // discarded after start
+};
+
+struct LockInResult {
+    double   amplitude_uv;  // peak, nominal ±5 V input scaling
+    double   phase_deg;     // relative to the drive, -180..180
+    double   floor_uv;
+    uint32_t samples;
+};
+
+// Starts the reference and the capture. CV references need the fast DAC
+// fit and build it on first use (blocking, see dac_fast.h); the other CV
+// output is held at 0 V. Returns false if the fit or the DMA/PIO/PWM
+// resources are unavailable.
+bool lockin_start(Brain& brain, const LockInConfig& config);
+void lockin_stop();
+bool lockin_active();
+
+// Consumes captured blocks. Returns true each time an integration period
+// completes; the results stay valid until the next one does, and
+// integration carries on seamlessly.
+bool lockin_service();
+
+// input: 0 = CV in 1, 1 = CV in 2.
+const LockInResult& lockin_result(uint8_t input);
+
+// Actual reference frequency after rounding to the available clocks.
+double lockin_freq_hz();
+
+const char* lockin_reference_name(LockInReference reference);
+
+// kTestLockIn: runs the engine continuously with the reference chosen by
+// the lockin_ref setting (0 = CV out 1, 1 = CV out 2, 2 = pulse out), the
+// lockin_mv drive level and the lockin_ms integration time, and prints one
+// line per input and integration:
+//
+//   lockin ref=<cv_a|cv_b|pulse> input=<a|b> freq_hz=<f> amp_uv=<uv> phase_deg=<deg> floor_uv=<uv> samples=<n>
+void lockin_enter(Brain& brain);
+void lockin_run(Brain& brain, uint32_t now_ms);
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+
+#include "tone_detect.h"
+
+// The lock-in amplifier's per-block loop (lockin.h), kept free of SDK
+// includes so the host tests run the same code as the firmware.
+//
+// Each capture block holds `frames` frames of `stride` interleaved ADC
+// samples; the two inputs are at slot[0] and slot[1] of every frame. Both
+// are correlated with the reference and with the floor detector's
+// off-frequency reference. The references are re-aligned from each block's
+// sequence number, so a dropped block only costs its samples, and blocks
+// that start inside the settle time are skipped.
+class LockInDemod {
+public:
+    static constexpr int32_t kAdcMidScale = 2048;
+
+    // `step` and `floor_step` are per sample of one input (tone_phase_step()),
+    // `phase0` the reference phase at each input's first sample, `settle`
+    // and `target` counted in samples of one input.
+    void reset(uint32_t step, uint32_t floor_step, const uint32_t phase0[2],
+               const uint8_t slot[2], uint32_t settle, uint32_t target) {
+        for (uint8_t ch = 0; ch < 2; ++ch) {
+            phase0_[ch] = phase0[ch];
+            slot_[ch] = slot[ch];
+            tone_[ch].reset(step, phase0[ch]);
+            floor_[ch].reset(floor_step);
+        }
+        settle_ = settle;
+        target_ = target;
+    }
+
+    // Demodulates block `seq`. Each time `target` samples have been summed,
+    // calls on_latch(tone, floor) with both inputs' detectors and then
+    // clears them. Returns true if that happened at least once.
+    template <class OnLatch>
+    bool block(const uint16_t* block, uint32_t seq, uint32_t frames, uint8_t stride,
+               OnLatch&& on_latch) {
+        uint32_t first = seq * frames;
+        if (first < settle_) return false;
+        for (uint8_t ch = 0; ch < 2; ++ch) {
+            tone_[ch].seek(first, phase0_[ch]);
+            floor_[ch].seek(first);
+        }
+        bool latched = false;
+        for (uint32_t f = 0; f < frames; ++f) {
+            const uint16_t* frame = block + f * stride;
+            for (uint8_t ch = 0; ch < 2; ++ch) {
+                int32_t x = static_cast<int32_t>(frame[slot_[ch]]) - kAdcMidScale;
+                tone_[ch].push(x);
+                floor_[ch].push(x);
+            }
+            if (tone_[0].samples() >= target_) {
+                on_latch(tone_, floor_);
+                for (uint8_t ch = 0; ch < 2; ++ch) {
+                    tone_[ch].clear();
+                    floor_[ch].clear();
+                }
+                latched = true;
+            }
+        }
+        return latched;
+    }
+
+    const ToneDetector& tone(uint8_t ch) const { return tone_[ch]; }
+    const ToneDetector& floor(uint8_t ch) const { return floor_[ch]; }
+
+private:
+    ToneDetector tone_[2];
+    ToneDetector floor_[2];
+    uint32_t     phase0_[2] = {0, 0};
+    uint8_t      slot_[2]   = {0, 1};
+    uint32_t     settle_    = 0;
+    uint32_t     target_    = 0;
+};
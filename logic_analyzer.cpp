@@ -0,0 +1,442 @@
+#include "logic_analyzer.h"
+
+#include <cstdio>
+
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/pio.h"
+#include "pico/stdio.h"
+#include "pico/stdio_usb.h"
+#include "pico/stdlib.h"
+#include "tusb.h"
+
+#include "brain_pins.h"
+#include "hot_path.h"
+#include "pulse_pwm.h"
+#include "settings.h"
+#include "usb_frame.h"
+
+namespace {
+
+constexpr uint32_t kTransferCount = 0x0FFFFFFFu;  // see dac_stream.cpp
+constexpr size_t   kBufWords      = 8192;         // the DMA ring's 32 KB limit
+constexpr uint32_t kFlushUs       = 10000;        // longest a transition waits in a frame
+constexpr uint32_t kStatusMs      = 1000;
+constexpr size_t   kRecordMax     = 5;            // one varint
+// Whole frames only, and well inside the CDC FIFO, so one always fits
+// once the host has read the last.
+constexpr size_t   kFrameLimit    = 192;
+
+// Bit order of the channel states in the stream.
+constexpr uint kChannelPins[kLogicChannels] = {
+    kPulseInPin, kPulseOutPin, kButtonAPin, kButtonBPin, kMidiRxPin,
+};
+
+alignas(kBufWords * sizeof(uint32_t)) uint32_t g_buf[kBufWords];
+
+PIO           g_pio    = nullptr;
+uint          g_sm     = 0;
+uint          g_offset = 0;
+uint16_t      g_insns[3];
+pio_program_t g_program;
+int           g_dma    = -1;
+int           g_reload = -1;  // continuous: restarts g_dma when its count runs out
+uint32_t      g_reload_count = kTransferCount;  // what g_reload writes
+
+bool     g_started   = false;
+bool     g_active    = false;
+bool     g_burst     = false;
+bool     g_draining  = false;  // burst: buffer full, being sent
+uint8_t  g_trigger   = 0;      // 0 = none, else channel + 1
+uint8_t  g_lo        = 0;      // lowest sampled GPIO
+uint8_t  g_span      = 0;      // bits per sample
+uint8_t  g_per_word  = 0;      // samples per word
+uint32_t g_raw_mask  = 0;      // channel bits within a sample
+uint32_t g_rep_mask  = 0;      // ... within a word
+uint32_t g_raw_state = 0;      // current state, as sampled
+uint32_t g_rep_state = 0;      // ... repeated over a word
+uint32_t g_rate_hz   = 0;
+
+uint64_t g_base      = 0;  // continuous: words written by earlier DMA runs
+uint32_t g_left      = 0;  // ... the DMA count when last read
+uint64_t g_read      = 0;  // words encoded, from the start of the mode
+uint64_t g_end       = 0;  // words available
+uint64_t g_emit      = 0;  // sample index of the last record
+bool     g_resync    = false;  // take the state from the next word
+uint32_t g_transitions = 0;
+uint32_t g_dropped   = 0;  // samples
+uint32_t g_bursts    = 0;
+
+UsbFrame g_frame;
+bool     g_frame_open   = false;
+bool     g_frame_ready  = false;  // closed, waiting for room
+bool     g_marker_pending = false;
+bool     g_status_pending = false;
+uint8_t  g_seq          = 0;
+uint32_t g_flush_us     = 0;
+uint32_t g_status_ms    = 0;
+bool     g_own_pulse    = false;
+
+uint8_t DIAG_HOT_FUNC(channels)(uint32_t raw) {
+    uint8_t state = 0;
+    for (uint8_t i = 0; i < kLogicChannels; ++i) {
+        if (raw & (1u << (kChannelPins[i] - g_lo))) state |= static_cast<uint8_t>(1u << i);
+    }
+    return state;
+}
+
+uint32_t DIAG_HOT_FUNC(replicate)(uint32_t raw) {
+    uint32_t word = 0;
+    for (uint8_t j = 0; j < g_per_word; ++j) word |= raw << (j * g_span);
+    return word;
+}
+
+bool DIAG_HOT_FUNC(send)(UsbFrame& frame) {
+    size_t n = frame.finish();
+    if (!stdio_usb_connected() || tud_cdc_write_available() < n) return false;
+    stdio_put_string(reinterpret_cast<const char*>(frame.data()), static_cast<int>(n), false,
+                     false);
+    return true;
+}
+
+void DIAG_HOT_FUNC(open_frame)() {
+    g_frame.begin(kLogicTransitions, g_seq++);
+    g_frame.put_varint(static_cast<uint32_t>(g_emit));
+    g_frame.put(channels(g_raw_state));
+    g_frame_open = true;
+}
+
+// Runs stay far below the 2^27 samples a record holds: frames close every
+// 10 ms, and a burst is one buffer.
+void DIAG_HOT_FUNC(put_record)(uint64_t index, uint32_t raw) {
+    if (!g_frame_open) open_frame();
+    g_frame.put_varint(static_cast<uint32_t>(index - g_emit) << kLogicStateBits | channels(raw));
+    g_emit = index;
+}
+
+void DIAG_HOT_FUNC(transition)(uint64_t index, uint32_t raw) {
+    put_record(index, raw);
+    g_raw_state = raw;
+    g_rep_state = replicate(raw);
+    ++g_transitions;
+}
+
+// Makes room for a word's worth of records: closes a frame that might not
+// take them, and sends the closed one. False while USB has no room.
+bool DIAG_HOT_FUNC(frame_room)() {
+    if (g_frame_open && g_frame.size() + g_per_word * kRecordMax + 1 > kFrameLimit) {
+        g_frame_open = false;
+        g_frame_ready = true;
+    }
+    if (g_frame_ready) {
+        if (!send(g_frame)) return false;
+        g_frame_ready = false;
+        g_flush_us = time_us_32();
+    }
+    return true;
+}
+
+// Accounts for the samples up to `upto` and sends what's open.
+void DIAG_HOT_FUNC(flush)(uint64_t upto) {
+    if (g_frame_ready) {
+        frame_room();
+        return;
+    }
+    if (!g_resync && upto > g_emit) put_record(upto, g_raw_state);
+    if (g_frame_open) {
+        g_frame_open = false;
+        g_frame_ready = true;
+    }
+    frame_room();
+    g_flush_us = time_us_32();
+}
+
+// Oldest sample first: left shifts put it in the top bits of the word.
+void DIAG_HOT_FUNC(split)(uint32_t word, uint64_t first) {
+    for (uint8_t j = 0; j < g_per_word; ++j) {
+        uint32_t raw = (word >> ((g_per_word - 1 - j) * g_span)) & g_raw_mask;
+        if (raw != g_raw_state) transition(first + j, raw);
+    }
+}
+
+void DIAG_HOT_FUNC(encode)() {
+    while (g_read < g_end) {
+        if (!frame_room()) return;
+        if (g_marker_pending) {
+            g_marker_pending = false;
+            g_frame.begin(kLogicBurst, g_seq++);
+            g_frame.put_varint(g_bursts);
+            g_frame.put_varint(static_cast<uint32_t>(g_read * g_per_word));
+            g_frame_ready = true;
+            continue;
+        }
+        if (g_resync) {
+            g_resync = false;
+            g_raw_state = (g_buf[g_read % kBufWords] >> ((g_per_word - 1) * g_span)) & g_raw_mask;
+            g_rep_state = replicate(g_raw_state);
+            g_emit = g_read * g_per_word;
+        }
+        // Whole words without a change go by in one compare each.
+        while (g_read < g_end && (g_buf[g_read % kBufWords] & g_rep_mask) == g_rep_state) {
+            ++g_read;
+        }
+        if (g_read == g_end) return;
+        split(g_buf[g_read % kBufWords], g_read * g_per_word);
+        ++g_read;
+    }
+}
+
+// in_base is the lowest pin and each sample the whole span up to the
+// highest. With a trigger, two waits come first and stay outside the wrap.
+bool program_start(uint32_t div256) {
+    uint8_t n = 0;
+    if (g_trigger > 0) {
+        uint pin = kChannelPins[g_trigger - 1];
+        g_insns[n++] = pio_encode_wait_gpio(false, pin);
+        g_insns[n++] = pio_encode_wait_gpio(true, pin);
+    }
+    g_insns[n++] = pio_encode_in(pio_pins, g_span);
+
+    g_program = {};
+    g_program.instructions = g_insns;
+    g_program.length = n;
+    g_program.origin = -1;
+    if (!pio_claim_free_sm_and_add_program(&g_program, &g_pio, &g_sm, &g_offset)) {
+        return false;
+    }
+
+    pio_sm_config c = pio_get_default_sm_config();
+    sm_config_set_in_pins(&c, g_lo);
+    sm_config_set_in_shift(&c, false, true, g_per_word * g_span);
+    sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_RX);
+    sm_config_set_clkdiv_int_frac(&c, static_cast<uint16_t>(div256 >> 8),
+                                  static_cast<uint8_t>(div256 & 0xFF));
+    sm_config_set_wrap(&c, g_offset + n - 1, g_offset + n - 1);
+    pio_sm_init(g_pio, g_sm, g_offset, &c);
+    return true;
+}
+
+void program_stop() {
+    pio_sm_set_enabled(g_pio, g_sm, false);
+    pio_remove_program_and_unclaim_sm(&g_program, g_pio, g_sm, g_offset);
+    g_pio = nullptr;
+}
+
+// Continuous mode chains to a second channel that writes the count back
+// and retriggers, within a few cycles, so the capture never stops: the
+// PIO FIFO covers the handover. Re-arming from the main loop instead would
+// stall the PIO until the next pass, a gap the indices wouldn't show.
+void dma_configure() {
+    uint ch = static_cast<uint>(g_dma);
+    dma_channel_config c = dma_channel_get_default_config(ch);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    if (!g_burst) {
+        channel_config_set_ring(&c, true, 15);
+        channel_config_set_chain_to(&c, static_cast<uint>(g_reload));
+    }
+    channel_config_set_dreq(&c, pio_get_dreq(g_pio, g_sm, false));
+    dma_channel_configure(ch, &c, g_buf, &g_pio->rxf[g_sm], g_burst ? kBufWords : kTransferCount,
+                          false);
+    if (g_burst) return;
+
+    uint reload = static_cast<uint>(g_reload);
+    dma_channel_config r = dma_channel_get_default_config(reload);
+    channel_config_set_transfer_data_size(&r, DMA_SIZE_32);
+    channel_config_set_read_increment(&r, false);
+    channel_config_set_write_increment(&r, false);
+    dma_channel_configure(reload, &r, &dma_hw->ch[ch].al1_transfer_count_trig, &g_reload_count,
+                          1, false);
+}
+
+// Back to the top of the program, so a burst waits for its trigger again.
+void arm() {
+    pio_sm_set_enabled(g_pio, g_sm, false);
+    pio_sm_clear_fifos(g_pio, g_sm);
+    pio_sm_restart(g_pio, g_sm);
+    pio_sm_exec(g_pio, g_sm, pio_encode_jmp(g_offset));
+    dma_channel_set_write_addr(static_cast<uint>(g_dma), g_buf, false);
+    dma_channel_set_trans_count(static_cast<uint>(g_dma), g_burst ? kBufWords : kTransferCount,
+                                true);
+    pio_sm_set_enabled(g_pio, g_sm, true);
+}
+
+void release_resources() {
+    if (g_dma >= 0 && g_reload >= 0) {
+        // Break the chain first so aborting can't restart the capture.
+        dma_channel_config c = dma_get_channel_config(static_cast<uint>(g_dma));
+        channel_config_set_chain_to(&c, static_cast<uint>(g_dma));
+        dma_channel_set_config(static_cast<uint>(g_dma), &c, false);
+    }
+    if (g_reload >= 0) {
+        dma_channel_abort(static_cast<uint>(g_reload));
+        dma_channel_unclaim(static_cast<uint>(g_reload));
+        g_reload = -1;
+    }
+    if (g_dma >= 0) {
+        dma_channel_abort(static_cast<uint>(g_dma));
+        dma_channel_unclaim(static_cast<uint>(g_dma));
+        g_dma = -1;
+    }
+    if (g_pio != nullptr) program_stop();
+}
+
+// A run of the count takes over ten seconds even at 25 MHz, so a count
+// above the last one read means exactly one reload since.
+uint64_t DIAG_HOT_FUNC(written)() {
+    uint32_t left = dma_channel_hw_addr(static_cast<uint>(g_dma))->transfer_count;
+    if (left > g_left) g_base += kTransferCount;
+    g_left = left;
+    return g_base + (kTransferCount - left);
+}
+
+void DIAG_HOT_FUNC(service_continuous)() {
+    g_end = written();
+    if (g_end - g_read > kBufWords / 2) {
+        // The DMA may be writing just behind the oldest half; skip it.
+        flush(g_read * g_per_word);
+        uint64_t skip = g_end - g_read - kBufWords / 2;
+        g_dropped += static_cast<uint32_t>(skip * g_per_word);
+        g_read += skip;
+        g_resync = true;
+    }
+    encode();
+    if (time_us_32() - g_flush_us >= kFlushUs) flush(g_read * g_per_word);
+}
+
+void DIAG_HOT_FUNC(service_burst)() {
+    if (!g_draining) {
+        if (dma_channel_is_busy(static_cast<uint>(g_dma))) return;
+        pio_sm_set_enabled(g_pio, g_sm, false);
+        g_draining = true;
+        g_end = g_read + kBufWords;
+        ++g_bursts;
+        g_marker_pending = true;
+        g_resync = true;
+    }
+    encode();
+    if (g_read < g_end) return;
+    flush(g_end * g_per_word);
+    if (g_frame_ready || g_frame_open) return;
+    g_draining = false;
+    arm();
+}
+
+bool send_status() {
+    UsbFrame frame;
+    frame.begin(kLogicStatus, g_seq);
+    uint32_t fields[kLogicStatusFields] = {
+        g_rate_hz, g_burst ? 1u : 0u, g_trigger, static_cast<uint32_t>(g_read * g_per_word),
+        g_transitions, g_dropped, g_bursts,
+    };
+    for (uint32_t f : fields) frame.put_varint(f);
+    if (!send(frame)) return false;
+    ++g_seq;
+    return true;
+}
+
+bool start() {
+    uint8_t lo = kChannelPins[0];
+    uint8_t hi = kChannelPins[0];
+    for (uint pin : kChannelPins) {
+        if (pin < lo) lo = static_cast<uint8_t>(pin);
+        if (pin > hi) hi = static_cast<uint8_t>(pin);
+    }
+    g_lo = lo;
+    g_span = static_cast<uint8_t>(hi - lo + 1);
+    if (g_span > 32) {
+        printf("logic error=pins-out-of-reach\n");
+        return false;
+    }
+    g_per_word = static_cast<uint8_t>(32 / g_span);
+    g_raw_mask = 0;
+    for (uint pin : kChannelPins) g_raw_mask |= 1u << (pin - lo);
+    g_rep_mask = replicate(g_raw_mask);
+
+    g_burst = setting(kSettingLogicBurst) != 0;
+    g_trigger = static_cast<uint8_t>(setting(kSettingLogicTrigger));
+    // The PIO divider is 16.8 fixed point, 1.0 sampling on every clock. A
+    // fractional divider spaces samples unevenly, by up to a system clock.
+    uint64_t sys = clock_get_hz(clk_sys);
+    auto hz = static_cast<uint64_t>(setting(kSettingLogicHz));
+    uint64_t div256 = (sys * 256 + hz / 2) / hz;
+    if (div256 < 256) div256 = 256;
+    if (div256 > 0xFFFFFF) div256 = 0xFFFFFF;
+    g_rate_hz = static_cast<uint32_t>(sys * 256 / div256);
+
+    g_dma = dma_claim_unused_channel(false);
+    if (!g_burst) g_reload = dma_claim_unused_channel(false);
+    if (g_dma < 0 || (!g_burst && g_reload < 0) ||
+        !program_start(static_cast<uint32_t>(div256))) {
+        release_resources();
+        printf("logic error=start-failed\n");
+        return false;
+    }
+
+    int32_t pulse_hz = setting(kSettingLogicPulseHz);
+    g_own_pulse = pulse_hz > 0 && pulse_pwm_start(pulse_hz);
+
+    g_base = 0;
+    g_left = kTransferCount;
+    g_read = 0;
+    g_end = 0;
+    g_emit = 0;
+    g_resync = true;
+    g_draining = false;
+    g_transitions = 0;
+    g_dropped = 0;
+    g_bursts = 0;
+    g_frame_open = false;
+    g_frame_ready = false;
+    g_marker_pending = false;
+    g_seq = 0;
+    g_flush_us = time_us_32();
+    dma_configure();
+    g_active = true;
+    arm();
+    return true;
+}
+
+}  // namespace
+
+void logic_analyzer_enter(Brain& /*brain*/) {
+    g_started = false;
+}
+
+void logic_analyzer_stop() {
+    g_status_pending = false;
+    if (!g_active) return;
+    g_active = false;
+    release_resources();
+    if (g_own_pulse) pulse_pwm_stop();
+    g_own_pulse = false;
+}
+
+bool logic_analyzer_active() {
+    return g_active;
+}
+
+void DIAG_HOT_FUNC(logic_analyzer_run)(Brain& /*brain*/, uint32_t now_ms) {
+    if (!g_started) {
+        g_started = true;
+        if (!start()) return;
+        g_status_ms = now_ms;
+        g_status_pending = true;
+    }
+    if (!g_active) return;
+    if (now_ms - g_status_ms >= kStatusMs) {
+        g_status_ms = now_ms;
+        g_status_pending = true;
+    }
+    // Between transition frames, so sequence numbers go out in order; the
+    // first goes out before any, so the host knows the rate.
+    if (g_status_pending && !g_frame_open && !g_frame_ready && send_status()) {
+        g_status_pending = false;
+    }
+    if (g_burst) {
+        service_burst();
+    } else {
+        service_continuous();
+    }
+}
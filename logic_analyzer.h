@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+
+#include "tests.h"
+
+// kTestLogic: a five-channel logic analyzer on the board's digital pins,
+// streamed over USB to host/brain-logic.
+//
+// A PIO state machine samples pulse in, pulse out, Button A, Button B and
+// MIDI RX with one `in pins` per sample at logic_hz (a setting, up to
+// 25 MHz). It reads the span of GPIOs from the lowest of the five to the
+// highest and packs as many whole samples as fit into each 32-bit word,
+// which DMA moves into a 32 KB buffer. The CPU then run-length encodes the
+// words, comparing a whole word against the current state at once and
+// only picking it apart where something changed, so a quiet signal costs
+// next to nothing at any rate. The levels are raw pin levels, not the
+// SDK's debounced button state. The pins keep their functions: the UART,
+// the PWM and the buttons carry on while they're watched.
+//
+// Two ways to capture, set by logic_burst:
+//
+//   0, continuous: the buffer is a ring and transitions go out as they are
+//     encoded. If USB falls behind by half the ring, the oldest samples are
+//     skipped and counted as dropped; the stream marks the gap.
+//   1, burst: the buffer fills once at the full rate, sampling stops, and
+//     the burst is encoded and sent at whatever pace USB takes it. Then
+//     the capture re-arms. This reaches rates and edge densities that
+//     continuous streaming can't keep up with, in windows of 32 KB.
+//
+// logic_trigger 1-5 makes a capture wait for a rising edge on that channel
+// (in the order below) before the first sample; in continuous mode only
+// the start waits. logic_pulse_hz above 0 runs a square wave on pulse out,
+// a known signal to check the analyzer with. Settings are read when the
+// mode starts. Brain::update() is skipped while it runs, so Button A
+// doesn't leave the mode when pressed; use the console.
+//
+// Frames as in usb_frame.h, integers as varints. Sample indices count from
+// the start of the mode, mod 2^32; channel states are 5-bit masks, bit 0
+// pulse in, 1 pulse out, 2 Button A, 3 Button B, 4 MIDI RX.
+//
+//   type 1, transitions: start index, state (one byte), then records of
+//     (run << 5 | state): `run` samples after the previous record (or the
+//     start) the channels read `state`. A record whose state is unchanged
+//     only carries the time on; frames end with one, so each frame
+//     accounts for every sample up to its last record. Each frame starts
+//     where the previous one ended, unless samples were dropped between
+//     them.
+//   type 2, status: rate_hz, burst, trigger, samples (mod 2^32),
+//     transitions, dropped samples, bursts. At start and once a second.
+//   type 3, burst: burst number, start index. Sent before each burst's
+//     transitions; bursts are numbered back to back, the time between
+//     them isn't measured.
+
+// Frame constants shared with the host decoder.
+constexpr uint8_t kLogicTransitions  = 1;
+constexpr uint8_t kLogicStatus       = 2;
+constexpr uint8_t kLogicBurst        = 3;
+constexpr uint8_t kLogicChannels     = 5;
+constexpr uint8_t kLogicStateBits    = 5;
+constexpr uint8_t kLogicStatusFields = 7;
+
+void logic_analyzer_enter(Brain& brain);
+void logic_analyzer_run(Brain& brain, uint32_t now_ms);
+
+// Stops the capture. Called on every test change.
+void logic_analyzer_stop();
+bool logic_analyzer_active();
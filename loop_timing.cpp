@@ -0,0 +1,119 @@
+#include "loop_timing.h"
+
+#include <cstdio>
+
+#include "cycle_counter.h"
+#include "hot_path.h"
+
+namespace {
+
+constexpr uint32_t kReportIntervalMs = 1000;
+constexpr int32_t  kDacHighMv        =  5000;
+constexpr int32_t  kDacLowMv         = -5000;
+
+#if BRAIN_DIAG_COPY_TO_RAM
+constexpr const char* kBuildName = "copy_to_ram";
+#elif BRAIN_DIAG_RAM_HOT_PATHS
+constexpr const char* kBuildName = "ram_hot_path";
+#else
+constexpr const char* kBuildName = "xip";
+#endif
+
+struct CycleStats {
+    uint32_t n;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint64_t sum_sq;
+
+    void reset() {
+        n = 0;
+        min = UINT32_MAX;
+        max = 0;
+        sum = 0;
+        sum_sq = 0;
+    }
+
+    void add(uint32_t cycles) {
+        ++n;
+        if (cycles < min) min = cycles;
+        if (cycles > max) max = cycles;
+        sum += cycles;
+        sum_sq += static_cast<uint64_t>(cycles) * cycles;
+    }
+
+    uint32_t mean() const { return n ? static_cast<uint32_t>(sum / n) : 0; }
+
+    uint32_t stddev() const {
+        if (n < 2) return 0;
+        uint64_t m = sum / n;
+        uint64_t var = sum_sq / n - m * m;
+        // Integer square root; variance fits comfortably in 64 bits.
+        uint64_t r = 0;
+        for (uint64_t bit = 1ull << 62; bit != 0; bit >>= 2) {
+            if (var >= r + bit) {
+                var -= r + bit;
+                r = (r >> 1) + bit;
+            } else {
+                r >>= 1;
+            }
+        }
+        return static_cast<uint32_t>(r);
+    }
+};
+
+CycleStats g_loop;
+CycleStats g_dac;
+uint32_t   g_last_cycles    = 0;
+bool       g_have_last      = false;
+bool       g_dac_high       = false;
+uint32_t   g_last_report_ms = 0;
+
+}  // namespace
+
+void loop_timing_enter(Brain& brain) {
+    ensure_calibration_loaded(brain);
+    brain.outputs.set_output_range(kOutputsChannelA, kOutputsRangeMinus5To5V);
+    g_loop.reset();
+    g_dac.reset();
+    g_have_last = false;
+    g_last_report_ms = 0;
+}
+
+void DIAG_HOT_FUNC(loop_timing_run)(Brain& brain, uint32_t now_ms) {
+    // Start-to-start period of successive passes, i.e. one full loop.
+    uint32_t now = cycle_counter_read();
+    if (g_have_last) {
+        g_loop.add(cycle_counter_elapsed(g_last_cycles, now));
+    }
+    g_last_cycles = now;
+    g_have_last = true;
+
+    // One calibrated DAC write per loop pass: a square wave at loop rate on
+    // CV out 1, timed call-to-return.
+    g_dac_high = !g_dac_high;
+    uint32_t t0 = cycle_counter_read();
+    brain.outputs.set_voltage_calibrated_millivolts(kOutputsChannelA,
+                                                    g_dac_high ? kDacHighMv : kDacLowMv);
+    g_dac.add(cycle_counter_elapsed(t0, cycle_counter_read()));
+
+    if (g_last_report_ms == 0) g_last_report_ms = now_ms;
+    if (now_ms - g_last_report_ms >= kReportIntervalMs) {
+        g_last_report_ms = now_ms;
+        printf("timing build=%s loop_n=%lu loop_min=%lu loop_mean=%lu loop_max=%lu "
+               "loop_sd=%lu dac_min=%lu dac_mean=%lu dac_max=%lu\n",
+               kBuildName,
+               static_cast<unsigned long>(g_loop.n),
+               static_cast<unsigned long>(g_loop.min),
+               static_cast<unsigned long>(g_loop.mean()),
+               static_cast<unsigned long>(g_loop.max),
+               static_cast<unsigned long>(g_loop.stddev()),
+               static_cast<unsigned long>(g_dac.min),
+               static_cast<unsigned long>(g_dac.mean()),
+               static_cast<unsigned long>(g_dac.max));
+        g_loop.reset();
+        g_dac.reset();
+        // The printf itself stretches this pass; don't count it.
+        g_have_last = false;
+    }
+}
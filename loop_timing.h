@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdint>
+
+#include "tests.h"
+
+// kTestLoopTiming: measures main-loop period jitter and the cost of one
+// calibrated DAC update, and prints a "timing ..." line once a second.
+// Flash the XIP, RAM-hot-path and copy_to_ram builds in turn to compare.
+void loop_timing_enter(Brain& brain);
+void loop_timing_run(Brain& brain, uint32_t now_ms);
@@ -1,7 +1,22 @@
 #include <cstdint>
+#include <cstdio>
 
+#include "pico/stdio_usb.h"
 #include "pico/stdlib.h"
-
+#include "pico/unique_id.h"
+
+#include "adc_capture.h"
+#include "boot_profile.h"
+#include "console.h"
+#include "cycle_counter.h"
+#include "event_bus.h"
+#include "hang_guard.h"
+#include "hot_path.h"
+#include "logic_analyzer.h"
+#include "midi_notes.h"
+#include "midi_rx.h"
+#include "pot_scan.h"
+#include "settings.h"
 #include "tests.h"
 
 namespace {
@@ -11,12 +26,14 @@ constexpr uint32_t kIndicatorDurationMs = 800;
 Brain     g_brain;
 TestId    g_current_test       = kTestLeds;
 uint32_t  g_indicator_until_ms = 0;
+bool      g_first_frame_done   = false;
+bool      g_announce_test      = false;  // Button A changed the test
 
-uint32_t now_ms() {
+uint32_t DIAG_HOT_FUNC(now_ms)() {
     return to_ms_since_boot(get_absolute_time());
 }
 
-void show_binary(uint8_t value) {
+void DIAG_HOT_FUNC(show_binary)(uint8_t value) {
     // LED 1 (index 0) is on the left of the board and acts as the MSB,
     // so a 6-bit binary number reads naturally left-to-right.
     for (uint8_t i = 0; i < 6; ++i) {
@@ -29,51 +46,175 @@ void show_binary(uint8_t value) {
     }
 }
 
-void advance_test() {
-    g_current_test = static_cast<TestId>((g_current_test + 1) % kTestCount);
+void select_test(TestId test) {
+    g_current_test = test;
     on_test_enter(g_brain, g_current_test);
     g_indicator_until_ms = now_ms() + kIndicatorDurationMs;
 }
 
+void advance_test() {
+    // Host-only modes sit past kTestCount; Button A wraps back to test 1.
+    uint8_t next = static_cast<uint8_t>(g_current_test + 1);
+    select_test(static_cast<TestId>(next >= kTestCount ? 0 : next));
+    // Let an attached host notice manual test changes too. This runs inside
+    // Brain::update(), whose hang budget is shorter than a blocked USB
+    // write, so the line goes out from the console phase instead.
+    g_announce_test = true;
+}
+
+void handle_command(const ConsoleCommand& cmd) {
+    switch (cmd.type) {
+        case kConsoleId: {
+            char id[2 * PICO_UNIQUE_BOARD_ID_SIZE_BYTES + 1];
+            pico_get_unique_board_id_string(id, sizeof(id));
+            printf("id %s platform=%s\n", id, kPlatformName);
+            break;
+        }
+        case kConsoleTest:
+            if (!cmd.has_arg || cmd.arg < 0 || cmd.arg >= kTestAllCount) {
+                printf("err bad-test\n");
+                break;
+            }
+            select_test(static_cast<TestId>(cmd.arg));
+            printf("ok test=%u\n", static_cast<unsigned>(g_current_test));
+            break;
+        case kConsoleStatus:
+            printf("status test=%u uptime_ms=%lu\n",
+                   static_cast<unsigned>(g_current_test),
+                   static_cast<unsigned long>(now_ms()));
+            break;
+        case kConsoleBoot:
+            boot_report();
+            break;
+        case kConsoleMidi:
+            midi_rx_report();
+            break;
+        case kConsoleWatchdog:
+            hang_guard_report();
+            break;
+        case kConsoleBus:
+            event_bus_report(g_current_test);
+            break;
+        case kConsoleSet:
+            if (cmd.key[0] == '\0') {
+                settings_report();
+            } else if (cmd.has_arg && settings_set(cmd.key, cmd.arg)) {
+                printf("ok %s=%ld\n", cmd.key, static_cast<long>(cmd.arg));
+            } else {
+                printf("err bad-setting\n");
+            }
+            break;
+        default:
+            printf("err unknown-command\n");
+            break;
+    }
+}
+
+// The receive interrupt has already taken every byte off the UART; hand
+// what has queued up since the last pass to the parser in one go.
+void DIAG_HOT_FUNC(feed_midi_parser)() {
+    MidiRxEvent e;
+    for (uint32_t n = 0; n < kMidiRxRingSize && midi_rx_pop(e); ++n) {
+        midi_notes_count_byte(e.byte, e.time_us);
+        g_brain.midi_parser.process_byte(e.byte);
+    }
+}
+
+void DIAG_HOT_FUNC(loop_once)() {
+    // The SDK reads pots and CV inputs on the shared ADC inside update().
+    // The logic analyzer watches Button A, so a press mustn't leave it.
+    if (!adc_capture_exclusive() && !pot_scan_active() && !logic_analyzer_active()) {
+        hang_guard_enter(kGuardUpdate, g_current_test);
+        adc_capture_pause();
+        g_brain.update();
+        adc_capture_resume();
+    }
+    if (!midi_rx_exclusive()) {
+        hang_guard_enter(kGuardMidi, g_current_test);
+        feed_midi_parser();
+    }
+
+    hang_guard_enter(kGuardConsole, g_current_test);
+    if (g_announce_test) {
+        g_announce_test = false;
+        printf("event test=%u\n", static_cast<unsigned>(g_current_test));
+    }
+    ConsoleCommand cmd;
+    if (console_poll(cmd)) {
+        handle_command(cmd);
+    }
+
+    uint32_t t = now_ms();
+    if (t < g_indicator_until_ms) {
+        hang_guard_enter(kGuardOther, g_current_test);
+        show_binary(static_cast<uint8_t>(g_current_test + 1));
+    } else {
+        hang_guard_enter(kGuardTest, g_current_test);
+        // Everything a test spends on its inputs, events or polling, for
+        // the "bus" comparison. Brain::update() runs either way.
+        uint32_t start = cycle_counter_read();
+        uint32_t irq_start = event_bus_irq_cycles();
+        event_bus_poll(g_brain);
+        event_bus_dispatch(g_brain);
+        run_test(g_brain, g_current_test, t);
+        event_bus_account(cycle_counter_elapsed(start, cycle_counter_read()), irq_start);
+        if (!g_first_frame_done) {
+            g_first_frame_done = true;
+            boot_mark(kBootFirstTest);
+        }
+    }
+    hang_guard_enter(kGuardOther, g_current_test);
+}
+
 }  // namespace
 
 int main() {
-    stdio_init_all();
+    boot_mark(kBootMainEntry);
+    hang_guard_start();
 
     if (g_brain.init_all() == BrainInitStatus::kFailed) {
         // Init failure: blink button LED forever as a distress signal.
         g_brain.leds.button_start_blink(100);
         while (true) {
+            hang_guard_enter(kGuardUpdate, g_current_test);
             g_brain.update();
             sleep_ms(10);
         }
     }
+    boot_mark(kBootBrainInit);
+    cycle_counter_start();
 
-    // Try to load CV calibration from flash. If absent or corrupt, the
-    // CV-output tests still run; the scope just sees the uncalibrated DAC
-    // mapping. The diagnostics firmware never writes or clears calibration.
-    g_brain.outputs.load_calibration_from_flash();
+    // CV calibration is loaded lazily by the CV-output tests (see
+    // on_test_enter()), so reading flash stays off the boot path.
 
     g_brain.buttons.button_a.set_on_press(advance_test);
     g_brain.buttons.button_b.set_on_press(button_b_press);
     g_brain.buttons.button_b.set_on_release(button_b_release);
 
     g_brain.midi_parser.set_omni(true);
-    g_brain.midi_parser.set_note_on_callback(midi_note_on);
-    g_brain.midi_parser.set_note_off_callback(midi_note_off);
-
-    on_test_enter(g_brain, g_current_test);
-    g_indicator_until_ms = now_ms() + kIndicatorDurationMs;
+    g_brain.midi_parser.set_note_on_callback(midi_notes_on);
+    g_brain.midi_parser.set_note_off_callback(midi_notes_off);
+    midi_rx_start();
+
+    // After a hang, go straight back to the test that was running.
+    uint8_t resume = 0;
+    if (hang_guard_resume(resume) && resume < kTestAllCount) {
+        g_current_test = static_cast<TestId>(resume);
+    }
+    select_test(g_current_test);
 
     while (true) {
-        g_brain.update();
-        g_brain.midi_parser.process_uart();
-
-        uint32_t t = now_ms();
-        if (t < g_indicator_until_ms) {
-            show_binary(static_cast<uint8_t>(g_current_test + 1));
-        } else {
-            run_test(g_brain, g_current_test, t);
+        loop_once();
+
+        // USB CDC is started only once the first test is on the LEDs, so
+        // the operator sees a live board before enumeration begins.
+        if (!boot_marked(kBootIndicator)) {
+            boot_mark(kBootIndicator);
+            stdio_init_all();
+            boot_mark(kBootUsbInit);
+        } else if (!boot_marked(kBootUsbConnected) && stdio_usb_connected()) {
+            boot_mark(kBootUsbConnected);
+            hang_guard_announce();
         }
     }
 }
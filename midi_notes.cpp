@@ -0,0 +1,237 @@
+#include "midi_notes.h"
+
+#include <cstdio>
+
+#include "pico/stdlib.h"
+
+#include "event_bus.h"
+#include "hot_path.h"
+
+namespace {
+
+constexpr uint8_t kChannels       = 16;
+constexpr uint8_t kNotes          = 128;
+constexpr uint8_t kWordsPerChannel = kNotes / 32;
+constexpr uint8_t kVelocityBins   = 8;
+
+enum MessageType : uint8_t {
+    kTypeNoteOff = 0,
+    kTypeNoteOn,
+    kTypePolyAftertouch,
+    kTypeControlChange,
+    kTypeProgramChange,
+    kTypeChannelAftertouch,
+    kTypePitchBend,
+    kTypeSysEx,
+    kTypeCommon,
+    kTypeRealtime,
+    kTypeCount,
+};
+
+uint32_t g_held[kChannels][kWordsPerChannel];
+uint32_t g_stuck_reported[kChannels][kWordsPerChannel];
+uint32_t g_on_ms[kChannels][kNotes];
+uint16_t g_held_count = 0;
+
+uint32_t g_note_on      = 0;
+uint32_t g_note_off     = 0;
+uint32_t g_duplicate_on = 0;
+uint32_t g_orphan_off   = 0;
+uint32_t g_types[kTypeCount];
+uint32_t g_channels[kChannels];
+uint32_t g_velocity[kVelocityBins];
+uint32_t g_events       = 0;  // bumped on every change, for midi_notes_changed()
+uint32_t g_events_seen  = 0;
+
+// Running-status decoder for the type counters.
+uint8_t g_status     = 0;
+uint8_t g_data_need  = 0;
+uint8_t g_data_seen  = 0;
+uint32_t g_byte_us   = 0;  // receive time of the byte being parsed
+MidiNoteListener g_listener = nullptr;
+
+uint32_t DIAG_HOT_FUNC(now_ms)() {
+    return to_ms_since_boot(get_absolute_time());
+}
+
+void DIAG_HOT_FUNC(release)(uint8_t note, uint8_t channel) {
+    uint32_t& word = g_held[channel][note >> 5];
+    uint32_t bit = 1u << (note & 31);
+    ++g_note_off;
+    ++g_events;
+    if (!(word & bit)) {
+        ++g_orphan_off;
+        return;
+    }
+    word &= ~bit;
+    g_stuck_reported[channel][note >> 5] &= ~bit;
+    --g_held_count;
+}
+
+// Held notes past the threshold that haven't been reported yet.
+bool has_new_stuck(uint32_t now, uint32_t stuck_ms) {
+    if (g_held_count == 0) return false;
+    for (uint8_t ch = 0; ch < kChannels; ++ch) {
+        for (uint8_t w = 0; w < kWordsPerChannel; ++w) {
+            uint32_t pending = g_held[ch][w] & ~g_stuck_reported[ch][w];
+            while (pending != 0) {
+                uint8_t note = static_cast<uint8_t>(w * 32 + __builtin_ctz(pending));
+                pending &= pending - 1;
+                if (now - g_on_ms[ch][note] >= stuck_ms) return true;
+            }
+        }
+    }
+    return false;
+}
+
+}  // namespace
+
+void DIAG_HOT_FUNC(midi_notes_on)(uint8_t note, uint8_t velocity, uint8_t channel) {
+    if (g_listener != nullptr) g_listener(true, note, velocity, channel);
+    note &= 0x7F;
+    channel &= 0x0F;
+    event_bus_publish(kEventMidiNote, note, channel, velocity, g_byte_us);
+    if (velocity == 0) {
+        release(note, channel);
+        return;
+    }
+    ++g_note_on;
+    ++g_events;
+    ++g_channels[channel];
+    ++g_velocity[(velocity & 0x7F) >> 4];
+    uint32_t& word = g_held[channel][note >> 5];
+    uint32_t bit = 1u << (note & 31);
+    g_on_ms[channel][note] = now_ms();
+    if (word & bit) {
+        ++g_duplicate_on;
+        return;
+    }
+    word |= bit;
+    ++g_held_count;
+}
+
+void DIAG_HOT_FUNC(midi_notes_off)(uint8_t note, uint8_t velocity, uint8_t channel) {
+    if (g_listener != nullptr) g_listener(false, note, velocity, channel);
+    note &= 0x7F;
+    channel &= 0x0F;
+    event_bus_publish(kEventMidiNote, note, channel, 0, g_byte_us);
+    release(note, channel);
+}
+
+void DIAG_HOT_FUNC(midi_notes_count_byte)(uint8_t byte, uint32_t time_us) {
+    g_byte_us = time_us;
+    if (byte >= 0xF8) {
+        // Real-time bytes may appear anywhere, even inside a message.
+        ++g_types[kTypeRealtime];
+        ++g_events;
+        return;
+    }
+    if (byte >= 0xF0) {
+        if (byte == 0xF0) {
+            ++g_types[kTypeSysEx];
+            ++g_events;
+        } else if (byte != 0xF7) {
+            ++g_types[kTypeCommon];
+            ++g_events;
+        }
+        // System messages cancel running status; their data is ignored.
+        g_status = 0;
+        return;
+    }
+    if (byte >= 0x80) {
+        g_status = byte;
+        uint8_t kind = byte & 0xF0;
+        g_data_need = (kind == 0xC0 || kind == 0xD0) ? 1 : 2;
+        g_data_seen = 0;
+        return;
+    }
+    if (g_status == 0) return;
+    if (++g_data_seen < g_data_need) return;
+    g_data_seen = 0;
+    ++g_types[(g_status >> 4) - 0x8];
+    ++g_events;
+}
+
+void midi_notes_reset() {
+    for (uint8_t ch = 0; ch < kChannels; ++ch) {
+        for (uint8_t w = 0; w < kWordsPerChannel; ++w) {
+            g_held[ch][w] = 0;
+            g_stuck_reported[ch][w] = 0;
+        }
+        g_channels[ch] = 0;
+    }
+    for (uint32_t& t : g_types) t = 0;
+    for (uint32_t& v : g_velocity) v = 0;
+    g_held_count = 0;
+    g_note_on = 0;
+    g_note_off = 0;
+    g_duplicate_on = 0;
+    g_orphan_off = 0;
+    g_events = 0;
+    g_events_seen = 0;
+    g_status = 0;
+    g_listener = nullptr;
+}
+
+void midi_notes_set_listener(MidiNoteListener listener) {
+    g_listener = listener;
+}
+
+bool DIAG_HOT_FUNC(midi_notes_any_held)() {
+    return g_held_count != 0;
+}
+
+uint16_t midi_notes_held() {
+    return g_held_count;
+}
+
+bool midi_notes_changed(uint32_t now_ms, uint32_t stuck_ms) {
+    if (g_events != g_events_seen) {
+        g_events_seen = g_events;
+        return true;
+    }
+    return has_new_stuck(now_ms, stuck_ms);
+}
+
+void midi_notes_report(uint32_t now_ms, uint32_t stuck_ms) {
+    printf("midi notes held=%u on=%lu off=%lu duplicate_on=%lu orphan_off=%lu\n", g_held_count,
+           static_cast<unsigned long>(g_note_on), static_cast<unsigned long>(g_note_off),
+           static_cast<unsigned long>(g_duplicate_on), static_cast<unsigned long>(g_orphan_off));
+    printf("midi types note_off=%lu note_on=%lu poly_at=%lu cc=%lu program=%lu channel_at=%lu "
+           "pitch_bend=%lu sysex=%lu common=%lu realtime=%lu\n",
+           static_cast<unsigned long>(g_types[kTypeNoteOff]),
+           static_cast<unsigned long>(g_types[kTypeNoteOn]),
+           static_cast<unsigned long>(g_types[kTypePolyAftertouch]),
+           static_cast<unsigned long>(g_types[kTypeControlChange]),
+           static_cast<unsigned long>(g_types[kTypeProgramChange]),
+           static_cast<unsigned long>(g_types[kTypeChannelAftertouch]),
+           static_cast<unsigned long>(g_types[kTypePitchBend]),
+           static_cast<unsigned long>(g_types[kTypeSysEx]),
+           static_cast<unsigned long>(g_types[kTypeCommon]),
+           static_cast<unsigned long>(g_types[kTypeRealtime]));
+    printf("midi channels counts=");
+    for (uint8_t ch = 0; ch < kChannels; ++ch) {
+        printf(ch == 0 ? "%lu" : ",%lu", static_cast<unsigned long>(g_channels[ch]));
+    }
+    printf("\nmidi velocity bin=16 counts=");
+    for (uint8_t i = 0; i < kVelocityBins; ++i) {
+        printf(i == 0 ? "%lu" : ",%lu", static_cast<unsigned long>(g_velocity[i]));
+    }
+    printf("\n");
+
+    if (g_held_count == 0) return;
+    for (uint8_t ch = 0; ch < kChannels; ++ch) {
+        for (uint8_t w = 0; w < kWordsPerChannel; ++w) {
+            uint32_t held = g_held[ch][w];
+            while (held != 0) {
+                uint8_t note = static_cast<uint8_t>(w * 32 + __builtin_ctz(held));
+                held &= held - 1;
+                uint32_t held_ms = now_ms - g_on_ms[ch][note];
+                if (held_ms < stuck_ms) continue;
+                g_stuck_reported[ch][w] |= 1u << (note & 31);
+                printf("midi stuck channel=%u note=%u held_ms=%lu\n", ch + 1u, note,
+                       static_cast<unsigned long>(held_ms));
+            }
+        }
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+
+// Per-note MIDI state for the MIDI input test.
+//
+// A 16 x 128 bitmap records which notes the SDK's parser has reported as
+// sounding, so a duplicate note-on or a note-off for a note that isn't
+// held is told apart from a normal one. Every update and the "any note
+// held" query are O(1). Alongside it, the raw byte stream is classified
+// into message types (running status included) and note-ons are binned by
+// channel and velocity.
+
+// Parser callbacks. channel is 0-15; a note-on with velocity 0 is a
+// note-off. Each is also published on the event bus (see event_bus.h).
+void midi_notes_on(uint8_t note, uint8_t velocity, uint8_t channel);
+void midi_notes_off(uint8_t note, uint8_t velocity, uint8_t channel);
+
+// Observer of the two callbacks above, called first with exactly the
+// arguments the parser passed. For the MIDI sniffer; midi_notes_reset()
+// removes it.
+using MidiNoteListener = void (*)(bool on, uint8_t note, uint8_t velocity, uint8_t channel);
+void midi_notes_set_listener(MidiNoteListener listener);
+
+// Every received byte with its receive time, for the per-type message
+// counters and to timestamp the note events it completes.
+void midi_notes_count_byte(uint8_t byte, uint32_t time_us);
+
+void midi_notes_reset();
+bool midi_notes_any_held();
+uint16_t midi_notes_held();
+
+// True when anything changed or a note became stuck since the last call.
+bool midi_notes_changed(uint32_t now_ms, uint32_t stuck_ms);
+
+// Prints the counters and distributions:
+//
+//   midi notes held=<n> on=<n> off=<n> duplicate_on=<n> orphan_off=<n>
+//   midi types note_off=<n> note_on=<n> poly_at=<n> cc=<n> program=<n> channel_at=<n> pitch_bend=<n> sysex=<n> common=<n> realtime=<n>
+//   midi channels counts=<ch1,...,ch16>
+//   midi velocity bin=16 counts=<1-15,16-31,...,112-127>
+//   midi stuck channel=<1-16> note=<n> held_ms=<t>   (one per note held longer than stuck_ms)
+void midi_notes_report(uint32_t now_ms, uint32_t stuck_ms);
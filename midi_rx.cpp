@@ -0,0 +1,139 @@
+#include "midi_rx.h"
+
+#include <cstdio>
+
+#include "hardware/irq.h"
+#include "hardware/uart.h"
+#include "pico/stdlib.h"
+
+#include "brain_pins.h"
+#include "hot_path.h"
+
+namespace {
+
+MidiRxEvent       g_ring[kMidiRxRingSize];
+volatile uint32_t g_head       = 0;  // written by the IRQ
+volatile uint32_t g_tail       = 0;  // read by the main loop
+volatile uint32_t g_bytes      = 0;
+volatile uint32_t g_dropped    = 0;
+volatile uint32_t g_overruns   = 0;
+volatile uint32_t g_errors     = 0;
+volatile uint32_t g_high_water = 0;
+
+uart_inst_t* g_uart      = nullptr;
+uint         g_irq       = 0;
+bool         g_installed = false;
+bool         g_active    = false;
+bool         g_exclusive = false;
+
+uart_inst_t* midi_uart() {
+    // UART0 RX sits on GPIOs 1, 13, 17, 29 and UART1 RX on 5, 9, 21, 25.
+    return (((kMidiRxPin + 4) >> 3) & 1u) ? uart1 : uart0;
+}
+
+void DIAG_HOT_FUNC(uart_irq_handler)() {
+    if (!g_active) return;
+    uint32_t now = time_us_32();
+    uart_hw_t* hw = uart_get_hw(g_uart);
+    while (uart_is_readable(g_uart)) {
+        uint32_t dr = hw->dr;
+        auto flags = static_cast<uint8_t>((dr >> 8) & 0x0F);  // FE, PE, BE, OE
+        ++g_bytes;
+        if (flags & kMidiRxOverrun) ++g_overruns;
+        if (flags & (kMidiRxFraming | kMidiRxParity | kMidiRxBreak)) ++g_errors;
+
+        uint32_t head = g_head;
+        uint32_t depth = head - g_tail;
+        if (depth >= kMidiRxRingSize) {
+            ++g_dropped;
+            continue;
+        }
+        MidiRxEvent& e = g_ring[head % kMidiRxRingSize];
+        e.time_us = now;
+        e.byte = static_cast<uint8_t>(dr & 0xFF);
+        e.flags = flags;
+        g_head = head + 1;
+        if (depth + 1 > g_high_water) g_high_water = depth + 1;
+    }
+}
+
+}  // namespace
+
+void midi_rx_start() {
+    if (g_active) return;
+    g_uart = midi_uart();
+    g_irq = g_uart == uart0 ? UART0_IRQ : UART1_IRQ;
+    g_head = 0;
+    g_tail = 0;
+    g_bytes = 0;
+    g_dropped = 0;
+    g_overruns = 0;
+    g_errors = 0;
+    g_high_water = 0;
+
+    // One byte per interrupt, so each one is timestamped on arrival.
+    uart_set_fifo_enabled(g_uart, false);
+    if (!g_installed) {
+        irq_add_shared_handler(g_irq, uart_irq_handler,
+                               PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+        g_installed = true;
+    }
+    g_active = true;
+    irq_set_enabled(g_irq, true);
+    uart_set_irq_enables(g_uart, true, false);
+}
+
+void midi_rx_stop() {
+    if (!g_active) return;
+    uart_set_irq_enables(g_uart, false, false);
+    g_active = false;
+    g_exclusive = false;
+    uart_set_fifo_enabled(g_uart, true);
+}
+
+bool midi_rx_active() {
+    return g_active;
+}
+
+void midi_rx_set_exclusive(bool exclusive) {
+    g_exclusive = g_active && exclusive;
+}
+
+bool DIAG_HOT_FUNC(midi_rx_exclusive)() {
+    return g_exclusive;
+}
+
+bool DIAG_HOT_FUNC(midi_rx_pop)(MidiRxEvent& event) {
+    uint32_t tail = g_tail;
+    if (tail == g_head) return false;
+    event = g_ring[tail % kMidiRxRingSize];
+    g_tail = tail + 1;
+    return true;
+}
+
+uint32_t midi_rx_bytes() {
+    return g_bytes;
+}
+
+uint32_t midi_rx_dropped() {
+    return g_dropped;
+}
+
+uint32_t midi_rx_overruns() {
+    return g_overruns;
+}
+
+uint32_t midi_rx_errors() {
+    return g_errors;
+}
+
+uint32_t midi_rx_high_water() {
+    return g_high_water;
+}
+
+void midi_rx_report() {
+    printf("midi bytes=%lu dropped=%lu overruns=%lu errors=%lu high_water=%lu size=%lu\n",
+           static_cast<unsigned long>(g_bytes), static_cast<unsigned long>(g_dropped),
+           static_cast<unsigned long>(g_overruns), static_cast<unsigned long>(g_errors),
+           static_cast<unsigned long>(g_high_water), static_cast<unsigned long>(kMidiRxRingSize));
+}
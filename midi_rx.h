@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+
+// Interrupt-driven, timestamped MIDI receive.
+//
+// The MIDI UART's FIFO is switched off so every byte raises its own
+// receive interrupt, and the handler stores the byte, the UART's error
+// flags and time_us_32() in a ring. Timestamps are therefore taken within
+// a few microseconds of the stop bit, and no byte is lost however long the
+// main loop stalls, as long as the ring doesn't fill: 512 bytes is over
+// 160 ms of MIDI running flat out.
+//
+// The ring runs from boot and owns the UART. The main loop normally feeds
+// it to the SDK's MIDI parser in batches; a mode that wants the raw bytes
+// claims it with midi_rx_set_exclusive().
+
+constexpr uint32_t kMidiRxRingSize = 512;  // power of two
+
+// MidiRxEvent::flags, the UART's per-byte error bits.
+constexpr uint8_t kMidiRxFraming = 1u << 0;
+constexpr uint8_t kMidiRxParity  = 1u << 1;
+constexpr uint8_t kMidiRxBreak   = 1u << 2;
+constexpr uint8_t kMidiRxOverrun = 1u << 3;  // hardware lost a byte before this one
+
+struct MidiRxEvent {
+    uint32_t time_us;
+    uint8_t  byte;
+    uint8_t  flags;
+};
+
+void midi_rx_start();
+void midi_rx_stop();
+bool midi_rx_active();
+
+// While exclusive, the main loop leaves the ring alone and the caller pops
+// it. Cleared on every test change.
+void midi_rx_set_exclusive(bool exclusive);
+bool midi_rx_exclusive();
+
+// Oldest unread byte. Returns false when the ring is empty.
+bool midi_rx_pop(MidiRxEvent& event);
+
+// Counters since start.
+uint32_t midi_rx_bytes();       // bytes received, including dropped ones
+uint32_t midi_rx_dropped();     // bytes lost because the ring was full
+uint32_t midi_rx_overruns();    // bytes lost in the UART before the interrupt ran
+uint32_t midi_rx_errors();      // framing, parity and break errors
+uint32_t midi_rx_high_water();  // most bytes ever waiting in the ring
+
+// Prints "midi bytes=<n> dropped=<n> overruns=<n> errors=<n> high_water=<n> size=<n>".
+void midi_rx_report();
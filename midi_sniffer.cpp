@@ -0,0 +1,175 @@
+#include "midi_sniffer.h"
+
+#include "pico/stdio.h"
+#include "pico/stdio_usb.h"
+#include "pico/stdlib.h"
+#include "tusb.h"
+
+#include "hot_path.h"
+#include "midi_notes.h"
+#include "midi_rx.h"
+#include "usb_frame.h"
+
+namespace {
+
+constexpr uint32_t kFlushUs    = 10000;  // longest a record waits in a frame
+constexpr uint32_t kStatusMs   = 1000;
+// A byte and the note it may complete: two varints and four bytes.
+constexpr size_t   kRecordsMax = 5 + 2 + 5 + 3;
+// Whole frames only, and well inside the CDC FIFO, as in the logic
+// analyzer.
+constexpr size_t   kFrameLimit = 192;
+
+UsbFrame g_frame;
+bool     g_started      = false;
+bool     g_frame_open   = false;
+bool     g_frame_ready  = false;  // closed, waiting for room
+bool     g_status_pending = false;
+uint8_t  g_seq          = 0;
+uint32_t g_frame_us     = 0;  // time the open frame was started
+uint32_t g_last_us      = 0;  // time of the last record
+uint32_t g_status_ms    = 0;
+
+uint32_t g_bytes     = 0;
+uint32_t g_framing   = 0;
+uint32_t g_parity    = 0;
+uint32_t g_breaks    = 0;
+uint32_t g_overruns  = 0;
+uint32_t g_note_on   = 0;
+uint32_t g_note_off  = 0;
+uint32_t g_drop_base = 0;
+
+bool DIAG_HOT_FUNC(send)(UsbFrame& frame) {
+    size_t n = frame.finish();
+    if (!stdio_usb_connected() || tud_cdc_write_available() < n) return false;
+    stdio_put_string(reinterpret_cast<const char*>(frame.data()), static_cast<int>(n), false,
+                     false);
+    return true;
+}
+
+void DIAG_HOT_FUNC(close_frame)() {
+    if (!g_frame_open) return;
+    g_frame_open = false;
+    g_frame_ready = true;
+}
+
+// Makes room for one byte's records, sending the last frame first. False
+// while USB has no room; the bytes wait in the receive ring meanwhile.
+bool DIAG_HOT_FUNC(frame_room)() {
+    if (g_frame_open && g_frame.size() + kRecordsMax + 1 > kFrameLimit) close_frame();
+    if (!g_frame_ready) return true;
+    if (!send(g_frame)) return false;
+    g_frame_ready = false;
+    return true;
+}
+
+void DIAG_HOT_FUNC(put_kind)(uint8_t kind, uint32_t time_us) {
+    if (!g_frame_open) {
+        g_frame.begin(kMidiSniffRecords, g_seq++);
+        g_frame.put_varint(time_us);
+        g_frame_open = true;
+        g_frame_us = time_us_32();
+        g_last_us = time_us;
+    }
+    g_frame.put_varint((time_us - g_last_us) << kMidiSniffKindBits | kind);
+    g_last_us = time_us;
+}
+
+void DIAG_HOT_FUNC(put_byte)(const MidiRxEvent& e) {
+    ++g_bytes;
+    if (e.flags & kMidiRxFraming) ++g_framing;
+    if (e.flags & kMidiRxParity) ++g_parity;
+    if (e.flags & kMidiRxBreak) ++g_breaks;
+    if (e.flags & kMidiRxOverrun) ++g_overruns;
+    if (e.flags == 0) {
+        put_kind(kMidiSniffByte, e.time_us);
+    } else {
+        put_kind(kMidiSniffByteError, e.time_us);
+        g_frame.put(e.flags);
+    }
+    g_frame.put(e.byte);
+}
+
+// Called from inside the parser, right after the byte that completed the
+// message was recorded.
+void DIAG_HOT_FUNC(on_note)(bool on, uint8_t note, uint8_t velocity, uint8_t channel) {
+    if (on) {
+        ++g_note_on;
+    } else {
+        ++g_note_off;
+    }
+    put_kind(on ? kMidiSniffNoteOn : kMidiSniffNoteOff, g_last_us);
+    g_frame.put(note);
+    g_frame.put(velocity);
+    g_frame.put(channel);
+}
+
+bool send_status() {
+    UsbFrame frame;
+    frame.begin(kMidiSniffStatus, g_seq);
+    uint32_t fields[kMidiSniffStatusFields] = {
+        g_bytes,   g_framing, g_parity, g_breaks, g_overruns, midi_rx_dropped() - g_drop_base,
+        g_note_on, g_note_off, midi_rx_high_water(),
+    };
+    for (uint32_t f : fields) frame.put_varint(f);
+    if (!send(frame)) return false;
+    ++g_seq;
+    return true;
+}
+
+void start(uint32_t now_ms) {
+    midi_rx_set_exclusive(true);
+    midi_notes_set_listener(on_note);
+    g_frame_open = false;
+    g_frame_ready = false;
+    g_seq = 0;
+    g_bytes = 0;
+    g_framing = 0;
+    g_parity = 0;
+    g_breaks = 0;
+    g_overruns = 0;
+    g_note_on = 0;
+    g_note_off = 0;
+    g_drop_base = midi_rx_dropped();
+    g_status_ms = now_ms;
+    g_status_pending = true;
+}
+
+}  // namespace
+
+void midi_sniffer_enter(Brain& /*brain*/) {
+    g_started = false;
+}
+
+void midi_sniffer_stop() {
+    g_frame_open = false;
+    g_frame_ready = false;
+    g_status_pending = false;
+}
+
+void DIAG_HOT_FUNC(midi_sniffer_run)(Brain& brain, uint32_t now_ms) {
+    if (!g_started) {
+        g_started = true;
+        start(now_ms);
+    }
+
+    if (now_ms - g_status_ms >= kStatusMs) {
+        g_status_ms = now_ms;
+        g_status_pending = true;
+    }
+    // Between record frames, so sequence numbers go out in order.
+    if (g_status_pending && !g_frame_open && !g_frame_ready && send_status()) {
+        g_status_pending = false;
+    }
+
+    MidiRxEvent e;
+    while (frame_room() && midi_rx_pop(e)) {
+        put_byte(e);
+        midi_notes_count_byte(e.byte, e.time_us);
+        brain.midi_parser.process_byte(e.byte);
+    }
+    if (g_frame_open && time_us_32() - g_frame_us >= kFlushUs) {
+        close_frame();
+        frame_room();
+    }
+}
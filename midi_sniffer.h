@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+
+#include "tests.h"
+
+// kTestMidiSniffer: every byte on the MIDI input, streamed over USB with
+// its receive time, error flags and what the SDK's parser made of it, to
+// host/brain-midi-sniff.
+//
+// The mode claims the midi_rx ring (midi_rx.h), so each byte carries the
+// time_us_32() the receive interrupt took within microseconds of its stop
+// bit and the UART's framing, parity, break and overrun flags for it. The
+// bytes then go through the SDK's parser as usual, and each note-on or
+// note-off callback it makes is recorded right after the byte that
+// completed the message, with the callback's own arguments.
+//
+// Nothing is dropped for want of USB bandwidth: when the host hasn't read
+// the last frame yet, bytes wait in the 512-byte receive ring (160 ms at
+// full rate) instead. MIDI running flat out at 31.25 kbaud is 3125 bytes
+// a second, about 10 KB/s in frames. Bytes are only lost if the ring
+// overflows, and then they are counted.
+//
+// Frames as in usb_frame.h, integers as varints:
+//
+//   type 1, records: t_us of the first record, then per record
+//     (dt_us << 2 | kind) and
+//       kind 0, byte: the byte
+//       kind 1, byte with errors: flags (MidiRxEvent::flags), the byte
+//       kind 2, note on: note, velocity, channel as the callback got them
+//       kind 3, note off: likewise
+//     Note records share the time of the byte before them.
+//   type 2, status: bytes, framing errors, parity errors, breaks,
+//     overruns, bytes dropped by the ring, note ons, note offs, the ring's
+//     high water mark since boot. Counts are since the mode started. Sent
+//     at start and once a second.
+
+// Frame constants shared with the host decoder.
+constexpr uint8_t kMidiSniffRecords      = 1;
+constexpr uint8_t kMidiSniffStatus       = 2;
+constexpr uint8_t kMidiSniffByte         = 0;
+constexpr uint8_t kMidiSniffByteError    = 1;
+constexpr uint8_t kMidiSniffNoteOn       = 2;
+constexpr uint8_t kMidiSniffNoteOff      = 3;
+constexpr uint8_t kMidiSniffKindBits     = 2;
+constexpr uint8_t kMidiSniffStatusFields = 9;
+
+void midi_sniffer_enter(Brain& brain);
+void midi_sniffer_run(Brain& brain, uint32_t now_ms);
+
+// Drops whatever frame is waiting. Called on every test change.
+void midi_sniffer_stop();
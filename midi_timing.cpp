@@ -0,0 +1,182 @@
+#include "midi_timing.h"
+
+#include <cmath>
+#include <cstdio>
+
+#include "midi_rx.h"
+
+namespace {
+
+constexpr uint8_t  kMidiClock    = 0xF8;
+constexpr uint8_t  kMidiStart    = 0xFA;
+constexpr uint8_t  kMidiContinue = 0xFB;
+constexpr uint8_t  kMidiStop     = 0xFC;
+
+constexpr uint32_t kReportMs     = 1000;
+constexpr uint32_t kClocksPerBeat = 24;
+constexpr int32_t  kBinUs        = 100;
+constexpr uint32_t kBins         = 20;  // -1000 us to +1000 us
+constexpr int32_t  kHistLowUs    = -kBinUs * static_cast<int32_t>(kBins / 2);
+// A gap this long is a stopped clock, not an interval.
+constexpr uint32_t kMaxIntervalUs = 500000;
+
+// Last kClocksPerBeat intervals, for the reference mean.
+uint32_t g_recent[kClocksPerBeat];
+uint32_t g_recent_count = 0;
+uint32_t g_recent_sum   = 0;
+uint32_t g_recent_next  = 0;
+
+bool     g_have_clock   = false;
+uint32_t g_last_clock_us = 0;
+bool     g_wait_first   = false;
+uint32_t g_start_us     = 0;
+
+// Current report window.
+uint32_t g_clocks       = 0;
+uint64_t g_sum_us       = 0;
+uint32_t g_min_us       = 0;
+uint32_t g_max_us       = 0;
+uint32_t g_dev_count    = 0;
+double   g_dev_sq       = 0.0;
+uint32_t g_hist[kBins];
+uint32_t g_under        = 0;
+uint32_t g_over         = 0;
+uint32_t g_errors       = 0;
+
+double   g_first_mean_us = 0.0;
+uint32_t g_report_ms    = 0;
+bool     g_started      = false;
+uint32_t g_dropped_base = 0;
+
+void reset_window() {
+    g_clocks = 0;
+    g_sum_us = 0;
+    g_min_us = UINT32_MAX;
+    g_max_us = 0;
+    g_dev_count = 0;
+    g_dev_sq = 0.0;
+    for (uint32_t& h : g_hist) h = 0;
+    g_under = 0;
+    g_over = 0;
+    g_errors = 0;
+}
+
+void reset_recent() {
+    g_recent_count = 0;
+    g_recent_sum = 0;
+    g_recent_next = 0;
+}
+
+void on_interval(uint32_t us) {
+    ++g_clocks;
+    g_sum_us += us;
+    if (us < g_min_us) g_min_us = us;
+    if (us > g_max_us) g_max_us = us;
+
+    if (g_recent_count == kClocksPerBeat) {
+        double dev = static_cast<double>(us) - static_cast<double>(g_recent_sum) / kClocksPerBeat;
+        ++g_dev_count;
+        g_dev_sq += dev * dev;
+        auto bin = static_cast<int32_t>(std::floor((dev - kHistLowUs) / kBinUs));
+        if (bin < 0) {
+            ++g_under;
+        } else if (bin >= static_cast<int32_t>(kBins)) {
+            ++g_over;
+        } else {
+            ++g_hist[bin];
+        }
+        g_recent_sum -= g_recent[g_recent_next];
+    } else {
+        ++g_recent_count;
+    }
+    g_recent[g_recent_next] = us;
+    g_recent_sum += us;
+    g_recent_next = (g_recent_next + 1) % kClocksPerBeat;
+}
+
+void on_event(const MidiRxEvent& e) {
+    if (e.flags != 0) ++g_errors;
+    switch (e.byte) {
+        case kMidiClock:
+            if (g_wait_first) {
+                g_wait_first = false;
+                printf("midiclk event=first_clock after_start_us=%lu\n",
+                       static_cast<unsigned long>(e.time_us - g_start_us));
+            }
+            if (g_have_clock) {
+                uint32_t us = e.time_us - g_last_clock_us;
+                if (us <= kMaxIntervalUs) {
+                    on_interval(us);
+                } else {
+                    reset_recent();
+                }
+            }
+            g_have_clock = true;
+            g_last_clock_us = e.time_us;
+            break;
+        case kMidiStart:
+            g_wait_first = true;
+            g_start_us = e.time_us;
+            printf("midiclk event=start\n");
+            break;
+        case kMidiContinue:
+            printf("midiclk event=continue\n");
+            break;
+        case kMidiStop:
+            if (g_have_clock) {
+                printf("midiclk event=stop since_clock_us=%lu\n",
+                       static_cast<unsigned long>(e.time_us - g_last_clock_us));
+            } else {
+                printf("midiclk event=stop\n");
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void report() {
+    if (g_clocks == 0) return;
+    double mean = static_cast<double>(g_sum_us) / g_clocks;
+    if (g_first_mean_us == 0.0) g_first_mean_us = mean;
+    double jitter = g_dev_count > 0 ? std::sqrt(g_dev_sq / g_dev_count) : 0.0;
+    printf("midiclk bpm=%.3f clocks=%lu mean_us=%.1f min_us=%lu max_us=%lu jitter_us=%.1f "
+           "drift_ppm=%.1f dropped=%lu errors=%lu\n",
+           60e6 / (kClocksPerBeat * mean), static_cast<unsigned long>(g_clocks), mean,
+           static_cast<unsigned long>(g_min_us), static_cast<unsigned long>(g_max_us), jitter,
+           1e6 * (mean - g_first_mean_us) / g_first_mean_us,
+           static_cast<unsigned long>(midi_rx_dropped() + midi_rx_overruns() - g_dropped_base),
+           static_cast<unsigned long>(g_errors));
+    printf("midiclk hist bin_us=%ld under=%lu counts=", static_cast<long>(kBinUs),
+           static_cast<unsigned long>(g_under));
+    for (uint32_t i = 0; i < kBins; ++i) {
+        printf(i == 0 ? "%lu" : ",%lu", static_cast<unsigned long>(g_hist[i]));
+    }
+    printf(" over=%lu\n", static_cast<unsigned long>(g_over));
+}
+
+}  // namespace
+
+void midi_timing_enter(Brain& /*brain*/) {
+    g_started = false;
+}
+
+void midi_timing_run(Brain& /*brain*/, uint32_t now_ms) {
+    if (!g_started) {
+        g_started = true;
+        g_have_clock = false;
+        g_wait_first = false;
+        g_first_mean_us = 0.0;
+        g_report_ms = now_ms;
+        reset_recent();
+        reset_window();
+        g_dropped_base = midi_rx_dropped() + midi_rx_overruns();
+        midi_rx_set_exclusive(true);
+    }
+    MidiRxEvent e;
+    while (midi_rx_pop(e)) on_event(e);
+    if (now_ms - g_report_ms < kReportMs) return;
+    g_report_ms = now_ms;
+    report();
+    reset_window();
+}
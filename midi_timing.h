@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+
+#include "tests.h"
+
+// kTestMidiTiming: timing analysis of an incoming MIDI clock. Every byte
+// is timestamped by the receive interrupt (midi_rx.h) when it arrives, so
+// the figures describe the sender and the cable rather than this loop.
+//
+// Once a second, while clocks (0xF8) are arriving:
+//
+//   midiclk bpm=<b> clocks=<n> mean_us=<m> min_us=<lo> max_us=<hi> jitter_us=<rms> drift_ppm=<d> dropped=<n> errors=<n>
+//   midiclk hist bin_us=100 under=<n> counts=<c0,...,c19> over=<n>
+//
+// dropped counts bytes lost in the UART or the receive ring since the
+// mode started. jitter_us is the RMS deviation of each interval from the mean of the
+// 24 before it (one quarter note), and the histogram bins the same
+// deviation from -1000 us to +1000 us. drift_ppm compares the window's
+// mean interval with the first window's. Transport messages print as they
+// are seen:
+//
+//   midiclk event=start
+//   midiclk event=first_clock after_start_us=<t>
+//   midiclk event=continue
+//   midiclk event=stop since_clock_us=<t>
+//
+// While this mode runs it claims the receive ring, so the SDK's MIDI
+// parser sees no input.
+void midi_timing_enter(Brain& brain);
+void midi_timing_run(Brain& brain, uint32_t now_ms);
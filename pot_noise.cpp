@@ -0,0 +1,130 @@
+#include "pot_noise.h"
+
+#include <cmath>
+#include <cstdio>
+
+#include "hot_path.h"
+#include "pot_scan.h"
+#include "settings.h"
+
+namespace {
+
+constexpr uint32_t kSettleNs     = 5000;
+constexpr uint32_t kReportMs     = 1000;
+constexpr uint32_t kLowPassShift = 9;   // alpha = 1/512: ~13 Hz at 41 kHz
+constexpr uint32_t kJitterFrac   = 4;   // jitter kept in Q4 counts
+constexpr int32_t  kMovingCounts = 64;
+constexpr size_t   kReadChunk    = 64;
+
+// Running sums over one report window; the low-pass state carries on
+// across windows.
+struct PotNoise {
+    bool     primed;
+    int32_t  lp;         // Q16 counts
+    uint32_t n;
+    int64_t  sum;
+    int64_t  sum_sq;
+    int32_t  min;
+    int32_t  max;
+    int32_t  lp_min;     // Q16
+    int32_t  lp_max;
+    int64_t  hp_sum_sq;  // Q4 squared
+    uint32_t flagged;
+};
+
+PotNoise g_pots[kPotScanPots];
+bool     g_failed    = false;
+uint32_t g_report_ms = 0;
+
+void clear_window(PotNoise& p) {
+    p.n = 0;
+    p.sum = 0;
+    p.sum_sq = 0;
+    p.min = INT32_MAX;
+    p.max = INT32_MIN;
+    p.lp_min = INT32_MAX;
+    p.lp_max = INT32_MIN;
+    p.hp_sum_sq = 0;
+}
+
+// Integer only: at ~120k readings a second, soft float would eat the
+// RP2040.
+void DIAG_HOT_FUNC(push)(PotNoise& p, int32_t x) {
+    int32_t q = x << 16;
+    if (!p.primed) {
+        p.primed = true;
+        p.lp = q;
+    }
+    p.lp += (q - p.lp) >> kLowPassShift;
+    int32_t hp = (q - p.lp) >> (16 - kJitterFrac);
+
+    ++p.n;
+    p.sum += x;
+    p.sum_sq += static_cast<int64_t>(x) * x;
+    if (x < p.min) p.min = x;
+    if (x > p.max) p.max = x;
+    if (p.lp < p.lp_min) p.lp_min = p.lp;
+    if (p.lp > p.lp_max) p.lp_max = p.lp;
+    p.hp_sum_sq += static_cast<int64_t>(hp) * hp;
+}
+
+void report(uint8_t index, PotNoise& p) {
+    if (p.n == 0) return;
+    double mean = static_cast<double>(p.sum) / p.n;
+    double var = static_cast<double>(p.sum_sq) / p.n - mean * mean;
+    double std_dev = var > 0.0 ? std::sqrt(var) : 0.0;
+    double drift = (p.lp_max - p.lp_min) / 65536.0;
+    double jitter = std::sqrt(static_cast<double>(p.hp_sum_sq) / p.n) / (1 << kJitterFrac);
+
+    const char* status = "ok";
+    bool too_jittery = jitter > setting(kSettingPotJitterMax);
+    bool too_drifty = drift > setting(kSettingPotDriftMax);
+    if (drift > kMovingCounts) {
+        status = "moving";
+    } else if (too_jittery || too_drifty) {
+        status = too_jittery && too_drifty ? "jitter+drift" : too_jittery ? "jitter" : "drift";
+        ++p.flagged;
+    }
+    printf("potnoise pot=%u mean=%.2f std=%.3f pkpk=%ld drift_pkpk=%.2f jitter_rms=%.3f status=%s "
+           "flagged=%lu\n",
+           index + 1, mean, std_dev, static_cast<long>(p.max - p.min), drift, jitter, status,
+           static_cast<unsigned long>(p.flagged));
+}
+
+}  // namespace
+
+void pot_noise_enter(Brain& /*brain*/) {
+    g_failed = false;
+}
+
+void DIAG_HOT_FUNC(pot_noise_run)(Brain& /*brain*/, uint32_t now_ms) {
+    if (g_failed) return;
+    if (!pot_scan_active()) {
+        if (!pot_scan_start(kSettleNs)) {
+            g_failed = true;
+            printf("potnoise error=start-failed\n");
+            return;
+        }
+        for (PotNoise& p : g_pots) {
+            p.primed = false;
+            p.flagged = 0;
+            clear_window(p);
+        }
+        g_report_ms = now_ms;
+    }
+
+    pot_scan_service();
+    uint16_t buf[kReadChunk];
+    uint64_t first = 0;
+    size_t n;
+    while ((n = pot_scan_read(buf, kReadChunk, first)) > 0) {
+        for (size_t i = 0; i < n; ++i) push(g_pots[(first + i) % kPotScanPots], buf[i]);
+    }
+
+    if (now_ms - g_report_ms < kReportMs) return;
+    g_report_ms = now_ms;
+    for (uint8_t i = 0; i < kPotScanPots; ++i) {
+        report(i, g_pots[i]);
+        clear_window(g_pots[i]);
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+#include "tests.h"
+
+// kTestPotNoise: noise and wiper jitter of each pot at full ADC
+// resolution. Leave the pots still (anywhere but the end stops, where a
+// bad track reads clean) and select the mode.
+//
+// The pots are scanned in hardware (pot_scan.h) with a 5 us settle
+// delay, about 41k 12-bit readings per pot a second. A one-pole low-pass
+// at about 13 Hz splits every reading into slow drift (the low-passed
+// value) and fast jitter (what is left). All statistics are running sums
+// and extremes, so memory does not depend on how long the mode runs.
+// Once a second, per pot:
+//
+//   potnoise pot=<1-3> mean=<counts> std=<counts> pkpk=<counts> drift_pkpk=<counts> jitter_rms=<counts> status=<s> flagged=<n>
+//
+// std and pkpk are of the raw readings, drift_pkpk of the low-passed value
+// and jitter_rms of the rest. status is ok, or jitter and/or drift when
+// jitter_rms exceeds pot_jitter_max or drift_pkpk exceeds pot_drift_max
+// (settings, in counts), or moving when the pot was clearly turned
+// (drift over 64 counts, not counted). flagged counts the flagged seconds
+// since the mode started.
+//
+// Buttons are not read while the mode runs.
+void pot_noise_enter(Brain& brain);
+void pot_noise_run(Brain& brain, uint32_t now_ms);
@@ -0,0 +1,445 @@
+#include "pot_scan.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "hardware/adc.h"
+#include "hardware/address_mapped.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/pio.h"
+#include "pico/stdlib.h"
+
+#include "brain_pins.h"
+#include "hot_path.h"
+
+static_assert(kPotMuxS1Pin == kPotMuxS0Pin + 1, "PIO drives S0/S1 as one pin group");
+static_assert(ADC_CS_START_ONCE_BITS < 32, "fits a PIO set immediate");
+
+namespace {
+
+constexpr uint32_t kPioHz          = 10000000;  // 100 ns per PIO cycle
+// Cycles between the select lines changing and the trigger push, with a
+// zero settle count; and from the push to the next change (conversion).
+constexpr uint32_t kSettleOverhead = 5;
+constexpr uint32_t kConvertCycles  = 31;
+constexpr uint32_t kSelectsPerWord = 15;  // 2 bits each, 5 rounds of 3 pots
+constexpr uint32_t kTransferCount  = 0x0FFFFFFFu;  // see dac_stream.cpp
+constexpr size_t   kRingSamples    = 1024;
+
+alignas(kRingSamples * sizeof(uint16_t)) uint16_t g_ring[kRingSamples];
+uint32_t g_select_word = 0;
+
+PIO           g_pio    = nullptr;
+uint          g_sm     = 0;
+uint          g_offset = 0;
+uint16_t      g_insns[7];
+pio_program_t g_program;
+int           g_dma_select  = -1;
+int           g_dma_trigger = -1;
+int           g_dma_result  = -1;
+bool          g_active      = false;
+uint32_t      g_settle_ns   = 0;
+uint32_t      g_rate_hz     = 0;
+uint64_t      g_base        = 0;  // samples written by earlier DMA runs
+uint64_t      g_read        = 0;
+uint32_t      g_dropped     = 0;
+
+uint8_t log2_floor(uint32_t v) {
+    uint8_t r = 0;
+    while (v > 1) {
+        v >>= 1;
+        ++r;
+    }
+    return r;
+}
+
+// out drives S0/S1 from the select pattern (autopulled), y holds the
+// settle count, and the pushed word is the START_ONCE bit for the trigger
+// DMA. The nop covers the conversion, so the mux never moves while the ADC
+// is sampling.
+bool program_start(uint32_t settle_cycles) {
+    g_insns[0] = pio_encode_out(pio_pins, 2);
+    g_insns[1] = pio_encode_mov(pio_x, pio_y);
+    g_insns[2] = pio_encode_jmp_x_dec(2);
+    g_insns[3] = pio_encode_set(pio_x, ADC_CS_START_ONCE_BITS);
+    g_insns[4] = pio_encode_mov(pio_isr, pio_x);
+    g_insns[5] = pio_encode_push(false, true);
+    g_insns[6] = pio_encode_nop() | pio_encode_delay(kConvertCycles - 2);
+
+    g_program = {};
+    g_program.instructions = g_insns;
+    g_program.length = count_of(g_insns);
+    g_program.origin = -1;
+    if (!pio_claim_free_sm_and_add_program(&g_program, &g_pio, &g_sm, &g_offset)) {
+        return false;
+    }
+
+    pio_sm_config c = pio_get_default_sm_config();
+    sm_config_set_out_pins(&c, kPotMuxS0Pin, 2);
+    sm_config_set_out_shift(&c, true, true, 2 * kSelectsPerWord);
+    sm_config_set_clkdiv(&c, static_cast<float>(clock_get_hz(clk_sys)) / kPioHz);
+    sm_config_set_wrap(&c, g_offset, g_offset + g_program.length - 1);
+    pio_sm_init(g_pio, g_sm, g_offset, &c);
+
+    uint32_t pins = (1u << kPotMuxS0Pin) | (1u << kPotMuxS1Pin);
+    pio_sm_set_pins_with_mask(g_pio, g_sm, 0, pins);
+    pio_sm_set_pindirs_with_mask(g_pio, g_sm, pins, pins);
+    pio_gpio_init(g_pio, kPotMuxS0Pin);
+    pio_gpio_init(g_pio, kPotMuxS1Pin);
+
+    // Load y, then empty the OSR so the first out autopulls a pattern.
+    pio_sm_put(g_pio, g_sm, settle_cycles);
+    pio_sm_exec(g_pio, g_sm, pio_encode_pull(false, true));
+    pio_sm_exec(g_pio, g_sm, pio_encode_mov(pio_y, pio_osr));
+    pio_sm_exec(g_pio, g_sm, pio_encode_out(pio_null, 32));
+    return true;
+}
+
+void program_stop() {
+    pio_sm_set_enabled(g_pio, g_sm, false);
+    gpio_set_function(kPotMuxS0Pin, GPIO_FUNC_SIO);
+    gpio_set_function(kPotMuxS1Pin, GPIO_FUNC_SIO);
+    pio_remove_program_and_unclaim_sm(&g_program, g_pio, g_sm, g_offset);
+    g_pio = nullptr;
+}
+
+void dma_configure() {
+    uint ch = static_cast<uint>(g_dma_select);
+    dma_channel_config c = dma_channel_get_default_config(ch);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, pio_get_dreq(g_pio, g_sm, true));
+    dma_channel_configure(ch, &c, &g_pio->txf[g_sm], &g_select_word, kTransferCount, false);
+
+    ch = static_cast<uint>(g_dma_trigger);
+    c = dma_channel_get_default_config(ch);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, pio_get_dreq(g_pio, g_sm, false));
+    dma_channel_configure(ch, &c, hw_set_alias(&adc_hw->cs), &g_pio->rxf[g_sm], kTransferCount,
+                          false);
+
+    ch = static_cast<uint>(g_dma_result);
+    c = dma_channel_get_default_config(ch);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_ring(&c, true, log2_floor(sizeof(g_ring)));
+    channel_config_set_dreq(&c, DREQ_ADC);
+    dma_channel_configure(ch, &c, g_ring, &adc_hw->fifo, kTransferCount, false);
+}
+
+void release_resources() {
+    // Triggers first, so no conversion starts while the rest winds down.
+    int* channels[] = {&g_dma_trigger, &g_dma_select, &g_dma_result};
+    for (int* ch : channels) {
+        if (*ch < 0) continue;
+        dma_channel_abort(static_cast<uint>(*ch));
+        dma_channel_unclaim(static_cast<uint>(*ch));
+        *ch = -1;
+    }
+    if (g_pio != nullptr) program_stop();
+}
+
+uint64_t DIAG_HOT_FUNC(written)() {
+    uint32_t left = dma_channel_hw_addr(static_cast<uint>(g_dma_result))->transfer_count;
+    return g_base + (kTransferCount - left);
+}
+
+}  // namespace
+
+bool pot_scan_start(uint32_t settle_ns) {
+    pot_scan_stop();
+
+    double cycle_ns = 1e9 / kPioHz;
+    auto cycles = static_cast<uint32_t>((settle_ns + cycle_ns - 1) / cycle_ns);
+    uint32_t count = cycles > kSettleOverhead ? cycles - kSettleOverhead : 0;
+
+    g_dma_select = dma_claim_unused_channel(false);
+    g_dma_trigger = dma_claim_unused_channel(false);
+    g_dma_result = dma_claim_unused_channel(false);
+    if (g_dma_select < 0 || g_dma_trigger < 0 || g_dma_result < 0 || !program_start(count)) {
+        release_resources();
+        return false;
+    }
+
+    g_select_word = 0;
+    for (uint32_t i = 0; i < kSelectsPerWord; ++i) {
+        g_select_word |= (i % kPotScanPots) << (2 * i);
+    }
+    g_settle_ns = static_cast<uint32_t>((count + kSettleOverhead) * cycle_ns);
+    g_rate_hz = static_cast<uint32_t>(kPioHz / (count + kSettleOverhead + kConvertCycles));
+
+    // One-shot conversions of the wiper input, results through the FIFO.
+    adc_run(false);
+    adc_select_input(kPotMuxAdcInput);
+    adc_set_round_robin(0);
+    adc_set_clkdiv(0);
+    adc_fifo_setup(true, true, 1, false, false);
+    adc_fifo_drain();
+
+    g_base = 0;
+    g_read = 0;
+    g_dropped = 0;
+    dma_configure();
+    dma_channel_start(static_cast<uint>(g_dma_result));
+    dma_channel_start(static_cast<uint>(g_dma_trigger));
+    dma_channel_start(static_cast<uint>(g_dma_select));
+    g_active = true;
+    pio_sm_set_enabled(g_pio, g_sm, true);
+    return true;
+}
+
+void pot_scan_stop() {
+    if (!g_active) return;
+    g_active = false;
+    pio_sm_set_enabled(g_pio, g_sm, false);
+    release_resources();
+    while (!(adc_hw->cs & ADC_CS_READY_BITS)) {
+        tight_loop_contents();
+    }
+    // Back to what the SDK expects: single conversions, no FIFO.
+    adc_fifo_setup(false, false, 0, false, false);
+    adc_fifo_drain();
+}
+
+bool pot_scan_active() {
+    return g_active;
+}
+
+uint32_t pot_scan_settle_ns() {
+    return g_settle_ns;
+}
+
+uint32_t pot_scan_rate_hz() {
+    return g_rate_hz;
+}
+
+size_t DIAG_HOT_FUNC(pot_scan_read)(uint16_t* values, size_t max, uint64_t& first) {
+    if (!g_active) return 0;
+    uint64_t end = written();
+    if (end - g_read > kRingSamples / 2) {
+        // The DMA may be writing just behind the oldest half; skip it.
+        uint64_t skip = end - g_read - kRingSamples / 2;
+        g_dropped += static_cast<uint32_t>(skip);
+        g_read += skip;
+    }
+    first = g_read;
+    size_t n = 0;
+    while (n < max && g_read < end) {
+        values[n++] = g_ring[g_read % kRingSamples];
+        ++g_read;
+    }
+    return n;
+}
+
+uint32_t pot_scan_dropped() {
+    return g_dropped;
+}
+
+void pot_scan_service() {
+    if (!g_active) return;
+    // The trigger count runs out with the result count, which stalls the
+    // PIO on its push until both are re-armed. The ring carries on where
+    // it was, so sample indices stay continuous.
+    if (!dma_channel_is_busy(static_cast<uint>(g_dma_result))) {
+        g_base += kTransferCount;
+        dma_channel_set_trans_count(static_cast<uint>(g_dma_result), kTransferCount, true);
+        dma_channel_set_trans_count(static_cast<uint>(g_dma_trigger), kTransferCount, true);
+    }
+    if (!dma_channel_is_busy(static_cast<uint>(g_dma_select))) {
+        dma_channel_set_trans_count(static_cast<uint>(g_dma_select), kTransferCount, true);
+    }
+}
+
+// kTestPotScan.
+namespace {
+
+constexpr uint32_t kReferenceSettleNs = 100000;
+constexpr uint32_t kCandidatesNs[] = {500,  1000,  1500,  2000,  3000,  4000, 6000,
+                                      8000, 12000, 16000, 24000, 32000, 48000};
+constexpr uint32_t kCandidateCount = sizeof(kCandidatesNs) / sizeof(kCandidatesNs[0]);
+constexpr uint32_t kSkipScans      = 4;    // the mux and the ADC settle in
+constexpr uint32_t kMeasureScans   = 256;
+constexpr int32_t  kTolCounts      = 8;
+constexpr int32_t  kMinSpread      = 1000;
+constexpr uint32_t kReportMs       = 1000;
+constexpr size_t   kReadChunk      = 64;
+
+enum Phase : uint8_t {
+    kPhaseStart = 0,
+    kPhaseReference,
+    kPhaseTune,
+    kPhaseRun,
+    kPhaseDone,
+};
+
+struct PotStats {
+    int64_t  sum;
+    uint32_t n;
+    int32_t  min;
+    int32_t  max;
+};
+
+Phase    g_phase      = kPhaseDone;
+PotStats g_stats[kPotScanPots];
+double   g_ref[kPotScanPots];
+int32_t  g_ref_noise  = 0;
+uint32_t g_candidate  = 0;
+bool     g_ok[kCandidateCount];
+uint32_t g_report_ms  = 0;
+uint16_t g_latest[kPotScanPots];
+uint32_t g_samples    = 0;  // since the last report
+
+void clear_stats() {
+    for (PotStats& p : g_stats) p = {0, 0, INT32_MAX, INT32_MIN};
+}
+
+// Feeds one settle delay's worth of samples into g_stats; true once
+// kMeasureScans full scans past the first kSkipScans are in.
+bool collect() {
+    constexpr uint64_t kFirst = kSkipScans * kPotScanPots;
+    constexpr uint64_t kEnd = kFirst + kMeasureScans * kPotScanPots;
+    uint16_t buf[kReadChunk];
+    uint64_t first = 0;
+    size_t n;
+    while ((n = pot_scan_read(buf, kReadChunk, first)) > 0) {
+        for (size_t i = 0; i < n; ++i) {
+            uint64_t index = first + i;
+            if (index < kFirst || index >= kEnd) continue;
+            PotStats& p = g_stats[index % kPotScanPots];
+            int32_t x = buf[i];
+            p.sum += x;
+            ++p.n;
+            if (x < p.min) p.min = x;
+            if (x > p.max) p.max = x;
+        }
+        if (first + n >= kEnd) return true;
+    }
+    return false;
+}
+
+double mean(const PotStats& p) {
+    return p.n > 0 ? static_cast<double>(p.sum) / p.n : 0.0;
+}
+
+bool start_or_fail(uint32_t settle_ns) {
+    clear_stats();
+    if (pot_scan_start(settle_ns)) return true;
+    printf("potscan error=start-failed\n");
+    g_phase = kPhaseDone;
+    return false;
+}
+
+void finish_reference() {
+    int32_t lo = INT32_MAX, hi = INT32_MIN;
+    g_ref_noise = 0;
+    for (uint8_t i = 0; i < kPotScanPots; ++i) {
+        const PotStats& p = g_stats[i];
+        g_ref[i] = mean(p);
+        auto m = static_cast<int32_t>(g_ref[i]);
+        int32_t dev = p.max - m > m - p.min ? p.max - m : m - p.min;
+        if (dev > g_ref_noise) g_ref_noise = dev;
+        if (m < lo) lo = m;
+        if (m > hi) hi = m;
+    }
+    printf("potscan reference pot1=%.0f pot2=%.0f pot3=%.0f noise=%ld spread=%ld\n", g_ref[0],
+           g_ref[1], g_ref[2], static_cast<long>(g_ref_noise), static_cast<long>(hi - lo));
+    if (hi - lo < kMinSpread) printf("potscan warning=pots-too-close\n");
+}
+
+void finish_candidate() {
+    double err = 0.0;
+    for (uint8_t i = 0; i < kPotScanPots; ++i) {
+        double lo = g_ref[i] - g_stats[i].min;
+        double hi = g_stats[i].max - g_ref[i];
+        if (lo > err) err = lo;
+        if (hi > err) err = hi;
+    }
+    g_ok[g_candidate] = err <= g_ref_noise + kTolCounts;
+    printf("potscan tune settle_ns=%lu err=%.0f ok=%u\n",
+           static_cast<unsigned long>(pot_scan_settle_ns()), err, g_ok[g_candidate] ? 1u : 0u);
+}
+
+// Shortest candidate from which every longer one passed too; 0 if even
+// the longest failed.
+uint32_t min_ok_ns() {
+    uint32_t best = 0;
+    for (uint32_t i = kCandidateCount; i-- > 0;) {
+        if (!g_ok[i]) break;
+        best = kCandidatesNs[i];
+    }
+    return best;
+}
+
+}  // namespace
+
+void pot_scan_enter(Brain& /*brain*/) {
+    g_phase = kPhaseStart;
+}
+
+void DIAG_HOT_FUNC(pot_scan_run)(Brain& /*brain*/, uint32_t now_ms) {
+    switch (g_phase) {
+        case kPhaseStart:
+            if (start_or_fail(kReferenceSettleNs)) g_phase = kPhaseReference;
+            break;
+
+        case kPhaseReference:
+            if (!collect()) break;
+            finish_reference();
+            g_candidate = 0;
+            if (start_or_fail(kCandidatesNs[0])) g_phase = kPhaseTune;
+            break;
+
+        case kPhaseTune: {
+            if (!collect()) break;
+            finish_candidate();
+            if (++g_candidate < kCandidateCount) {
+                start_or_fail(kCandidatesNs[g_candidate]);
+                break;
+            }
+            uint32_t ok_ns = min_ok_ns();
+            if (ok_ns == 0) {
+                pot_scan_stop();
+                printf("potscan error=unstable\n");
+                g_phase = kPhaseDone;
+                break;
+            }
+            if (!start_or_fail(ok_ns + ok_ns / 4)) break;
+            printf("potscan tuned settle_ns=%lu min_ok_ns=%lu rate_hz=%lu\n",
+                   static_cast<unsigned long>(pot_scan_settle_ns()),
+                   static_cast<unsigned long>(ok_ns),
+                   static_cast<unsigned long>(pot_scan_rate_hz()));
+            g_report_ms = now_ms;
+            g_samples = 0;
+            g_phase = kPhaseRun;
+            break;
+        }
+
+        case kPhaseRun: {
+            pot_scan_service();
+            uint16_t buf[kReadChunk];
+            uint64_t first = 0;
+            size_t n;
+            while ((n = pot_scan_read(buf, kReadChunk, first)) > 0) {
+                for (size_t i = 0; i < n; ++i) g_latest[(first + i) % kPotScanPots] = buf[i];
+                g_samples += static_cast<uint32_t>(n);
+            }
+            if (now_ms - g_report_ms < kReportMs) break;
+            g_report_ms = now_ms;
+            printf("potscan pot1=%u pot2=%u pot3=%u scans=%lu dropped=%lu\n", g_latest[0],
+                   g_latest[1], g_latest[2],
+                   static_cast<unsigned long>(g_samples / kPotScanPots),
+                   static_cast<unsigned long>(pot_scan_dropped()));
+            g_samples = 0;
+            break;
+        }
+
+        case kPhaseDone:
+            break;
+    }
+}
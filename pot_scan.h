@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "tests.h"
+
+// Pot scanning without the CPU.
+//
+// The SDK reads the pots inside Brain::update(): it sets the multiplexer's
+// select lines, waits, and starts a conversion, one pot at a time. Here a
+// PIO state machine does the same in hardware. It drives S0/S1 from a
+// repeating select pattern, counts out the settle delay, then pushes the
+// ADC's START_ONCE bit, which a DMA channel writes to the ADC's control
+// register. A second DMA channel moves each result from the ADC FIFO into
+// a ring. Each step is
+//
+//   settle_ns + 3.1 us (conversion and fixed instructions)
+//
+// so the scan rate is set by the settle delay alone.
+//
+// While scanning, the scanner owns the ADC and the select lines, and the
+// main loop skips Brain::update(); buttons are not read.
+
+constexpr uint8_t kPotScanPots = 3;  // mux positions 0-2 = pots 1-3
+
+// Starts scanning with at least `settle_ns` between switching the mux and
+// starting the conversion (rounded up to the PIO's 100 ns grid). Stops any
+// scan already running. Returns false if no PIO state machine or DMA
+// channel is free.
+bool pot_scan_start(uint32_t settle_ns);
+void pot_scan_stop();
+bool pot_scan_active();
+
+// Settle delay actually programmed, and the resulting conversion rate
+// (all pots together).
+uint32_t pot_scan_settle_ns();
+uint32_t pot_scan_rate_hz();
+
+// Copies up to `max` samples converted since the last call. Sample k is
+// the reading of pot (first + k) % kPotScanPots. Samples the caller fell
+// more than the ring behind on are skipped and counted in
+// pot_scan_dropped().
+size_t pot_scan_read(uint16_t* values, size_t max, uint64_t& first);
+uint32_t pot_scan_dropped();
+
+// Restarts the DMA when its (very long) transfer count runs out. Call
+// regularly.
+void pot_scan_service();
+
+// kTestPotScan: finds the shortest settle delay that still reads the pots
+// correctly, then scans with it. Set the pots far apart (e.g. 1 fully
+// anticlockwise, 2 centred, 3 fully clockwise) and leave them alone while
+// it tunes: too short a delay shows up as a reading pulled towards the
+// previous pot's.
+//
+// A reference is taken at a 100 us settle, then each candidate delay is
+// compared against it:
+//
+//   potscan reference pot1=<counts> pot2=<counts> pot3=<counts> noise=<counts> spread=<counts>
+//   potscan tune settle_ns=<ns> err=<counts> ok=<0|1>
+//   potscan tuned settle_ns=<ns> min_ok_ns=<ns> rate_hz=<hz>
+//
+// err is the largest distance of any reading from its pot's reference
+// mean; a delay is ok if err stays within the reference's own noise plus 8
+// counts. min_ok_ns is the shortest delay from which every longer one is
+// ok too, and the scan runs with a quarter on top. After that, once a
+// second, 12-bit readings:
+//
+//   potscan pot1=<counts> pot2=<counts> pot3=<counts> scans=<n> dropped=<n>
+//
+// A spread below 1000 counts means the pots were too close together for
+// the tuning to see anything, and is flagged with
+//
+//   potscan warning=pots-too-close
+void pot_scan_enter(Brain& brain);
+void pot_scan_run(Brain& brain, uint32_t now_ms);
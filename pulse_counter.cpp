@@ -0,0 +1,130 @@
+#include "pulse_counter.h"
+
+#include "hardware/clocks.h"
+#include "hardware/pio.h"
+#include "pico/stdlib.h"
+
+#include "brain_pins.h"
+#include "hot_path.h"
+
+namespace {
+
+// Cycles per period are 2 per decrement plus this much loop overhead; see
+// program_start().
+constexpr uint32_t kLoopOverhead = 6;
+
+PIO           g_pio    = nullptr;
+uint          g_sm     = 0;
+uint          g_offset = 0;
+uint16_t      g_insns[8];
+pio_program_t g_program;
+
+bool        g_active     = false;
+bool        g_skip_first = true;
+uint32_t    g_sys_hz     = 0;
+uint64_t    g_gate       = 0;  // cycles
+uint32_t    g_gate_ms    = 0;
+uint64_t    g_sum        = 0;
+uint32_t    g_count      = 0;
+uint32_t    g_gate_start_ms = 0;
+FreqReading g_reading;
+
+// x counts down from ~0 while the pin is high, then while it is low, two
+// cycles per decrement; on the rising edge it is pushed and reset. One
+// period is therefore 2 * (~0 - x) + kLoopOverhead cycles, the overhead
+// being the three edge instructions, the reset and the two loop exits.
+bool program_start() {
+    g_insns[0] = pio_encode_mov_not(pio_x, pio_null);
+    g_insns[1] = pio_encode_jmp_pin(3);     // high: keep counting
+    g_insns[2] = pio_encode_jmp(4);         // fell: count the low half
+    g_insns[3] = pio_encode_jmp_x_dec(1);
+    g_insns[4] = pio_encode_jmp_pin(6);     // rose: period done
+    g_insns[5] = pio_encode_jmp_x_dec(4);
+    g_insns[6] = pio_encode_mov(pio_isr, pio_x);
+    g_insns[7] = pio_encode_push(false, false);
+
+    g_program = {};
+    g_program.instructions = g_insns;
+    g_program.length = count_of(g_insns);
+    g_program.origin = -1;
+    if (!pio_claim_free_sm_and_add_program(&g_program, &g_pio, &g_sm, &g_offset)) {
+        return false;
+    }
+
+    pio_sm_config c = pio_get_default_sm_config();
+    sm_config_set_jmp_pin(&c, kPulseInPin);
+    sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_RX);
+    sm_config_set_wrap(&c, g_offset, g_offset + g_program.length - 1);
+    pio_sm_init(g_pio, g_sm, g_offset, &c);
+    pio_sm_set_enabled(g_pio, g_sm, true);
+    return true;
+}
+
+void finish_gate() {
+    g_reading.valid = g_count > 0;
+    g_reading.periods = g_count;
+    g_reading.hz = g_count > 0 ? static_cast<double>(g_count) * g_sys_hz / g_sum : 0.0;
+    g_reading.pkpk = 0;
+    g_sum = 0;
+    g_count = 0;
+    g_gate_start_ms = to_ms_since_boot(get_absolute_time());
+}
+
+}  // namespace
+
+bool pulse_counter_start(uint32_t gate_ms) {
+    pulse_counter_stop();
+    if (!program_start()) return false;
+    g_sys_hz = clock_get_hz(clk_sys);
+    g_gate = static_cast<uint64_t>(g_sys_hz) * gate_ms / 1000;
+    g_gate_ms = gate_ms;
+    g_sum = 0;
+    g_count = 0;
+    g_skip_first = true;
+    g_reading = FreqReading{};
+    g_gate_start_ms = to_ms_since_boot(get_absolute_time());
+    g_active = true;
+    return true;
+}
+
+void pulse_counter_stop() {
+    if (!g_active) return;
+    g_active = false;
+    pio_sm_set_enabled(g_pio, g_sm, false);
+    pio_remove_program_and_unclaim_sm(&g_program, g_pio, g_sm, g_offset);
+    g_pio = nullptr;
+}
+
+bool pulse_counter_active() {
+    return g_active;
+}
+
+bool DIAG_HOT_FUNC(pulse_counter_service)() {
+    if (!g_active) return false;
+    bool completed = false;
+    while (!pio_sm_is_rx_fifo_empty(g_pio, g_sm)) {
+        uint32_t x = pio_sm_get(g_pio, g_sm);
+        // The first count started mid-period.
+        if (g_skip_first) {
+            g_skip_first = false;
+            continue;
+        }
+        g_sum += 2ull * (0xFFFFFFFFu - x) + kLoopOverhead;
+        ++g_count;
+        if (g_sum >= g_gate) {
+            finish_gate();
+            completed = true;
+        }
+    }
+    uint32_t now = to_ms_since_boot(get_absolute_time());
+    if (!completed && now - g_gate_start_ms >= 2 * g_gate_ms) {
+        // Too slow or no signal: report what there is, if anything.
+        finish_gate();
+        completed = true;
+    }
+    return completed;
+}
+
+const FreqReading& pulse_counter_reading() {
+    return g_reading;
+}
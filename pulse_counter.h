@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+
+#include "freq_counter.h"
+
+// Reciprocal frequency counter on the pulse input.
+//
+// A PIO state machine measures every period of the pulse input in system
+// clock cycles, rising edge to rising edge, with no dead time between
+// periods, and pushes each count to its FIFO. A gate sums whole periods
+// until the gate time is covered and reports periods / total time, so
+// resolution is two clock cycles over the whole gate. Periods lost to a
+// full FIFO are left out of both sums and don't bias the result.
+//
+// Unlike the CV-input counter this leaves the ADC alone, so the SDK keeps
+// running normally.
+
+bool pulse_counter_start(uint32_t gate_ms);
+void pulse_counter_stop();
+bool pulse_counter_active();
+
+// Drains the FIFO. Returns true each time a gate completes; a gate with
+// no edges completes as invalid after twice the gate time.
+bool pulse_counter_service();
+
+const FreqReading& pulse_counter_reading();
@@ -0,0 +1,82 @@
+#include "pulse_pwm.h"
+
+#include <cmath>
+
+#include "hardware/clocks.h"
+#include "hardware/gpio.h"
+#include "hardware/pwm.h"
+
+#include "brain_pins.h"
+#include "cycle_counter.h"
+
+namespace {
+
+struct PwmSaved {
+    uint32_t csr;
+    uint32_t div;
+    uint32_t ctr;
+    uint32_t cc;
+    uint32_t top;
+};
+
+bool     g_active       = false;
+uint     g_slice        = 0;
+PwmSaved g_saved;
+double   g_freq_hz      = 0.0;
+uint32_t g_start_cycles = 0;
+
+}  // namespace
+
+bool pulse_pwm_start(double freq_hz) {
+    pulse_pwm_stop();
+    if (freq_hz <= 0.0) return false;
+    uint32_t sys_hz = clock_get_hz(clk_sys);
+    auto counts = static_cast<uint32_t>(std::lround(sys_hz / freq_hz));
+    if (counts < 2) return false;
+    uint32_t div = (counts + 0xFFFF) / 0x10000;
+    if (div < 1) div = 1;
+    if (div > 255) return false;
+    uint32_t top = counts / div - 1;
+
+    g_slice = pwm_gpio_to_slice_num(kPulseOutPin);
+    pwm_slice_hw_t& hw = pwm_hw->slice[g_slice];
+    g_saved = {hw.csr, hw.div, hw.ctr, hw.cc, hw.top};
+
+    pwm_set_enabled(g_slice, false);
+    pwm_set_clkdiv_int_frac(g_slice, static_cast<uint8_t>(div), 0);
+    pwm_set_wrap(g_slice, static_cast<uint16_t>(top));
+    pwm_set_gpio_level(kPulseOutPin, static_cast<uint16_t>((top + 1) / 2));
+    pwm_set_counter(g_slice, 0);
+    gpio_set_function(kPulseOutPin, GPIO_FUNC_PWM);
+    g_freq_hz = static_cast<double>(sys_hz) / (div * (top + 1));
+    g_active = true;
+    g_start_cycles = cycle_counter_read();
+    pwm_set_enabled(g_slice, true);
+    return true;
+}
+
+void pulse_pwm_stop() {
+    if (!g_active) return;
+    g_active = false;
+    pwm_set_enabled(g_slice, false);
+    gpio_put(kPulseOutPin, false);
+    gpio_set_function(kPulseOutPin, GPIO_FUNC_SIO);
+    pwm_slice_hw_t& hw = pwm_hw->slice[g_slice];
+    hw.div = g_saved.div;
+    hw.top = g_saved.top;
+    hw.cc = g_saved.cc;
+    hw.ctr = g_saved.ctr;
+    hw.csr = g_saved.csr;
+}
+
+bool pulse_pwm_active() {
+    return g_active;
+}
+
+double pulse_pwm_freq_hz() {
+    return g_freq_hz;
+}
+
+uint32_t pulse_pwm_start_cycles() {
+    return g_start_cycles;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+// Square wave on pulse out from a PWM slice, high for the first half of
+// each period. The slice may be shared with an LED, so its registers are
+// saved on start and put back on stop.
+
+// Starts the wave as close to `freq_hz` as the slice's integer divider
+// allows. Returns false if the frequency is out of reach.
+bool pulse_pwm_start(double freq_hz);
+void pulse_pwm_stop();
+bool pulse_pwm_active();
+
+// The frequency actually running.
+double pulse_pwm_freq_hz();
+
+// cycle_counter_read() just before the slice was enabled, i.e. at the
+// first rising edge (see cycle_counter.h).
+uint32_t pulse_pwm_start_cycles();
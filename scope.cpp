@@ -0,0 +1,255 @@
+#include "scope.h"
+
+#include <cstdio>
+
+#include "pico/stdio.h"
+#include "pico/stdio_usb.h"
+#include "pico/stdlib.h"
+#include "tusb.h"
+
+#include "adc_capture.h"
+#include "brain_pins.h"
+#include "hot_path.h"
+#include "settings.h"
+#include "usb_frame.h"
+
+namespace {
+
+constexpr uint32_t kMaxRateHz     = 500000;
+constexpr uint32_t kMinAutoRateHz = 10000;
+constexpr uint32_t kWindowMs      = 1000;
+constexpr size_t   kHeaderBytes   = 11;
+constexpr size_t   kBlockBytes    = kAdcBlockSamples * sizeof(uint16_t);
+
+// A frame being written, as up to three pieces: the header, the payload
+// where it lies, and the sum.
+struct Piece {
+    const uint8_t* data;
+    size_t         len;
+};
+
+Piece    g_piece[3];
+uint8_t  g_next_piece = 3;  // 3 = nothing left to write
+uint8_t  g_header[kHeaderBytes];
+uint8_t  g_trailer[2];
+uint8_t  g_status[kScopeStatusFields * 4];
+bool     g_block_held = false;
+
+bool     g_started        = false;
+bool     g_active         = false;
+bool     g_auto           = false;
+bool     g_status_pending = false;
+bool     g_restart_pending = false;
+uint8_t  g_slot_a         = 0;
+uint32_t g_rate_hz        = 0;  // requested
+uint32_t g_seq_base       = 0;  // blocks numbered before the current capture
+uint32_t g_seq_next       = 0;  // in the current capture, after the last acquired
+uint32_t g_status_seq     = 0;
+uint32_t g_blocks_sent    = 0;
+uint32_t g_dropped_before = 0;  // dropped by earlier captures
+uint32_t g_window_ms      = 0;
+uint32_t g_window_dropped = 0;
+uint32_t g_window_bytes   = 0;
+uint32_t g_bytes_per_s    = 0;
+uint32_t g_clean_s        = 0;
+
+void put_u16(uint8_t* p, uint32_t v) {
+    p[0] = static_cast<uint8_t>(v);
+    p[1] = static_cast<uint8_t>(v >> 8);
+}
+
+void put_u32(uint8_t* p, uint32_t v) {
+    put_u16(p, v);
+    put_u16(p + 2, v >> 16);
+}
+
+// Reading the payload for its sum is the only pass the CPU makes over it.
+void DIAG_HOT_FUNC(begin_frame)(uint8_t type, uint8_t info, uint32_t seq, const uint8_t* payload,
+                                size_t len) {
+    g_header[0] = kScopeSync0;
+    g_header[1] = kScopeSync1;
+    g_header[2] = type;
+    g_header[3] = info;
+    put_u32(g_header + 4, seq);
+    put_u16(g_header + 8, static_cast<uint32_t>(len));
+    g_header[10] = usb_frame_crc8(g_header, kHeaderBytes - 1);
+
+    uint16_t sum = 0;
+    for (size_t i = 0; i + 1 < len; i += 2) {
+        sum = static_cast<uint16_t>(sum + (payload[i] | payload[i + 1] << 8));
+    }
+    put_u16(g_trailer, sum);
+
+    g_piece[0] = {g_header, kHeaderBytes};
+    g_piece[1] = {payload, len};
+    g_piece[2] = {g_trailer, sizeof(g_trailer)};
+    g_next_piece = 0;
+}
+
+// Hands the CDC FIFO as much of the frame as it has room for, never more,
+// so the loop doesn't wait on the host. Returns true once nothing is left.
+bool DIAG_HOT_FUNC(write_frame)() {
+    while (g_next_piece < 3) {
+        Piece& p = g_piece[g_next_piece];
+        if (p.len == 0) {
+            ++g_next_piece;
+            continue;
+        }
+        uint32_t room = tud_cdc_write_available();
+        if (room == 0) return false;
+        size_t n = p.len < room ? p.len : room;
+        stdio_put_string(reinterpret_cast<const char*>(p.data), static_cast<int>(n), false,
+                         false);
+        p.data += n;
+        p.len -= n;
+        g_window_bytes += n;
+    }
+    return true;
+}
+
+void DIAG_HOT_FUNC(end_frame)() {
+    g_next_piece = 3;
+    if (!g_block_held) return;
+    g_block_held = false;
+    adc_capture_release();
+    ++g_blocks_sent;
+}
+
+uint32_t dropped_total() {
+    return g_dropped_before + (g_active ? adc_capture_dropped() : 0);
+}
+
+void begin_status() {
+    uint32_t fields[kScopeStatusFields] = {
+        g_active ? adc_capture_rate_hz() : 0, g_clean_s, g_blocks_sent, dropped_total(),
+        g_bytes_per_s,
+    };
+    for (uint8_t i = 0; i < kScopeStatusFields; ++i) put_u32(g_status + 4 * i, fields[i]);
+    begin_frame(kScopeStatus, 0, g_status_seq++, g_status, sizeof(g_status));
+}
+
+void stop_capture() {
+    if (!g_active) return;
+    if (g_block_held) {
+        g_block_held = false;
+        adc_capture_release();
+    }
+    g_next_piece = 3;
+    uint32_t seq = 0;
+    // Number the next capture's blocks on from everything this one wrote.
+    while (adc_capture_acquire(seq) != nullptr) {
+        g_seq_next = seq + 1;
+        adc_capture_release();
+    }
+    g_seq_base += g_seq_next;
+    g_seq_next = 0;
+    g_dropped_before += adc_capture_dropped();
+    g_active = false;
+    adc_capture_stop();
+}
+
+bool start_capture() {
+    uint8_t mask = static_cast<uint8_t>((1u << kCvInAAdcInput) | (1u << kCvInBAdcInput));
+    if (!adc_capture_start(mask, g_rate_hz)) return false;
+    adc_capture_set_exclusive(true);
+    g_active = true;
+    g_slot_a = adc_capture_slot(kCvInAAdcInput);
+    g_clean_s = 0;
+    g_window_dropped = adc_capture_dropped();
+    g_status_pending = true;
+    return true;
+}
+
+// Starts the next frame: a due status first, then the oldest block.
+bool DIAG_HOT_FUNC(next_frame)() {
+    if (g_restart_pending) {
+        g_restart_pending = false;
+        stop_capture();
+        if (!start_capture()) return false;
+    }
+    if (g_status_pending) {
+        g_status_pending = false;
+        begin_status();
+        return true;
+    }
+    uint32_t seq = 0;
+    const uint16_t* block = adc_capture_acquire(seq);
+    if (block == nullptr) return false;
+    g_block_held = true;
+    g_seq_next = seq + 1;
+    begin_frame(kScopeSamples, g_slot_a, g_seq_base + seq,
+                reinterpret_cast<const uint8_t*>(block), kBlockBytes);
+    return true;
+}
+
+void DIAG_HOT_FUNC(service)() {
+    if (!stdio_usb_connected()) {
+        // Nobody is reading: let the capture run on and drop.
+        if (g_block_held) end_frame();
+        g_next_piece = 3;
+        return;
+    }
+    while (write_frame()) {
+        end_frame();
+        if (!g_active || !next_frame()) return;
+    }
+}
+
+void end_window() {
+    uint32_t dropped = adc_capture_dropped();
+    bool clean = dropped == g_window_dropped;
+    g_window_dropped = dropped;
+    g_bytes_per_s = g_window_bytes;
+    g_window_bytes = 0;
+    if (clean) {
+        ++g_clean_s;
+    } else if (g_auto && stdio_usb_connected() && g_rate_hz > kMinAutoRateHz) {
+        g_rate_hz = g_rate_hz / 5 * 4;
+        if (g_rate_hz < kMinAutoRateHz) g_rate_hz = kMinAutoRateHz;
+        g_restart_pending = true;
+        return;
+    } else {
+        g_clean_s = 0;
+    }
+    g_status_pending = true;
+}
+
+}  // namespace
+
+void scope_enter(Brain& /*brain*/) {
+    g_started = false;
+}
+
+void scope_stop() {
+    stop_capture();
+    g_status_pending = false;
+    g_restart_pending = false;
+}
+
+void DIAG_HOT_FUNC(scope_run)(Brain& /*brain*/, uint32_t now_ms) {
+    if (!g_started) {
+        g_started = true;
+        auto hz = static_cast<uint32_t>(setting(kSettingScopeHz));
+        g_auto = hz == 0;
+        g_rate_hz = g_auto ? kMaxRateHz : hz;
+        g_seq_base = 0;
+        g_seq_next = 0;
+        g_status_seq = 0;
+        g_blocks_sent = 0;
+        g_dropped_before = 0;
+        g_window_bytes = 0;
+        g_bytes_per_s = 0;
+        g_window_ms = now_ms;
+        g_restart_pending = false;
+        if (!start_capture()) {
+            printf("scope error=start-failed\n");
+            return;
+        }
+    }
+    if (!g_active) return;
+    if (now_ms - g_window_ms >= kWindowMs) {
+        g_window_ms = now_ms;
+        end_window();
+    }
+    service();
+}
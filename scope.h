@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+
+#include "tests.h"
+
+// kTestScope: both CV inputs streamed raw over USB, for looking at a CV
+// signal on a laptop (host/brain-scope) instead of an oscilloscope.
+//
+// adc_capture converts CV A and CV B in round-robin at scope_hz (a
+// setting, both inputs together, up to the ADC's 500 kHz). Every block
+// the DMA completes is written from the capture ring to the CDC port as it
+// lies: the 512 12-bit samples, interleaved A/B, are neither copied nor
+// re-encoded. The block is released back to the capture only once the
+// last byte is in the USB stack's FIFO.
+//
+// Frames, little-endian:
+//
+//   0xA5 0x5C <type> <info> <seq, u32> <len, u16> <crc8> <payload, len bytes> <sum, u16>
+//
+// crc8 (polynomial 0x07, initial 0, as in usb_frame.h) covers the nine
+// header bytes before it, and sum is the 16-bit sum of the payload's
+// 16-bit words. A header that checks out with a payload that doesn't means
+// console text landed inside the frame, or the capture overtook a block
+// that was still being sent.
+//
+//   type 1, samples: seq numbers the capture blocks, so a gap is blocks
+//     the capture dropped because USB fell behind. info is the position
+//     of CV A in each A/B pair. The payload is kAdcBlockSamples samples.
+//   type 2, status: rate_hz (both inputs), clean_s, blocks sent, blocks
+//     dropped, bytes/s over the last second, each a u32. clean_s counts
+//     the seconds in a row without a dropped block at this rate.
+//     Sent at start, after every rate change, and once a second.
+//
+// With scope_hz at 0 the mode finds the sustained rate itself: it starts
+// at 500 kHz and, after every second that dropped a block, restarts the
+// capture a fifth slower. Blocks are numbered on across a restart, but the
+// samples either side of it aren't contiguous; the status frame sent
+// before the first block at the new rate marks the boundary.
+
+// Frame constants shared with the host decoder.
+constexpr uint8_t kScopeSync0       = 0xA5;
+constexpr uint8_t kScopeSync1       = 0x5C;
+constexpr uint8_t kScopeSamples     = 1;
+constexpr uint8_t kScopeStatus      = 2;
+constexpr uint8_t kScopeStatusFields = 5;
+
+void scope_enter(Brain& brain);
+void scope_run(Brain& brain, uint32_t now_ms);
+
+// Stops the capture. Called on every test change.
+void scope_stop();
@@ -0,0 +1,116 @@
+#include "sdk_bench.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "hardware/clocks.h"
+
+#include "console.h"
+#include "cycle_counter.h"
+
+namespace {
+
+constexpr uint32_t kSamples = 255;  // odd, so the median is a sample
+
+constexpr uint8_t  kMidiBytes[] = {0x90, 60, 100, 0x80, 60, 0};  // note on, note off
+constexpr uint32_t kMidiByteCount = sizeof(kMidiBytes);
+
+uint32_t g_samples[kSamples];
+uint32_t g_overhead = 0;
+bool     g_done     = false;
+
+// Runs `fn` kSamples times, timing each call separately, and reports the
+// distribution. Interrupts stay enabled: the max column deliberately
+// includes whatever preemption the real loop would see.
+template <typename Fn>
+void bench(const char* name, Fn&& fn) {
+    for (uint32_t i = 0; i < kSamples; ++i) {
+        uint32_t t0 = cycle_counter_read();
+        fn(i);
+        uint32_t t1 = cycle_counter_read();
+        uint32_t cycles = cycle_counter_elapsed(t0, t1);
+        g_samples[i] = cycles > g_overhead ? cycles - g_overhead : 0;
+    }
+    std::sort(g_samples, g_samples + kSamples);
+    printf("bench call=%s min=%lu median=%lu max=%lu\n", name,
+           static_cast<unsigned long>(g_samples[0]),
+           static_cast<unsigned long>(g_samples[kSamples / 2]),
+           static_cast<unsigned long>(g_samples[kSamples - 1]));
+}
+
+void measure_overhead() {
+    g_overhead = 0;
+    uint32_t best = UINT32_MAX;
+    for (uint32_t i = 0; i < kSamples; ++i) {
+        uint32_t t0 = cycle_counter_read();
+        uint32_t t1 = cycle_counter_read();
+        best = std::min(best, cycle_counter_elapsed(t0, t1));
+    }
+    g_overhead = best;
+}
+
+}  // namespace
+
+void sdk_bench_enter(Brain& brain) {
+    ensure_calibration_loaded(brain);
+    brain.outputs.set_output_range(kOutputsChannelA, kOutputsRangeMinus5To5V);
+    g_done = false;
+}
+
+void sdk_bench_run(Brain& brain, uint32_t /*now_ms*/) {
+    if (g_done) return;
+    g_done = true;
+
+    measure_overhead();
+    printf("bench_info platform=%s sdk=%s clk_sys_hz=%lu samples=%lu overhead=%lu\n",
+           kPlatformName, BRAIN_DIAG_SDK_REVISION,
+           static_cast<unsigned long>(clock_get_hz(clk_sys)),
+           static_cast<unsigned long>(kSamples), static_cast<unsigned long>(g_overhead));
+
+    // Arguments vary with the sample index so no call can be short-circuited
+    // by an "unchanged value" check inside the SDK.
+    bench("leds.set_brightness", [&](uint32_t i) {
+        brain.leds.set_brightness(static_cast<uint8_t>(i % 6), static_cast<uint8_t>(i));
+    });
+    bench("pots.get_buffered", [&](uint32_t i) {
+        volatile uint16_t v = brain.pots.get_buffered(static_cast<uint8_t>(i % 3));
+        (void)v;
+    });
+    bench("inputs.get_voltage_millivolts", [&](uint32_t i) {
+        volatile int32_t v = brain.inputs.get_voltage_millivolts(
+            (i & 1u) ? kInputsChannelB : kInputsChannelA);
+        (void)v;
+    });
+    bench("inputs.pulse_read", [&](uint32_t) {
+        volatile bool v = brain.inputs.pulse_read();
+        (void)v;
+    });
+    bench("outputs.set_voltage_millivolts", [&](uint32_t i) {
+        brain.outputs.set_voltage_millivolts(kOutputsChannelA,
+            static_cast<int32_t>(i * 37 % 10000) - 5000);
+    });
+    bench("outputs.set_voltage_calibrated_millivolts", [&](uint32_t i) {
+        brain.outputs.set_voltage_calibrated_millivolts(kOutputsChannelA,
+            static_cast<int32_t>(i * 37 % 10000) - 5000);
+    });
+    bench("outputs.pulse_set", [&](uint32_t i) {
+        brain.outputs.pulse_set((i & 1u) != 0);
+    });
+    // The receive interrupt owns the UART (midi_rx.h), so process_uart()
+    // would only time an empty poll. Feed the parser a note-on/note-off
+    // pair instead; the callbacks it makes are part of the cost.
+    bench("midi_parser.process_byte", [&](uint32_t i) {
+        brain.midi_parser.process_byte(kMidiBytes[i % kMidiByteCount]);
+    });
+    // Finish the last message, so no note is left held.
+    for (uint32_t i = kSamples; i % kMidiByteCount != 0; ++i) {
+        brain.midi_parser.process_byte(kMidiBytes[i % kMidiByteCount]);
+    }
+    bench("brain.update", [&](uint32_t) {
+        brain.update();
+    });
+
+    brain.outputs.set_voltage_millivolts(kOutputsChannelA, 0);
+    brain.outputs.pulse_set(false);
+    printf("bench_done\n");
+}
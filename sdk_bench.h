@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+
+#include "tests.h"
+
+// kTestSdkBench: times each Brain SDK call the tests rely on under the
+// SysTick cycle counter and prints min / median / max cycles per call.
+// Runs once per entry, after the test indicator clears. Output:
+//
+//   bench_info platform=<p> sdk=<rev> clk_sys_hz=<hz> samples=<n> overhead=<cycles>
+//   bench call=<name> min=<cycles> median=<cycles> max=<cycles>
+//   ...
+//   bench_done
+//
+// Cycle counts have the measurement overhead already subtracted.
+void sdk_bench_enter(Brain& brain);
+void sdk_bench_run(Brain& brain, uint32_t now_ms);
@@ -0,0 +1,91 @@
+#include "settings.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+struct SettingInfo {
+    const char* name;
+    int32_t     min;
+    int32_t     max;
+    int32_t     initial;
+};
+
+constexpr SettingInfo kSettings[kSettingCount] = {
+    {"cic_decimation", 4, 256, 64},
+    {"lockin_ref", 0, 2, 0},
+    {"lockin_mv", 1, 5000, 1000},
+    {"lockin_ms", 10, 60000, 1000},
+    {"freq_gate_ms", 10, 10000, 1000},
+    {"vco_out", 0, 1, 0},
+    {"vco_in", 0, 2, 0},
+    {"vco_octaves", 1, 10, 5},
+    {"midi_stuck_ms", 100, 600000, 5000},
+    {"telemetry_hz", 1, 20000, 1000},
+    {"telemetry_cv_a_mv", -5000, 5000, 0},
+    {"telemetry_cv_b_mv", -5000, 5000, 0},
+    {"wd_test_ms", 100, 8000, 5000},
+    {"burn_report_s", 10, 86400, 600},
+    {"drift_a_mv", -5000, 5000, 4000},
+    {"drift_b_mv", -5000, 5000, -4000},
+    {"drift_period_s", 1, 3600, 10},
+    {"pot_jitter_max", 1, 4095, 3},
+    {"pot_drift_max", 1, 4095, 8},
+    {"event_bus", 0, 1, 1},
+    {"scope_hz", 0, 500000, 0},
+    {"logic_hz", 5000, 25000000, 1000000},
+    {"logic_burst", 0, 1, 0},
+    {"logic_trigger", 0, 5, 0},
+    {"logic_pulse_hz", 0, 100000, 0},
+};
+
+int32_t g_values[kSettingCount] = {
+    kSettings[kSettingCicDecimation].initial,
+    kSettings[kSettingLockInRef].initial,
+    kSettings[kSettingLockInMv].initial,
+    kSettings[kSettingLockInMs].initial,
+    kSettings[kSettingFreqGateMs].initial,
+    kSettings[kSettingVcoOut].initial,
+    kSettings[kSettingVcoIn].initial,
+    kSettings[kSettingVcoOctaves].initial,
+    kSettings[kSettingMidiStuckMs].initial,
+    kSettings[kSettingTelemetryHz].initial,
+    kSettings[kSettingTelemetryCvAMv].initial,
+    kSettings[kSettingTelemetryCvBMv].initial,
+    kSettings[kSettingWatchdogTestMs].initial,
+    kSettings[kSettingBurnReportS].initial,
+    kSettings[kSettingDriftAMv].initial,
+    kSettings[kSettingDriftBMv].initial,
+    kSettings[kSettingDriftPeriodS].initial,
+    kSettings[kSettingPotJitterMax].initial,
+    kSettings[kSettingPotDriftMax].initial,
+    kSettings[kSettingEventBus].initial,
+    kSettings[kSettingScopeHz].initial,
+    kSettings[kSettingLogicHz].initial,
+    kSettings[kSettingLogicBurst].initial,
+    kSettings[kSettingLogicTrigger].initial,
+    kSettings[kSettingLogicPulseHz].initial,
+};
+
+}  // namespace
+
+int32_t setting(SettingId id) {
+    return g_values[id];
+}
+
+bool settings_set(const char* name, int32_t value) {
+    for (uint8_t i = 0; i < kSettingCount; ++i) {
+        if (std::strcmp(name, kSettings[i].name) != 0) continue;
+        if (value < kSettings[i].min || value > kSettings[i].max) return false;
+        g_values[i] = value;
+        return true;
+    }
+    return false;
+}
+
+void settings_report() {
+    for (uint8_t i = 0; i < kSettingCount; ++i) {
+        printf("setting %s=%ld\n", kSettings[i].name, static_cast<long>(g_values[i]));
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+
+// Tunable parameters for the host-driven modes, changed over the console
+// with "set <name> <value>". Values live in RAM and reset on reboot.
+enum SettingId : uint8_t {
+    kSettingCicDecimation = 0,  // CV-in oversampling ratio, power of two
+    kSettingLockInRef,          // lock-in reference, see LockInReference
+    kSettingLockInMv,           // lock-in CV reference amplitude, peak mV
+    kSettingLockInMs,           // lock-in integration time
+    kSettingFreqGateMs,         // frequency counter gate time
+    kSettingVcoOut,             // VCO tracking: CV output driving the VCO
+    kSettingVcoIn,              // VCO tracking: 0 = pulse in, 1/2 = CV in
+    kSettingVcoOctaves,         // VCO tracking: number of 1 V steps
+    kSettingMidiStuckMs,        // MIDI test: held time that counts as stuck
+    kSettingTelemetryHz,        // telemetry sample rate
+    kSettingTelemetryCvAMv,     // telemetry: CV out 1 setpoint
+    kSettingTelemetryCvBMv,     // telemetry: CV out 2 setpoint
+    kSettingWatchdogTestMs,     // watchdog budget for one run_test() pass
+    kSettingBurnReportS,        // burn-in report interval
+    kSettingDriftAMv,           // CV drift: CV out 1 level
+    kSettingDriftBMv,           // CV drift: CV out 2 level
+    kSettingDriftPeriodS,       // CV drift: time between measurements
+    kSettingPotJitterMax,       // pot noise: flag above this jitter, RMS counts
+    kSettingPotDriftMax,        // pot noise: flag above this drift, pk-pk counts
+    kSettingEventBus,           // manual input tests: 0 = poll every pass, 1 = events
+    kSettingScopeHz,            // scope: both inputs together, 0 = fastest without drops
+    kSettingLogicHz,            // logic analyzer sample rate
+    kSettingLogicBurst,         // logic analyzer: 0 = continuous, 1 = bursts
+    kSettingLogicTrigger,       // logic analyzer: 0 = none, 1-5 = rising edge on channel
+    kSettingLogicPulseHz,       // logic analyzer: pulse out test signal, 0 = off
+    kSettingCount,
+};
+
+int32_t setting(SettingId id);
+
+// Validates and applies a named setting. Returns false for an unknown
+// name or an out-of-range value.
+bool settings_set(const char* name, int32_t value);
+
+// Prints one "setting <name>=<value>" line per setting.
+void settings_report();
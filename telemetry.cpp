@@ -0,0 +1,223 @@
+#include "telemetry.h"
+
+#include "pico/stdio.h"
+#include "pico/stdio_usb.h"
+#include "pico/stdlib.h"
+#include "tusb.h"
+
+#include "hot_path.h"
+#include "midi_rx.h"
+#include "settings.h"
+#include "usb_frame.h"
+
+static_assert(kTelemetrySync == kUsbFrameSync, "telemetry uses the shared framing");
+
+namespace {
+
+constexpr uint32_t kMaxDecimation  = 128;
+constexpr uint32_t kStatusMs       = 1000;
+constexpr uint32_t kFlushUs        = 10000;  // longest a sample waits in a frame
+// Worst case for one delta sample: dt, mask, seven fields, bits.
+constexpr size_t   kMaxSampleBytes = 5 + 1 + kTelemetryFieldCount * 5 + 1;
+
+struct Sample {
+    uint32_t t_us;
+    int32_t  v[kTelemetryFieldCount];
+    uint8_t  bits;
+};
+
+UsbFrame g_samples;
+UsbFrame g_midi;
+uint32_t g_sample_count  = 0;  // in the open samples frame
+uint32_t g_midi_count    = 0;
+uint32_t g_frame_start_us = 0;
+uint32_t g_midi_last_us  = 0;
+Sample   g_prev;
+
+uint8_t  g_seq           = 0;
+uint32_t g_period_us     = 0;
+uint32_t g_next_us       = 0;
+uint32_t g_tick          = 0;
+uint32_t g_decimation    = 1;
+bool     g_dropped_since_status = false;
+uint32_t g_sent_samples  = 0;
+uint32_t g_dropped_samples = 0;
+uint32_t g_dropped_frames = 0;
+uint32_t g_overruns      = 0;
+uint32_t g_midi_base     = 0;
+uint32_t g_status_ms     = 0;
+int32_t  g_out_mv[2]     = {0, 0};
+bool     g_started       = false;
+
+// Writes a whole frame or nothing: a frame is only sent when the CDC
+// buffer has room for all of it, so the loop never waits on the host.
+bool DIAG_HOT_FUNC(send)(UsbFrame& frame) {
+    size_t n = frame.finish();
+    if (!stdio_usb_connected() || tud_cdc_write_available() < n) {
+        ++g_dropped_frames;
+        g_dropped_since_status = true;
+        if (g_decimation < kMaxDecimation) g_decimation *= 2;
+        return false;
+    }
+    stdio_put_string(reinterpret_cast<const char*>(frame.data()), static_cast<int>(n), false,
+                     false);
+    return true;
+}
+
+void DIAG_HOT_FUNC(flush_samples)() {
+    if (g_sample_count == 0) return;
+    if (send(g_samples)) {
+        g_sent_samples += g_sample_count;
+    } else {
+        g_dropped_samples += g_sample_count;
+    }
+    g_sample_count = 0;
+}
+
+void DIAG_HOT_FUNC(flush_midi)() {
+    if (g_midi_count == 0) return;
+    send(g_midi);
+    g_midi_count = 0;
+}
+
+void DIAG_HOT_FUNC(read_sample)(Brain& brain, Sample& s, uint32_t t_us) {
+    s.t_us = t_us;
+    s.v[0] = brain.pots.get_buffered(0);
+    s.v[1] = brain.pots.get_buffered(1);
+    s.v[2] = brain.pots.get_buffered(2);
+    s.v[3] = brain.inputs.get_voltage_millivolts(kInputsChannelA);
+    s.v[4] = brain.inputs.get_voltage_millivolts(kInputsChannelB);
+    s.v[5] = g_out_mv[0];
+    s.v[6] = g_out_mv[1];
+    s.bits = static_cast<uint8_t>((brain.inputs.pulse_read() ? 1u : 0u) |
+                                  (button_b_held() ? 2u : 0u));
+}
+
+void DIAG_HOT_FUNC(push_sample)(const Sample& s) {
+    if (g_sample_count == 0) {
+        g_samples.begin(kTelemetrySamples, g_seq++);
+        g_samples.put_varint(s.t_us);
+        for (int32_t v : s.v) g_samples.put_signed(v);
+        g_samples.put(s.bits);
+        g_frame_start_us = s.t_us;
+    } else {
+        g_samples.put_varint(s.t_us - g_prev.t_us);
+        uint8_t mask = s.bits != g_prev.bits ? 0x80 : 0;
+        for (uint8_t i = 0; i < kTelemetryFieldCount; ++i) {
+            if (s.v[i] != g_prev.v[i]) mask |= static_cast<uint8_t>(1u << i);
+        }
+        g_samples.put(mask);
+        for (uint8_t i = 0; i < kTelemetryFieldCount; ++i) {
+            if (mask & (1u << i)) g_samples.put_signed(s.v[i] - g_prev.v[i]);
+        }
+        if (mask & 0x80) g_samples.put(s.bits);
+    }
+    g_prev = s;
+    ++g_sample_count;
+    if (g_samples.size() + kMaxSampleBytes + 1 > kUsbFrameMax) flush_samples();
+}
+
+void DIAG_HOT_FUNC(push_midi)(const MidiRxEvent& e) {
+    if (g_midi_count == 0) {
+        g_midi.begin(kTelemetryMidi, g_seq++);
+        g_midi.put_varint(e.time_us);
+    } else {
+        g_midi.put_varint(e.time_us - g_midi_last_us);
+    }
+    g_midi.put(e.byte);
+    g_midi_last_us = e.time_us;
+    ++g_midi_count;
+    // dt (at most five bytes) and the byte itself.
+    if (g_midi.size() + 6 + 1 > kUsbFrameMax) flush_midi();
+}
+
+void send_status() {
+    UsbFrame frame;
+    frame.begin(kTelemetryStatus, g_seq++);
+    frame.put_varint(1000000 / g_period_us);
+    frame.put_varint(g_decimation);
+    frame.put_varint(g_sent_samples);
+    frame.put_varint(g_dropped_samples);
+    frame.put_varint(g_dropped_frames);
+    frame.put_varint(g_overruns);
+    frame.put_varint(midi_rx_dropped() + midi_rx_overruns() - g_midi_base);
+    send(frame);
+}
+
+void apply_outputs(Brain& brain) {
+    int32_t a = setting(kSettingTelemetryCvAMv);
+    int32_t b = setting(kSettingTelemetryCvBMv);
+    if (a != g_out_mv[0]) {
+        g_out_mv[0] = a;
+        brain.outputs.set_voltage_calibrated_millivolts(kOutputsChannelA, a);
+    }
+    if (b != g_out_mv[1]) {
+        g_out_mv[1] = b;
+        brain.outputs.set_voltage_calibrated_millivolts(kOutputsChannelB, b);
+    }
+}
+
+void start(Brain& brain, uint32_t now_ms) {
+    ensure_calibration_loaded(brain);
+    brain.outputs.set_output_range(kOutputsChannelA, kOutputsRangeMinus5To5V);
+    brain.outputs.set_output_range(kOutputsChannelB, kOutputsRangeMinus5To5V);
+    brain.outputs.set_voltage_calibrated_millivolts(kOutputsChannelA, 0);
+    brain.outputs.set_voltage_calibrated_millivolts(kOutputsChannelB, 0);
+    g_out_mv[0] = 0;
+    g_out_mv[1] = 0;
+    apply_outputs(brain);
+
+    g_period_us = 1000000 / static_cast<uint32_t>(setting(kSettingTelemetryHz));
+    g_next_us = time_us_32();
+    g_tick = 0;
+    g_decimation = 1;
+    g_dropped_since_status = false;
+    g_sample_count = 0;
+    g_midi_count = 0;
+    g_sent_samples = 0;
+    g_dropped_samples = 0;
+    g_dropped_frames = 0;
+    g_overruns = 0;
+    g_midi_base = midi_rx_dropped() + midi_rx_overruns();
+    g_status_ms = now_ms;
+    midi_rx_set_exclusive(true);
+}
+
+}  // namespace
+
+void telemetry_enter(Brain& /*brain*/) {
+    g_started = false;
+}
+
+void DIAG_HOT_FUNC(telemetry_run)(Brain& brain, uint32_t now_ms) {
+    if (!g_started) {
+        g_started = true;
+        start(brain, now_ms);
+    }
+
+    uint32_t now = time_us_32();
+    if (static_cast<int32_t>(now - g_next_us) >= 0) {
+        // A stalled loop skips ticks rather than bursting to catch up.
+        uint32_t late = (now - g_next_us) / g_period_us;
+        g_overruns += late;
+        g_tick += late;
+        g_next_us += (late + 1) * g_period_us;
+        if (g_tick++ % g_decimation == 0) {
+            Sample s;
+            read_sample(brain, s, now);
+            push_sample(s);
+        }
+    }
+    if (g_sample_count > 0 && now - g_frame_start_us >= kFlushUs) flush_samples();
+
+    MidiRxEvent e;
+    while (midi_rx_pop(e)) push_midi(e);
+    flush_midi();
+
+    if (now_ms - g_status_ms < kStatusMs) return;
+    g_status_ms = now_ms;
+    apply_outputs(brain);
+    send_status();
+    if (!g_dropped_since_status && g_decimation > 1) g_decimation /= 2;
+    g_dropped_since_status = false;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+
+#include "tests.h"
+
+// kTestTelemetry: live binary stream of every input over USB.
+//
+// At telemetry_hz (a setting) the mode samples the three pots, both CV
+// inputs in millivolts, pulse in, Button B and the two CV output
+// setpoints, and streams them together with every received MIDI byte. The
+// CV outputs are held at the telemetry_cv_a_mv / telemetry_cv_b_mv
+// settings, so a patched loop-back can be watched live.
+//
+// Frames, written straight to the CDC port with no CR/LF translation:
+//
+//   0xA5 <len> <type> <seq> <payload, len - 2 bytes> <crc8>
+//
+// The sync byte has the top bit set, so frames are told apart from the
+// plain-text console replies that may be interleaved with them. len counts
+// type, seq and payload (at most 255); crc8 (polynomial 0x07, initial 0)
+// covers len through the payload. seq increments for every frame the
+// firmware built, so a gap means frames were dropped. Integers are LEB128
+// varints, signed ones zigzag-encoded first. Every frame decodes on its
+// own:
+//
+//   type 1, samples: the first sample is absolute,
+//       t_us, pot1, pot2, pot3, cv1_mv, cv2_mv, out1_mv, out2_mv, bits
+//     and each further one is a delta against the one before,
+//       dt_us, mask, <changed fields as signed deltas>, [bits]
+//     where mask bits 0-6 flag the fields in the order above and bit 7 a
+//     new bits byte. bits: 0 = pulse in, 1 = Button B.
+//   type 2, MIDI: t_us of the first byte, then per byte dt_us, byte.
+//   type 3, status once a second: rate_hz, decimation, samples sent,
+//     samples dropped, frames dropped, loop overruns (ticks the loop
+//     missed), MIDI bytes dropped.
+//
+// When the host reads too slowly to leave room for a frame, the frame is
+// dropped rather than waited for and the sample rate is halved (down to
+// 1/128); it doubles back once a second while nothing is dropped.
+//
+// While this mode runs it takes the MIDI bytes itself, so the SDK's MIDI
+// parser sees no input.
+
+// Frame constants shared with the host decoder.
+constexpr uint8_t kTelemetrySync        = 0xA5;
+constexpr uint8_t kTelemetrySamples     = 1;
+constexpr uint8_t kTelemetryMidi        = 2;
+constexpr uint8_t kTelemetryStatus      = 3;
+constexpr uint8_t kTelemetryFieldCount  = 7;
+
+void telemetry_enter(Brain& brain);
+void telemetry_run(Brain& brain, uint32_t now_ms);
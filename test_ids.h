@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+
+// Test numbers as the console "test" command takes them. Kept free of
+// SDK includes so the host tools in host/ can use the same values.
+
+enum TestId : uint8_t {
+    kTestLeds = 0,
+    kTestPot1,
+    kTestPot2,
+    kTestPot3,
+    kTestButtonLed,
+    kTestButtonB,
+    kTestMidi,
+    kTestCvIn1,
+    kTestCvIn2,
+    kTestPulseIn,
+    kTestCvOut1,
+    kTestCvOut2,
+    kTestPulseOut,
+    kTestCvOutCalibrate,
+    kTestCount,  // Button A cycles through the tests above
+
+    // Host-only modes, selected with the console "test" command. Button A
+    // never lands on these.
+    kTestLoopTiming = kTestCount,
+    kTestSdkBench,
+    kTestDacFastCheck,
+    kTestCvInResolution,
+    kTestCvCrosstalk,
+    kTestLockIn,
+    kTestBode,
+    kTestFreqCounter,
+    kTestVcoTracking,
+    kTestMidiTiming,
+    kTestTelemetry,
+    kTestBurnIn,
+    kTestCvDrift,
+    kTestPotScan,
+    kTestPotNoise,
+    kTestScope,
+    kTestLogic,
+    kTestMidiSniffer,
+    kTestAllCount,
+};
@@ -1,8 +1,37 @@
 #include "tests.h"
 
 #include <cstdint>
+#include <cstdio>
 #include <cstdlib>
 
+#include "adc_capture.h"
+#include "bode.h"
+#include "boot_profile.h"
+#include "burn_in.h"
+#include "crosstalk.h"
+#include "cv_drift.h"
+#include "cv_in_stream.h"
+#include "dac_fast.h"
+#include "dac_stream.h"
+#include "event_bus.h"
+#include "freq_counter.h"
+#include "hot_path.h"
+#include "lockin.h"
+#include "logic_analyzer.h"
+#include "loop_timing.h"
+#include "midi_notes.h"
+#include "midi_rx.h"
+#include "midi_sniffer.h"
+#include "midi_timing.h"
+#include "pot_noise.h"
+#include "pot_scan.h"
+#include "pulse_counter.h"
+#include "scope.h"
+#include "sdk_bench.h"
+#include "settings.h"
+#include "telemetry.h"
+#include "vco_tracking.h"
+
 namespace {
 
 constexpr uint32_t kCvSquareHalfPeriodMs = 5;     // 100 Hz square on CV outs
@@ -13,10 +42,8 @@ constexpr int32_t  kCvOutHighMv          =  5000;
 constexpr int32_t  kCvOutLowMv           = -5000;
 constexpr int32_t  kCvInFullScaleMv      =  5000;
 constexpr uint16_t kPotFullScale         = 127;   // 7-bit default
-
-// MIDI note tracking. Callbacks must be plain functions (the SDK uses
-// function pointers, not std::function), so the counter lives in file scope.
-volatile uint8_t g_midi_active_notes = 0;
+constexpr uint32_t kCvInReadoutMs        = 250;   // numeric CV-in readout over USB
+constexpr uint32_t kMidiReportMs         = 1000;  // MIDI note statistics over USB
 
 // Button B latched state. Updated by callbacks registered in main, read by
 // the button-B test. Always-on registration keeps the test handler stateless.
@@ -26,14 +53,25 @@ volatile bool g_button_b_pressed = false;
 uint32_t g_last_toggle_ms = 0;
 bool     g_toggle_state   = false;
 
-uint8_t pot_to_led_count(uint16_t pot_value) {
+// Calibration is read from flash on first use rather than at boot.
+bool g_calibration_loaded = false;
+
+// Event-bus mode for the manual input tests, latched from the event_bus
+// setting on test entry. The polled body still runs once, on the first
+// pass after the test-number indicator, to draw the current state; the
+// handlers below keep the LEDs up to date from then on.
+bool    g_use_events  = false;
+bool    g_event_drawn = false;
+uint8_t g_event_pot   = 0;
+
+uint8_t DIAG_HOT_FUNC(pot_to_led_count)(uint16_t pot_value) {
     // 0..127 -> 0..6. Each LED step ~21 pot units.
     uint32_t scaled = static_cast<uint32_t>(pot_value) * 6 / (kPotFullScale + 1);
     if (scaled > 6) scaled = 6;
     return static_cast<uint8_t>(scaled);
 }
 
-void light_bar(Brain& brain, uint8_t count) {
+void DIAG_HOT_FUNC(light_bar)(Brain& brain, uint8_t count) {
     for (uint8_t i = 0; i < 6; ++i) {
         if (i < count) {
             brain.leds.set_brightness(i, 255);
@@ -43,7 +81,31 @@ void light_bar(Brain& brain, uint8_t count) {
     }
 }
 
-uint8_t triangle_brightness(uint32_t now_ms) {
+void DIAG_HOT_FUNC(set_all)(Brain& brain, bool on) {
+    for (uint8_t i = 0; i < 6; ++i) brain.leds.set_brightness(i, on ? 255 : 0);
+}
+
+void DIAG_HOT_FUNC(on_pot_event)(Brain& brain, const Event& e) {
+    if (e.index != g_event_pot) return;
+    light_bar(brain, pot_to_led_count(static_cast<uint16_t>(e.value)));
+}
+
+void DIAG_HOT_FUNC(on_button_event)(Brain& brain, const Event& e) {
+    if (e.index == 1) set_all(brain, e.value != 0);
+}
+
+void DIAG_HOT_FUNC(on_midi_event)(Brain& brain, const Event& /*e*/) {
+    // The parser has run by the time events are dispatched.
+    set_all(brain, midi_notes_any_held());
+}
+
+// The level the interrupt read after the edge, not a fresh read: this
+// handler shows the edge it is handling even if another one followed.
+void DIAG_HOT_FUNC(on_pulse_event)(Brain& brain, const Event& e) {
+    set_all(brain, e.value != 0);
+}
+
+uint8_t DIAG_HOT_FUNC(triangle_brightness)(uint32_t now_ms) {
     // 0 -> 255 -> 0 over 2 * kLedSweepHalfMs.
     uint32_t phase = now_ms % (2 * kLedSweepHalfMs);
     uint32_t up = (phase < kLedSweepHalfMs) ? phase
@@ -51,23 +113,50 @@ uint8_t triangle_brightness(uint32_t now_ms) {
     return static_cast<uint8_t>((up * 255) / kLedSweepHalfMs);
 }
 
-}  // namespace
+void DIAG_HOT_FUNC(cv_in_meter)(Brain& brain, uint8_t channel, uint32_t now_ms) {
+    // VU meter and numeric readout from the oversampled, decimated stream.
+    cv_in_stream_service();
+    int32_t uv = cv_in_stream_microvolts(channel);
+    uint32_t mag = static_cast<uint32_t>(std::abs(uv / 1000));
+    if (mag > static_cast<uint32_t>(kCvInFullScaleMv)) {
+        mag = kCvInFullScaleMv;
+    }
+    uint8_t count = static_cast<uint8_t>((mag * 6) / kCvInFullScaleMv);
+    if (count > 6) count = 6;
+    light_bar(brain, count);
 
-void midi_note_on(uint8_t /*note*/, uint8_t velocity, uint8_t /*channel*/) {
-    // Running-status convention: note-on with velocity 0 means note-off.
-    if (velocity == 0) {
-        if (g_midi_active_notes > 0) g_midi_active_notes--;
-    } else {
-        if (g_midi_active_notes < 255) g_midi_active_notes++;
+    if (now_ms - g_last_toggle_ms >= kCvInReadoutMs) {
+        g_last_toggle_ms = now_ms;
+        printf("cvin channel=%s uv=%ld rate_hz=%lu\n", channel == 0 ? "a" : "b",
+               static_cast<long>(uv),
+               static_cast<unsigned long>(cv_in_stream_output_rate_hz()));
     }
 }
 
-void midi_note_off(uint8_t /*note*/, uint8_t /*velocity*/, uint8_t /*channel*/) {
-    if (g_midi_active_notes > 0) g_midi_active_notes--;
+}  // namespace
+
+void ensure_calibration_loaded(Brain& brain) {
+    if (g_calibration_loaded) return;
+    g_calibration_loaded = true;
+    // If absent or corrupt, the CV-output tests still run; the scope just
+    // sees the uncalibrated DAC mapping. The diagnostics firmware never
+    // writes or clears calibration.
+    boot_mark(kBootCalibrationStart);
+    brain.outputs.load_calibration_from_flash();
+    boot_mark(kBootCalibrationDone);
+}
+
+void button_b_press() {
+    g_button_b_pressed = true;
+    event_bus_publish(kEventButton, 1, 0, 1, time_us_32());
 }
 
-void button_b_press()   { g_button_b_pressed = true; }
-void button_b_release() { g_button_b_pressed = false; }
+void button_b_release() {
+    g_button_b_pressed = false;
+    event_bus_publish(kEventButton, 1, 0, 0, time_us_32());
+}
+
+bool button_b_held() { return g_button_b_pressed; }
 
 void on_test_enter(Brain& brain, TestId test) {
     // Reset shared state.
@@ -79,16 +168,53 @@ void on_test_enter(Brain& brain, TestId test) {
     }
     g_last_toggle_ms = 0;
     g_toggle_state = false;
-    g_midi_active_notes = 0;
+    event_bus_unsubscribe();
+    g_use_events = setting(kSettingEventBus) != 0;
+    g_event_drawn = false;
+    midi_notes_reset();
+    lockin_stop();
+    burn_in_stop();
+    cv_drift_stop();
+    pot_scan_stop();
+    scope_stop();
+    logic_analyzer_stop();
+    midi_sniffer_stop();
+    freq_counter_stop();
+    pulse_counter_stop();
+    midi_rx_set_exclusive(false);
+    dac_stream_stop();
+    adc_capture_stop();
 
     switch (test) {
+        case kTestPot1:
+        case kTestPot2:
+        case kTestPot3:
+            if (!g_use_events) break;
+            g_event_pot = static_cast<uint8_t>(test - kTestPot1);
+            event_bus_subscribe(event_mask(kEventPot), on_pot_event);
+            break;
         case kTestButtonLed:
             brain.leds.button_start_blink(kButtonLedBlinkMs);
             break;
+        case kTestButtonB:
+            if (g_use_events) event_bus_subscribe(event_mask(kEventButton), on_button_event);
+            break;
+        case kTestMidi:
+            if (g_use_events) event_bus_subscribe(event_mask(kEventMidiNote), on_midi_event);
+            break;
+        case kTestPulseIn:
+            if (g_use_events) event_bus_subscribe(event_mask(kEventPulseIn), on_pulse_event);
+            break;
+        case kTestCvIn1:
+        case kTestCvIn2:
+            cv_in_stream_start();
+            break;
         case kTestCvOut1:
+            ensure_calibration_loaded(brain);
             brain.outputs.set_output_range(kOutputsChannelA, kOutputsRangeMinus5To5V);
             break;
         case kTestCvOut2:
+            ensure_calibration_loaded(brain);
             brain.outputs.set_output_range(kOutputsChannelB, kOutputsRangeMinus5To5V);
             break;
         case kTestPulseOut:
@@ -102,12 +228,68 @@ void on_test_enter(Brain& brain, TestId test) {
             brain.outputs.set_voltage_millivolts(kOutputsChannelA, 0);
             brain.outputs.set_voltage_millivolts(kOutputsChannelB, 0);
             break;
+        case kTestLoopTiming:
+            loop_timing_enter(brain);
+            break;
+        case kTestSdkBench:
+            sdk_bench_enter(brain);
+            break;
+        case kTestDacFastCheck:
+            dac_fast_check_enter(brain);
+            break;
+        case kTestCvInResolution:
+            cv_in_resolution_enter(brain);
+            break;
+        case kTestCvCrosstalk:
+            crosstalk_enter(brain);
+            break;
+        case kTestLockIn:
+            lockin_enter(brain);
+            break;
+        case kTestBode:
+            bode_enter(brain);
+            break;
+        case kTestFreqCounter:
+            freq_counter_enter(brain);
+            break;
+        case kTestVcoTracking:
+            vco_tracking_enter(brain);
+            break;
+        case kTestMidiTiming:
+            midi_timing_enter(brain);
+            break;
+        case kTestTelemetry:
+            telemetry_enter(brain);
+            break;
+        case kTestBurnIn:
+            burn_in_enter(brain);
+            break;
+        case kTestCvDrift:
+            cv_drift_enter(brain);
+            break;
+        case kTestPotScan:
+            pot_scan_enter(brain);
+            break;
+        case kTestPotNoise:
+            pot_noise_enter(brain);
+            break;
+        case kTestScope:
+            scope_enter(brain);
+            break;
+        case kTestLogic:
+            logic_analyzer_enter(brain);
+            break;
+        case kTestMidiSniffer:
+            midi_sniffer_enter(brain);
+            break;
         default:
             break;
     }
 }
 
-void run_test(Brain& brain, TestId test, uint32_t now_ms) {
+void DIAG_HOT_FUNC(run_test)(Brain& brain, TestId test, uint32_t now_ms) {
+    bool polled = !g_use_events || !g_event_drawn;
+    g_event_drawn = true;
     switch (test) {
         case kTestLeds: {
             uint8_t b = triangle_brightness(now_ms);
@@ -118,13 +300,13 @@ void run_test(Brain& brain, TestId test, uint32_t now_ms) {
         }
 
         case kTestPot1:
-            light_bar(brain, pot_to_led_count(brain.pots.get_buffered(0)));
+            if (polled) light_bar(brain, pot_to_led_count(brain.pots.get_buffered(0)));
             break;
         case kTestPot2:
-            light_bar(brain, pot_to_led_count(brain.pots.get_buffered(1)));
+            if (polled) light_bar(brain, pot_to_led_count(brain.pots.get_buffered(1)));
             break;
         case kTestPot3:
-            light_bar(brain, pot_to_led_count(brain.pots.get_buffered(2)));
+            if (polled) light_bar(brain, pot_to_led_count(brain.pots.get_buffered(2)));
             break;
 
         case kTestButtonLed:
@@ -132,50 +314,27 @@ void run_test(Brain& brain, TestId test, uint32_t now_ms) {
             break;
 
         case kTestButtonB:
-            if (g_button_b_pressed) {
-                for (uint8_t i = 0; i < 6; ++i) brain.leds.set_brightness(i, 255);
-            } else {
-                for (uint8_t i = 0; i < 6; ++i) brain.leds.set_brightness(i, 0);
-            }
+            if (polled) set_all(brain, g_button_b_pressed);
             break;
 
-        case kTestMidi:
-            if (g_midi_active_notes > 0) {
-                for (uint8_t i = 0; i < 6; ++i) brain.leds.set_brightness(i, 255);
-            } else {
-                for (uint8_t i = 0; i < 6; ++i) brain.leds.set_brightness(i, 0);
-            }
+        case kTestMidi: {
+            if (polled) set_all(brain, midi_notes_any_held());
+            if (now_ms - g_last_toggle_ms < kMidiReportMs) break;
+            g_last_toggle_ms = now_ms;
+            auto stuck_ms = static_cast<uint32_t>(setting(kSettingMidiStuckMs));
+            if (midi_notes_changed(now_ms, stuck_ms)) midi_notes_report(now_ms, stuck_ms);
             break;
+        }
 
-        case kTestCvIn1: {
-            int32_t mv = brain.inputs.get_voltage_millivolts(kInputsChannelA);
-            uint32_t mag = static_cast<uint32_t>(std::abs(mv));
-            if (mag > static_cast<uint32_t>(kCvInFullScaleMv)) {
-                mag = kCvInFullScaleMv;
-            }
-            uint8_t count = static_cast<uint8_t>((mag * 6) / kCvInFullScaleMv);
-            if (count > 6) count = 6;
-            light_bar(brain, count);
+        case kTestCvIn1:
+            cv_in_meter(brain, 0, now_ms);
             break;
-        }
-        case kTestCvIn2: {
-            int32_t mv = brain.inputs.get_voltage_millivolts(kInputsChannelB);
-            uint32_t mag = static_cast<uint32_t>(std::abs(mv));
-            if (mag > static_cast<uint32_t>(kCvInFullScaleMv)) {
-                mag = kCvInFullScaleMv;
-            }
-            uint8_t count = static_cast<uint8_t>((mag * 6) / kCvInFullScaleMv);
-            if (count > 6) count = 6;
-            light_bar(brain, count);
+        case kTestCvIn2:
+            cv_in_meter(brain, 1, now_ms);
             break;
-        }
 
         case kTestPulseIn:
-            if (brain.inputs.pulse_read()) {
-                for (uint8_t i = 0; i < 6; ++i) brain.leds.set_brightness(i, 255);
-            } else {
-                for (uint8_t i = 0; i < 6; ++i) brain.leds.set_brightness(i, 0);
-            }
+            if (polled) set_all(brain, brain.inputs.pulse_read());
             break;
 
         case kTestCvOut1:
@@ -226,7 +385,62 @@ void run_test(Brain& brain, TestId test, uint32_t now_ms) {
             break;
         }
 
-        case kTestCount:
+        case kTestLoopTiming:
+            loop_timing_run(brain, now_ms);
+            break;
+        case kTestSdkBench:
+            sdk_bench_run(brain, now_ms);
+            break;
+        case kTestDacFastCheck:
+            dac_fast_check_run(brain, now_ms);
+            break;
+        case kTestCvInResolution:
+            cv_in_resolution_run(brain, now_ms);
+            break;
+        case kTestCvCrosstalk:
+            crosstalk_run(brain, now_ms);
+            break;
+        case kTestLockIn:
+            lockin_run(brain, now_ms);
+            break;
+        case kTestBode:
+            bode_run(brain, now_ms);
+            break;
+        case kTestFreqCounter:
+            freq_counter_run(brain, now_ms);
+            break;
+        case kTestVcoTracking:
+            vco_tracking_run(brain, now_ms);
+            break;
+        case kTestMidiTiming:
+            midi_timing_run(brain, now_ms);
+            break;
+        case kTestTelemetry:
+            telemetry_run(brain, now_ms);
+            break;
+        case kTestBurnIn:
+            burn_in_run(brain, now_ms);
+            break;
+        case kTestCvDrift:
+            cv_drift_run(brain, now_ms);
+            break;
+        case kTestPotScan:
+            pot_scan_run(brain, now_ms);
+            break;
+        case kTestPotNoise:
+            pot_noise_run(brain, now_ms);
+            break;
+        case kTestScope:
+            scope_run(brain, now_ms);
+            break;
+        case kTestLogic:
+            logic_analyzer_run(brain, now_ms);
+            break;
+        case kTestMidiSniffer:
+            midi_sniffer_run(brain, now_ms);
+            break;
+
+        case kTestAllCount:
             break;
     }
 }
@@ -0,0 +1,47 @@
+#include "tone_detect.h"
+
+#include <cmath>
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr double kQ15 = 32767.0;
+
+int16_t g_sine[1u << kToneTableBits];
+bool    g_sine_ready = false;
+
+}  // namespace
+
+const int16_t* tone_sine_table() {
+    if (!g_sine_ready) {
+        constexpr uint32_t n = 1u << kToneTableBits;
+        for (uint32_t i = 0; i < n; ++i) {
+            g_sine[i] = static_cast<int16_t>(std::lround(kQ15 * std::sin(2.0 * kPi * i / n)));
+        }
+        g_sine_ready = true;
+    }
+    return g_sine;
+}
+
+uint32_t tone_phase_step(double freq_hz, double rate_hz) {
+    return static_cast<uint32_t>(std::llround(freq_hz / rate_hz * 4294967296.0));
+}
+
+uint32_t tone_sine_phase(double freq_hz, double t_s) {
+    // The detector correlates against a cosine, hence the quarter cycle.
+    double cycles = freq_hz * t_s - 0.25;
+    cycles -= std::floor(cycles);
+    return static_cast<uint32_t>(cycles * 4294967296.0);
+}
+
+double ToneDetector::amplitude() const {
+    if (n_ == 0) return 0.0;
+    double i = static_cast<double>(i_);
+    double q = static_cast<double>(q_);
+    return 2.0 * std::sqrt(i * i + q * q) / (n_ * kQ15);
+}
+
+double ToneDetector::phase_deg() const {
+    // x = A cos(wn + p) correlates to I = A/2 cos p, Q = -A/2 sin p.
+    return std::atan2(-static_cast<double>(q_), static_cast<double>(i_)) * 180.0 / kPi;
+}
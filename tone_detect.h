@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+
+// Single-bin coherent detector: correlates a sample stream with a sine and
+// cosine reference at one known frequency and accumulates the products.
+// Everything off that frequency, noise included, averages towards zero, so
+// a tone far below the broadband noise floor can still be measured given
+// enough samples.
+//
+// The reference comes from a 32-bit phase accumulator indexing a Q15 sine
+// table; products are summed in 64 bits, so the per-sample cost is two
+// integer multiply-adds. Integrating over a whole number of reference
+// periods avoids leakage from DC and other exact harmonics.
+
+constexpr uint8_t kToneTableBits = 10;  // 1024-entry sine table
+
+// Q15 sine over one period, built on first use.
+const int16_t* tone_sine_table();
+
+// Phase increment per sample for `freq_hz` at `rate_hz`.
+uint32_t tone_phase_step(double freq_hz, double rate_hz);
+
+// Reference phase that lines a detector up with a drive sin(2 pi f t),
+// for a sample taken `t_s` seconds after the drive started.
+uint32_t tone_sine_phase(double freq_hz, double t_s);
+
+class ToneDetector {
+public:
+    // `phase` is the reference phase of the first sample, in units of a
+    // full period / 2^32.
+    void reset(uint32_t phase_step, uint32_t phase = 0) {
+        table_ = tone_sine_table();
+        step_ = phase_step;
+        phase_ = phase;
+        i_ = 0;
+        q_ = 0;
+        n_ = 0;
+    }
+
+    void push(int32_t x) {
+        constexpr uint32_t kMask = (1u << kToneTableBits) - 1;
+        constexpr uint32_t kQuarter = 1u << (kToneTableBits - 2);
+        uint32_t idx = phase_ >> (32 - kToneTableBits);
+        i_ += static_cast<int64_t>(x) * table_[(idx + kQuarter) & kMask];
+        q_ += static_cast<int64_t>(x) * table_[idx];
+        phase_ += step_;
+        ++n_;
+    }
+
+    // Zeroes the sums; the reference phase carries on.
+    void clear() {
+        i_ = 0;
+        q_ = 0;
+        n_ = 0;
+    }
+
+    // Re-aligns the reference, e.g. after samples were skipped.
+    void set_phase(uint32_t phase) { phase_ = phase; }
+
+    // Re-aligns the reference to sample `index` of a stream whose sample 0
+    // had phase `phase0`, so a dropped block only costs its samples.
+    void seek(uint32_t index, uint32_t phase0 = 0) { phase_ = phase0 + step_ * index; }
+
+    uint32_t samples() const { return n_; }
+
+    // Peak amplitude of the component at the reference frequency, in input
+    // units.
+    double amplitude() const;
+
+    // Phase of that component relative to a cosine reference, in degrees
+    // (-180..180].
+    double phase_deg() const;
+
+private:
+    const int16_t* table_ = nullptr;
+    uint32_t step_  = 0;
+    uint32_t phase_ = 0;
+    int64_t  i_     = 0;
+    int64_t  q_     = 0;
+    uint32_t n_     = 0;
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Builder for the framed binary streams the host tools decode (layouts in
+// telemetry.h and logic_analyzer.h):
+//
+//   0xA5 <len> <type> <seq> <payload, len - 2 bytes> <crc8>
+//
+// len counts type, seq and payload (at most 255); crc8 (polynomial 0x07,
+// initial 0) covers len through the payload. Integers are LEB128 varints,
+// signed ones zigzag-encoded first.
+
+constexpr uint8_t kUsbFrameSync = 0xA5;
+constexpr size_t  kUsbFrameMax  = 2 + 255 + 1;
+
+namespace usb_frame_detail {
+
+struct Crc8Table {
+    uint8_t v[256];
+};
+
+constexpr Crc8Table crc8_table() {
+    Crc8Table t{};
+    for (int i = 0; i < 256; ++i) {
+        uint8_t crc = static_cast<uint8_t>(i);
+        for (int b = 0; b < 8; ++b) {
+            crc = static_cast<uint8_t>(crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1);
+        }
+        t.v[i] = crc;
+    }
+    return t;
+}
+
+}  // namespace usb_frame_detail
+
+// Table-driven: one lookup per byte. The host decoders share this and run
+// it over every byte they receive.
+inline uint8_t usb_frame_crc8(const uint8_t* data, size_t len) {
+    static constexpr usb_frame_detail::Crc8Table kTable = usb_frame_detail::crc8_table();
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; ++i) crc = kTable.v[crc ^ data[i]];
+    return crc;
+}
+
+class UsbFrame {
+public:
+    void begin(uint8_t type, uint8_t seq) {
+        buf_[0] = kUsbFrameSync;
+        buf_[2] = type;
+        buf_[3] = seq;
+        pos_ = 4;
+    }
+
+    void put(uint8_t b) { buf_[pos_++] = b; }
+
+    void put_varint(uint32_t v) {
+        while (v >= 0x80) {
+            buf_[pos_++] = static_cast<uint8_t>(v | 0x80);
+            v >>= 7;
+        }
+        buf_[pos_++] = static_cast<uint8_t>(v);
+    }
+
+    void put_signed(int32_t v) {
+        put_varint((static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31));
+    }
+
+    // Fills in len and crc8; returns the bytes to send.
+    size_t finish() {
+        buf_[1] = static_cast<uint8_t>(pos_ - 2);
+        buf_[pos_] = usb_frame_crc8(buf_ + 1, pos_ - 1);
+        return pos_ + 1;
+    }
+
+    size_t size() const { return pos_; }
+    const uint8_t* data() const { return buf_; }
+
+private:
+    uint8_t buf_[kUsbFrameMax];
+    size_t  pos_ = 0;
+};
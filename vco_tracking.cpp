@@ -0,0 +1,196 @@
+#include "vco_tracking.h"
+
+#include <cmath>
+#include <cstdio>
+
+#include "freq_counter.h"
+#include "pulse_counter.h"
+#include "settings.h"
+
+namespace {
+
+constexpr uint32_t kMaxSteps        = 11;   // 0..10 V
+constexpr uint32_t kStableWindows   = 3;
+constexpr double   kStableCents     = 0.2;
+constexpr uint32_t kStepTimeoutMs   = 3000;
+constexpr uint32_t kGatePeriods     = 8;
+constexpr uint32_t kFirstGateMs     = 100;
+constexpr uint32_t kMinGateMs       = 10;
+constexpr uint32_t kMaxGateMs       = 500;
+
+enum Phase : uint8_t {
+    kPhaseStart = 0,
+    kPhaseMeasure,
+    kPhaseDone,
+};
+
+Phase    g_phase      = kPhaseDone;
+uint8_t  g_output     = 0;
+uint8_t  g_source     = 0;  // 0 = pulse in, 1/2 = CV in 1/2
+uint8_t  g_steps      = 0;
+uint8_t  g_step       = 0;
+uint32_t g_step_start_ms = 0;
+bool     g_settled    = false;  // first gate after the step dropped
+double   g_recent[kStableWindows];
+uint32_t g_recent_count = 0;
+double   g_hz[kMaxSteps];
+
+void set_output_mv(Brain& brain, int32_t mv) {
+    brain.outputs.set_voltage_calibrated_millivolts(
+        g_output == 0 ? kOutputsChannelA : kOutputsChannelB, mv);
+}
+
+bool start_counter(uint32_t gate_ms) {
+    if (g_source == 0) return pulse_counter_start(gate_ms);
+    return freq_counter_start(gate_ms);
+}
+
+void stop_counter() {
+    pulse_counter_stop();
+    freq_counter_stop();
+}
+
+bool service_counter(FreqReading& reading) {
+    if (g_source == 0) {
+        if (!pulse_counter_service()) return false;
+        reading = pulse_counter_reading();
+        return true;
+    }
+    if (!freq_counter_service()) return false;
+    reading = freq_counter_reading(g_source - 1);
+    return true;
+}
+
+// About kGatePeriods periods at the expected frequency.
+uint32_t gate_for(double hz) {
+    if (hz <= 0.0) return kFirstGateMs;
+    auto ms = static_cast<uint32_t>(std::ceil(1000.0 * kGatePeriods / hz));
+    if (ms < kMinGateMs) return kMinGateMs;
+    if (ms > kMaxGateMs) return kMaxGateMs;
+    return ms;
+}
+
+bool begin_step(Brain& brain, uint32_t now_ms, double expected_hz) {
+    set_output_mv(brain, static_cast<int32_t>(g_step) * 1000);
+    g_step_start_ms = now_ms;
+    g_settled = false;
+    g_recent_count = 0;
+    return start_counter(gate_for(expected_hz));
+}
+
+void finish(Brain& brain, const char* error) {
+    stop_counter();
+    set_output_mv(brain, 0);
+    if (error != nullptr) printf("vco error=%s\n", error);
+    printf("vco_done\n");
+    g_phase = kPhaseDone;
+}
+
+void report_fit() {
+    // Least squares of log2(f) = a + b * volts over the steps that locked.
+    double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (uint8_t i = 0; i < g_steps; ++i) {
+        if (g_hz[i] <= 0.0) continue;
+        double y = std::log2(g_hz[i]);
+        n += 1;
+        sx += i;
+        sy += y;
+        sxx += static_cast<double>(i) * i;
+        sxy += i * y;
+    }
+    double den = n * sxx - sx * sx;
+    if (n < 2 || den == 0.0) {
+        printf("vco fit error=too-few-steps\n");
+        return;
+    }
+    double b = (n * sxy - sx * sy) / den;
+    double a = (sy - b * sx) / n;
+    double max_residual = 0.0;
+    for (uint8_t i = 0; i < g_steps; ++i) {
+        if (g_hz[i] <= 0.0) continue;
+        double r = std::fabs(1200.0 * (std::log2(g_hz[i]) - (a + b * i)));
+        if (r > max_residual) max_residual = r;
+    }
+    printf("vco fit scale=%.5f scale_cents=%.2f offset_hz=%.4f max_residual_cents=%.2f\n", b,
+           1200.0 * (b - 1.0), std::exp2(a), max_residual);
+}
+
+void accept_step(bool stable, uint32_t now_ms) {
+    double hz = 0.0;
+    for (uint32_t i = 0; i < g_recent_count; ++i) hz += g_recent[i];
+    if (g_recent_count > 0) hz /= g_recent_count;
+    g_hz[g_step] = hz;
+
+    printf("vco step=%u volts=%u hz=%.4f stable=%u ms=%lu\n", g_step, g_step, hz, stable ? 1u : 0u,
+           static_cast<unsigned long>(now_ms - g_step_start_ms));
+    if (g_step > 0 && hz > 0.0 && g_hz[g_step - 1] > 0.0) {
+        printf("vco octave=%u cents=%.2f\n", g_step,
+               1200.0 * (std::log2(hz / g_hz[g_step - 1]) - 1.0));
+    }
+}
+
+}  // namespace
+
+void vco_tracking_enter(Brain& /*brain*/) {
+    g_phase = kPhaseStart;
+}
+
+void vco_tracking_run(Brain& brain, uint32_t now_ms) {
+    switch (g_phase) {
+        case kPhaseStart: {
+            g_output = static_cast<uint8_t>(setting(kSettingVcoOut));
+            g_source = static_cast<uint8_t>(setting(kSettingVcoIn));
+            g_steps = static_cast<uint8_t>(setting(kSettingVcoOctaves) + 1);
+            ensure_calibration_loaded(brain);
+            brain.outputs.set_output_range(g_output == 0 ? kOutputsChannelA : kOutputsChannelB,
+                                           kOutputsRange0To10V);
+            g_step = 0;
+            if (!begin_step(brain, now_ms, 0.0)) {
+                finish(brain, "start-failed");
+                return;
+            }
+            g_phase = kPhaseMeasure;
+            break;
+        }
+
+        case kPhaseMeasure: {
+            FreqReading reading;
+            bool timed_out = now_ms - g_step_start_ms >= kStepTimeoutMs;
+            if (!service_counter(reading) && !timed_out) return;
+            if (!timed_out) {
+                if (!g_settled) {
+                    // The VCO (and any glide) is still moving.
+                    g_settled = true;
+                    return;
+                }
+                if (!reading.valid) return;
+                // Keep the last few readings and check their spread.
+                if (g_recent_count == kStableWindows) {
+                    for (uint32_t i = 1; i < kStableWindows; ++i) g_recent[i - 1] = g_recent[i];
+                    --g_recent_count;
+                }
+                g_recent[g_recent_count++] = reading.hz;
+                if (g_recent_count < kStableWindows) return;
+                double lo = g_recent[0], hi = g_recent[0];
+                for (double hz : g_recent) {
+                    lo = hz < lo ? hz : lo;
+                    hi = hz > hi ? hz : hi;
+                }
+                if (1200.0 * std::log2(hi / lo) > kStableCents) return;
+            }
+
+            accept_step(!timed_out, now_ms);
+            double last = g_hz[g_step];
+            if (++g_step >= g_steps) {
+                report_fit();
+                finish(brain, nullptr);
+                return;
+            }
+            if (!begin_step(brain, now_ms, last * 2.0)) finish(brain, "start-failed");
+            break;
+        }
+
+        case kPhaseDone:
+            break;
+    }
+}
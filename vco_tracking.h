@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+
+#include "tests.h"
+
+// kTestVcoTracking: 1 V/octave tracking check of an external VCO. Patch a
+// CV output into the VCO's pitch input and the VCO's output back into
+// pulse in (square or pulse wave) or a CV input (any waveform).
+//
+// The output is stepped through whole volts from 0 V with the SDK's
+// calibrated path, set_voltage_calibrated_millivolts(), on the 0-10 V
+// range. At each step the VCO frequency is measured with the pulse-input
+// counter (pulse_counter.h) or the CV-input counter (freq_counter.h) in
+// short gates of about eight periods. The first gate after a step is
+// dropped, and the step ends as soon as three consecutive readings agree
+// within 0.2 cents, or after three seconds (stable=0). Then a straight
+// line is fitted to log2(frequency) against volts:
+//
+//   vco step=<n> volts=<v> hz=<f> stable=<0|1> ms=<t>
+//   vco octave=<n> cents=<error of the step from n-1 to n>
+//   vco fit scale=<octaves per volt> scale_cents=<error per octave> offset_hz=<f at 0 V> max_residual_cents=<c>
+//   vco_done
+//
+// Settings: vco_out (0 = CV out 1, 1 = CV out 2), vco_in (0 = pulse in,
+// 1 = CV in 1, 2 = CV in 2) and vco_octaves (number of 1 V steps).
+void vco_tracking_enter(Brain& brain);
+void vco_tracking_run(Brain& brain, uint32_t now_ms);